@@ -0,0 +1,70 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/benchmark/bufferpool.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/benchmark
+ * Created Date: Friday, March 27th 2020, 2:40:18 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "pmpool/buffer/BufferPool.h"
+
+#define OPS_PER_THREAD 200000
+/// buffers each thread holds at once, they are put back in random order.
+#define BUFFERS_IN_FLIGHT 16
+
+uint64_t timestamp_now() {
+  return std::chrono::high_resolution_clock::now().time_since_epoch() /
+         std::chrono::milliseconds(1);
+}
+
+/// mixed sizes from 4KB to 1MB, as the request sizes of a shuffle.
+void func(BufferPool *pool, int seed) {
+  unsigned int state = seed;
+  std::vector<std::pair<char *, uint64_t>> held;
+  for (int i = 0; i < OPS_PER_THREAD; i++) {
+    uint64_t size = 4096ULL << (rand_r(&state) % 9);
+    char *buf = pool->get(size);
+    memset(buf, 0, 64);
+    held.emplace_back(buf, size);
+    if (held.size() == BUFFERS_IN_FLIGHT) {
+      int victim = rand_r(&state) % held.size();
+      pool->put(held[victim].first, held[victim].second);
+      held[victim] = held.back();
+      held.pop_back();
+    }
+  }
+  for (auto &buf : held) {
+    pool->put(buf.first, buf.second);
+  }
+}
+
+int main(int argc, char **argv) {
+  int thread_num = argc > 1 ? atoi(argv[1]) : 8;
+  BufferPool pool(1024 * 1024, 2048);
+  uint64_t start = timestamp_now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_num; i++) {
+    threads.emplace_back(func, &pool, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  uint64_t end = timestamp_now();
+  BufferPoolStats stats = pool.get_stats();
+  std::cout << thread_num << " threads, "
+            << thread_num * OPS_PER_THREAD * 1000.0 / (end - start + 1)
+            << " get/put per second, refills " << stats.refills
+            << ", rebalances " << stats.rebalances << ", waits "
+            << stats.waits << ", cas retries " << stats.cas_retries
+            << std::endl;
+  return 0;
+}
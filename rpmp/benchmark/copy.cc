@@ -0,0 +1,103 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/benchmark/copy.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/benchmark
+ * Created Date: Wednesday, April 1st 2020, 3:41:09 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <libpmem.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <string>
+
+#include "pmpool/CopyEngine.h"
+
+#define MAX_BLOCK_SIZE (64ULL * 1024 * 1024)
+/// bytes copied per block size and method.
+#define BYTES_PER_RUN (4ULL * 1024 * 1024 * 1024)
+
+uint64_t timestamp_now() {
+  return std::chrono::high_resolution_clock::now().time_since_epoch() /
+         std::chrono::microseconds(1);
+}
+
+/// copy blocks of the size round robin over the destination and return MB/s.
+template <class F>
+double run(char *dest, uint64_t dest_size, const char *src, uint64_t size,
+           F func) {
+  uint64_t blocks_per_dest = dest_size / size;
+  uint64_t num = BYTES_PER_RUN / size;
+  uint64_t start = timestamp_now();
+  for (uint64_t i = 0; i < num; i++) {
+    func(dest + (i % blocks_per_dest) * size, src, size);
+  }
+  CopyEngine::drain();
+  uint64_t end = timestamp_now();
+  return BYTES_PER_RUN / 1024.0 / 1024 / ((end - start + 1) / 1000000.0);
+}
+
+/// copy into a PMem file if one is given, DRAM otherwise:
+/// copy [path] [size] [helper threads]
+int main(int argc, char **argv) {
+  uint64_t dest_size = argc > 2 ? strtoull(argv[2], nullptr, 10)
+                                : 4 * MAX_BLOCK_SIZE;
+  int helper_num = argc > 3 ? atoi(argv[3]) : 3;
+  char *dest = nullptr;
+  size_t mapped_len = 0;
+  if (argc > 1) {
+    int is_pmem = 0;
+    dest = static_cast<char *>(pmem_map_file(
+        argv[1], dest_size, PMEM_FILE_CREATE, 0666, &mapped_len, &is_pmem));
+    if (dest == nullptr) {
+      std::cerr << "failed to map " << argv[1] << std::endl;
+      return -1;
+    }
+    std::cout << argv[1] << (is_pmem ? " is" : " is not") << " pmem"
+              << std::endl;
+  } else {
+    dest = static_cast<char *>(aligned_alloc(4096, dest_size));
+  }
+  char *src = static_cast<char *>(aligned_alloc(4096, MAX_BLOCK_SIZE));
+  memset(src, 'a', MAX_BLOCK_SIZE);
+  memset(dest, 0, dest_size);
+
+  CopyEngine single;
+  CopyEngine split(helper_num);
+  std::cout << "kernel " << single.get_kernel_name() << ", " << helper_num
+            << " helper threads" << std::endl;
+  std::cout << "block size, memcpy MB/s, pmem_memcpy MB/s, engine MB/s, "
+               "engine split MB/s"
+            << std::endl;
+  for (uint64_t size = 4096; size <= MAX_BLOCK_SIZE; size *= 4) {
+    double memcpy_bw =
+        run(dest, dest_size, src, size,
+            [](char *d, const char *s, uint64_t n) { memcpy(d, s, n); });
+    double pmem_bw = run(dest, dest_size, src, size,
+                         [](char *d, const char *s, uint64_t n) {
+                           pmem_memcpy(d, s, n, PMEM_F_MEM_NONTEMPORAL);
+                         });
+    double single_bw =
+        run(dest, dest_size, src, size,
+            [&single](char *d, const char *s, uint64_t n) {
+              single.copy(d, s, n);
+            });
+    double split_bw = run(dest, dest_size, src, size,
+                          [&split](char *d, const char *s, uint64_t n) {
+                            split.copy(d, s, n);
+                          });
+    std::cout << size << ", " << memcpy_bw << ", " << pmem_bw << ", "
+              << single_bw << ", " << split_bw << std::endl;
+  }
+  if (argc > 1) {
+    pmem_unmap(dest, mapped_len);
+  } else {
+    free(dest);
+  }
+  free(src);
+  return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/benchmark/durability.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/benchmark
+ * Created Date: Tuesday, March 31st 2020, 3:12:40 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <string.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/AllocatorProxy.h"
+#include "../pmpool/Config.h"
+#include "../pmpool/Log.h"
+
+#define BLOCK_SIZE (1024 * 1024)
+#define BLOCK_NUM 4096
+/// writes drained together in group commit mode, as a worker batch.
+#define GROUP_SIZE 16
+
+uint64_t timestamp_now() {
+  return std::chrono::high_resolution_clock::now().time_since_epoch() /
+         std::chrono::milliseconds(1);
+}
+
+char str[BLOCK_SIZE];
+
+/// overwrite one block of every pool in turn and report the bandwidth.
+void run(Config *config, Log *log, const string &mode) {
+  config->set_durabilities({mode});
+  auto allocatorProxy = new AllocatorProxy(config, log, nullptr);
+  allocatorProxy->init();
+  int pool_num = config->get_pool_size();
+  std::vector<std::thread> threads;
+  uint64_t start = timestamp_now();
+  for (int i = 0; i < pool_num; i++) {
+    threads.emplace_back([allocatorProxy, pool_num, i] {
+      uint64_t addr =
+          allocatorProxy->allocate_and_write(BLOCK_SIZE, nullptr, i);
+      for (int j = 0; j < BLOCK_NUM / pool_num; j++) {
+        allocatorProxy->write(addr, str, BLOCK_SIZE);
+        if ((j + 1) % GROUP_SIZE == 0) {
+          allocatorProxy->drain(i);
+        }
+      }
+      allocatorProxy->drain(i);
+      allocatorProxy->release(addr);
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  uint64_t end = timestamp_now();
+  std::cout << mode << ": " << BLOCK_NUM << " writes of " << BLOCK_SIZE
+            << " bytes, throughput is "
+            << BLOCK_NUM * (BLOCK_SIZE / 1024 / 1024) * 1000.0 /
+                   (end - start + 1)
+            << "MB/s" << std::endl;
+  delete allocatorProxy;
+}
+
+int main(int argc, char **argv) {
+  std::shared_ptr<Config> config = std::make_shared<Config>();
+  if (config->init(argc, argv)) {
+    return -1;
+  }
+  std::shared_ptr<Log> log = std::make_shared<Log>(config.get());
+  memset(str, '0', BLOCK_SIZE);
+  for (string mode : {"volatile", "persist", "group"}) {
+    run(config.get(), log.get(), mode);
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/benchmark/recovery.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/benchmark
+ * Created Date: Saturday, March 21st 2020, 2:14:36 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/AllocatorProxy.h"
+#include "../pmpool/Config.h"
+#include "../pmpool/Log.h"
+#include "spdlog/sinks/ostream_sink.h"
+
+#define BLOCK_NUM (1 << 20)
+#define BLOCK_SIZE 4096
+
+uint64_t timestamp_now() {
+  return std::chrono::high_resolution_clock::now().time_since_epoch() /
+         std::chrono::milliseconds(1);
+}
+
+/// fill every pool with small blocks, then exit without closing the pools,
+/// as a crashed server would.
+void populate(Config *config, Log *log) {
+  auto allocatorProxy = new AllocatorProxy(config, log, nullptr);
+  allocatorProxy->init();
+  allocatorProxy->release_all();
+  int pool_num = config->get_pool_size();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < pool_num; i++) {
+    threads.emplace_back([allocatorProxy, pool_num, i] {
+      for (int j = 0; j < BLOCK_NUM / pool_num; j++) {
+        allocatorProxy->allocate_and_write(BLOCK_SIZE, nullptr, i);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  _exit(0);
+}
+
+uint64_t recover(Config *config, Log *log, AllocatorProxy **allocatorProxy) {
+  uint64_t start = timestamp_now();
+  *allocatorProxy = new AllocatorProxy(config, log, nullptr);
+  (*allocatorProxy)->init();
+  return timestamp_now() - start;
+}
+
+int main(int argc, char **argv) {
+  std::shared_ptr<Config> config = std::make_shared<Config>();
+  if (config->init(argc, argv)) {
+    return -1;
+  }
+  std::shared_ptr<Log> log = std::make_shared<Log>(config.get());
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    populate(config.get(), log.get());
+  }
+  int status;
+  waitpid(pid, &status, 0);
+
+  AllocatorProxy *allocatorProxy;
+  uint64_t crash_ms = recover(config.get(), log.get(), &allocatorProxy);
+  // a clean shutdown leaves an index checkpoint behind.
+  delete allocatorProxy;
+  std::ostringstream recovery_log;
+  auto file_log = log->get_file_log();
+  file_log->sinks().push_back(
+      std::make_shared<spdlog::sinks::ostream_sink_mt>(recovery_log));
+  file_log->set_level(spdlog::level::info);
+  uint64_t clean_ms = recover(config.get(), log.get(), &allocatorProxy);
+  file_log->sinks().pop_back();
+  // the slab allocator recovers from its slab headers and has no checkpoint.
+  if (config->get_allocator() != "slab") {
+    int checkpoints = 0;
+    std::istringstream lines(recovery_log.str());
+    string line;
+    while (std::getline(lines, line)) {
+      if (line.find("from checkpoint") != string::npos) {
+        checkpoints++;
+      }
+    }
+    if (checkpoints != config->get_pool_size()) {
+      std::cerr << "only " << checkpoints << " of " << config->get_pool_size()
+                << " pools were recovered from a checkpoint" << std::endl;
+      allocatorProxy->release_all();
+      delete allocatorProxy;
+      return -1;
+    }
+  }
+  std::cout << "recovery of " << BLOCK_NUM << " blocks with "
+            << config->get_allocator() << " allocator, after crash "
+            << crash_ms / 1000.0 << "s, after clean shutdown "
+            << clean_ms / 1000.0 << "s" << std::endl;
+  allocatorProxy->release_all();
+  delete allocatorProxy;
+  return 0;
+}
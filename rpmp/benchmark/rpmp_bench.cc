@@ -0,0 +1,583 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/benchmark/rpmp_bench.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/benchmark
+ * Created Date: Friday, April 3rd 2020, 10:15:32 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <boost/program_options.hpp>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "pmpool/Histogram.h"
+#include "pmpool/client/PmPoolClient.h"
+
+using boost::program_options::options_description;
+using boost::program_options::value;
+using boost::program_options::variables_map;
+
+/// open loop threads sleep until the next request is due if it is at least
+/// this far away, and spin otherwise.
+#define BENCH_SPIN_NS 50000
+
+enum BenchOp { OP_WRITE, OP_READ, OP_PUT, OP_GET, OP_ALLOC, OP_NUM };
+
+static const char *op_names[] = {"write", "read", "put", "get", "alloc_free"};
+
+uint64_t now_ns() { return LatencyStats::now(); }
+
+/// parse a byte count with an optional k, m or g suffix.
+bool parse_size(const string &text, uint64_t *size) {
+  char *end = nullptr;
+  *size = strtoull(text.c_str(), &end, 10);
+  if (end == text.c_str()) {
+    return false;
+  }
+  switch (*end) {
+    case 'k':
+    case 'K':
+      *size <<= 10;
+      end++;
+      break;
+    case 'm':
+    case 'M':
+      *size <<= 20;
+      end++;
+      break;
+    case 'g':
+    case 'G':
+      *size <<= 30;
+      end++;
+      break;
+    default:
+      break;
+  }
+  return *end == '\0' && *size != 0;
+}
+
+/**
+ * @brief Weighted picks one of a list of values at random, each with the
+ * probability of its weight. It is parsed from "value:weight,...", the
+ * weight defaults to 1.
+ */
+template <class T>
+class Weighted {
+ public:
+  bool parse(const string &text, std::function<bool(const string &, T *)> f) {
+    std::stringstream ss(text);
+    string item;
+    double total = 0;
+    while (std::getline(ss, item, ',')) {
+      auto colon = item.find(':');
+      double weight = 1;
+      if (colon != string::npos) {
+        weight = atof(item.c_str() + colon + 1);
+        item = item.substr(0, colon);
+      }
+      T t;
+      if (!f(item, &t) || weight <= 0) {
+        return false;
+      }
+      total += weight;
+      values_.push_back(t);
+      cumulative_.push_back(total);
+    }
+    for (auto &c : cumulative_) {
+      c /= total;
+    }
+    return !values_.empty();
+  }
+
+  T pick(std::mt19937_64 *rng) {
+    double p = std::uniform_real_distribution<double>(0, 1)(*rng);
+    for (uint64_t i = 0; i + 1 < values_.size(); i++) {
+      if (p < cumulative_[i]) {
+        return values_[i];
+      }
+    }
+    return values_.back();
+  }
+
+  const vector<T> &values() { return values_; }
+  double weight(uint64_t i) {
+    return cumulative_[i] - (i == 0 ? 0 : cumulative_[i - 1]);
+  }
+
+ private:
+  vector<T> values_;
+  vector<double> cumulative_;
+};
+
+struct BenchOptions {
+  string address;
+  string port;
+  int threads;
+  int clients;
+  int connections;
+  int duration;
+  int warmup;
+  bool open_loop;
+  bool poisson;
+  double rate;
+  uint64_t working_set;
+  uint64_t seed;
+  string sizes_text;
+  string mix_text;
+  string output;
+  Weighted<uint64_t> sizes;
+  Weighted<int> mix;
+};
+
+struct OpResult {
+  Histogram latency;
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> bytes{0};
+};
+
+/**
+ * @brief Bench runs a mix of operations against one server from several
+ * threads and clients, and records the latency of every operation that
+ * completes within the measured interval.
+ * In closed loop mode each thread issues its next request as soon as the
+ * previous one completed. In open loop mode requests are due at a fixed
+ * total rate, either evenly spaced or as a Poisson process, and latency is
+ * taken from the time a request was due rather than sent. A stalled server
+ * thus shows up in the latency of every request that queued up behind the
+ * stall, instead of delaying the requests and hiding it (coordinated
+ * omission).
+ */
+class Bench {
+ public:
+  explicit Bench(BenchOptions *options) : options_(options) {}
+
+  int run() {
+    for (int i = 0; i < options_->clients; i++) {
+      auto client = std::make_shared<PmPoolClient>(
+          options_->address, options_->port, options_->connections,
+          DEFAULT_MAX_INFLIGHT, false);
+      if (client->init()) {
+        std::cerr << "failed to connect to " << options_->address << ":"
+                  << options_->port << std::endl;
+        return -1;
+      }
+      clients_.push_back(client);
+    }
+    for (auto size : options_->sizes.values()) {
+      max_size_ = std::max(max_size_, size);
+    }
+    if (preload()) {
+      std::cerr << "failed to preload the working set" << std::endl;
+      return -1;
+    }
+    uint64_t start = now_ns();
+    measure_start_ = start + options_->warmup * 1000000000ULL;
+    measure_end_ = measure_start_ + options_->duration * 1000000000ULL;
+    put_keys_.resize(options_->threads, 0);
+    vector<std::thread> threads;
+    for (int i = 0; i < options_->threads; i++) {
+      threads.emplace_back([this, i, start] { worker(i, start); });
+    }
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds(measure_start_ - now_ns()));
+    have_stats_ = clients_[0]->stats(&stats_before_) == 0;
+    for (auto &t : threads) {
+      t.join();
+    }
+    have_stats_ = have_stats_ && clients_[0]->stats(&stats_after_) == 0;
+    cleanup();
+    report();
+    for (auto client : clients_) {
+      client->shutdown();
+      client->wait();
+    }
+    return 0;
+  }
+
+ private:
+  uint64_t block_num() { return options_->working_set; }
+
+  string get_key(uint64_t size_index, uint64_t i) {
+    return "rpmp_bench_get_" + std::to_string(size_index) + "_" +
+           std::to_string(i);
+  }
+
+  string put_key(int thread, uint64_t i) {
+    return "rpmp_bench_put_" + std::to_string(thread) + "_" +
+           std::to_string(i);
+  }
+
+  bool in_mix(BenchOp op) {
+    for (auto o : options_->mix.values()) {
+      if (o == op) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// write a working set of blocks and keys of every size, so that reads and
+  /// gets find data.
+  int preload() {
+    auto &sizes = options_->sizes.values();
+    vector<char> data(max_size_, 'a');
+    blocks_.resize(sizes.size());
+    auto client = clients_[0];
+    for (uint64_t s = 0; s < sizes.size(); s++) {
+      for (uint64_t i = 0; i < block_num(); i++) {
+        if (in_mix(OP_WRITE) || in_mix(OP_READ)) {
+          uint64_t address = client->write(data.data(), sizes[s]);
+          if (address == (uint64_t)-1) {
+            return -1;
+          }
+          blocks_[s].push_back(address);
+        }
+        if (in_mix(OP_GET)) {
+          /// a key left by an earlier run would hold more than one block.
+          client->del(get_key(s, i));
+          if (client->put(get_key(s, i), data.data(), sizes[s]) ==
+              (uint64_t)-1) {
+            return -1;
+          }
+        }
+      }
+    }
+    return 0;
+  }
+
+  void cleanup() {
+    auto client = clients_[0];
+    for (auto &blocks : blocks_) {
+      for (auto address : blocks) {
+        client->free(address);
+      }
+    }
+    for (uint64_t s = 0; s < options_->sizes.values().size(); s++) {
+      for (uint64_t i = 0; in_mix(OP_GET) && i < block_num(); i++) {
+        client->del(get_key(s, i));
+      }
+    }
+    for (int t = 0; t < options_->threads; t++) {
+      for (uint64_t i = 0; i < put_keys_[t]; i++) {
+        client->del(put_key(t, i));
+      }
+    }
+  }
+
+  void worker(int index, uint64_t start) {
+    PmPoolClient *client = clients_[index % clients_.size()].get();
+    std::mt19937_64 rng(options_->seed + index);
+    vector<char> data(max_size_, 'a' + index % 26);
+    /// each thread takes its share of the rate.
+    double interval = options_->open_loop
+                          ? options_->threads * 1e9 / options_->rate
+                          : 0;
+    std::exponential_distribution<double> arrivals(1 / std::max(interval, 1.0));
+    double due = start;
+    auto &sizes = options_->sizes.values();
+    while (true) {
+      uint64_t begin = now_ns();
+      if (options_->open_loop) {
+        due += options_->poisson ? arrivals(rng) : interval;
+        for (; begin < due; begin = now_ns()) {
+          if (due - begin > BENCH_SPIN_NS) {
+            std::this_thread::sleep_for(
+                std::chrono::nanoseconds((uint64_t)due - begin));
+          }
+        }
+      }
+      if (begin >= measure_end_) {
+        break;
+      }
+      uint64_t size_index = 0;
+      uint64_t size = options_->sizes.pick(&rng);
+      while (sizes[size_index] != size) {
+        size_index++;
+      }
+      BenchOp op = (BenchOp)options_->mix.pick(&rng);
+      uint64_t block = rng() % std::max<uint64_t>(block_num(), 1);
+      bool failed = false;
+      switch (op) {
+        case OP_WRITE: {
+          failed = client->write(blocks_[size_index][block], data.data(),
+                                 size) != 0;
+          break;
+        }
+        case OP_READ: {
+          failed = client->read(blocks_[size_index][block], data.data(),
+                                size) != 0;
+          break;
+        }
+        case OP_PUT: {
+          failed = client->put(put_key(index, put_keys_[index]++),
+                               data.data(), size) == (uint64_t)-1;
+          break;
+        }
+        case OP_GET: {
+          failed = client->get(get_key(size_index, block), data.data(),
+                               size) != size;
+          break;
+        }
+        case OP_ALLOC: {
+          uint64_t address = client->alloc(size);
+          failed = address == (uint64_t)-1 || client->free(address) != 0;
+          break;
+        }
+        default: { break; }
+      }
+      uint64_t end = now_ns();
+      if (begin < measure_start_) {
+        continue;
+      }
+      OpResult &result = results_[op];
+      uint64_t since = options_->open_loop ? (uint64_t)due : begin;
+      result.latency.record(end - since);
+      total_.record(end - since);
+      if (failed) {
+        result.errors.fetch_add(1, std::memory_order_relaxed);
+      } else if (op != OP_ALLOC) {
+        result.bytes.fetch_add(size, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static string json_latency(Histogram *histogram) {
+    auto us = [](double ns) { return std::to_string(ns / 1000); };
+    return "{\"mean\": " + us(histogram->get_mean()) +
+           ", \"p50\": " + us(histogram->get_percentile(50)) +
+           ", \"p99\": " + us(histogram->get_percentile(99)) +
+           ", \"p999\": " + us(histogram->get_percentile(99.9)) +
+           ", \"max\": " + us(histogram->get_max()) + "}";
+  }
+
+  static string json_string(const string &text) {
+    string quoted = "\"";
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        quoted += '\\';
+      }
+      quoted += c;
+    }
+    return quoted + "\"";
+  }
+
+  /// server side throughput and pool usage over the measured interval.
+  string json_server() {
+    std::ostringstream os;
+    os << "{\"ops_per_sec\": {";
+    static const OpType types[] = {WRITE, READ, PUT, GET, ALLOC, FREE};
+    static const char *names[] = {"write", "read", "put",
+                                  "get",   "alloc", "free"};
+    for (int i = 0; i < 6; i++) {
+      os << (i ? ", " : "") << json_string(names[i]) << ": "
+         << stats_after_.ops_per_sec(stats_before_, types[i]);
+    }
+    os << "}, \"mb_per_sec\": {";
+    for (int i = 0; i < 4; i++) {
+      os << (i ? ", " : "") << json_string(names[i]) << ": "
+         << stats_after_.bytes_per_sec(stats_before_, types[i]) / 1048576;
+    }
+    os << "}, \"buffer_used\": " << stats_after_.server.buffer_used
+       << ", \"buffer_mapped\": " << stats_after_.server.buffer_mapped
+       << ", \"pools\": [";
+    for (uint64_t i = 0; i < stats_after_.pools.size(); i++) {
+      pool_stats &pool = stats_after_.pools[i];
+      os << (i ? ", " : "") << "{\"capacity\": " << pool.capacity
+         << ", \"used\": " << pool.used << ", \"blocks\": " << pool.blocks
+         << ", \"fragmentation\": " << stats_after_.fragmentation(i) << "}";
+    }
+    os << "]}";
+    return os.str();
+  }
+
+  void report() {
+    double seconds = options_->duration;
+    std::ostringstream os;
+    os << "{\n  \"config\": {\"server\": "
+       << json_string(options_->address + ":" + options_->port)
+       << ", \"threads\": " << options_->threads
+       << ", \"clients\": " << options_->clients
+       << ", \"connections\": " << options_->connections
+       << ", \"mode\": "
+       << json_string(!options_->open_loop ? "closed"
+                                           : options_->poisson ? "poisson"
+                                                               : "open")
+       << ", \"rate\": " << (options_->open_loop ? options_->rate : 0)
+       << ", \"duration\": " << options_->duration
+       << ", \"warmup\": " << options_->warmup
+       << ", \"working_set\": " << options_->working_set
+       << ", \"seed\": " << options_->seed
+       << ", \"sizes\": " << json_string(options_->sizes_text)
+       << ", \"mix\": " << json_string(options_->mix_text) << "},\n";
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    os << "  \"ops\": {";
+    bool first = true;
+    for (int op = 0; op < OP_NUM; op++) {
+      OpResult &result = results_[op];
+      if (result.latency.get_count() == 0) {
+        continue;
+      }
+      errors += result.errors;
+      bytes += result.bytes;
+      os << (first ? "\n" : ",\n") << "    " << json_string(op_names[op])
+         << ": {\"ops\": " << result.latency.get_count()
+         << ", \"errors\": " << result.errors
+         << ", \"ops_per_sec\": " << result.latency.get_count() / seconds
+         << ", \"mb_per_sec\": " << result.bytes / seconds / 1048576
+         << ", \"latency_us\": " << json_latency(&result.latency) << "}";
+      first = false;
+    }
+    os << "\n  },\n  \"total\": {\"ops\": " << total_.get_count()
+       << ", \"errors\": " << errors
+       << ", \"ops_per_sec\": " << total_.get_count() / seconds
+       << ", \"mb_per_sec\": " << bytes / seconds / 1048576
+       << ", \"latency_us\": " << json_latency(&total_) << "}";
+    if (have_stats_) {
+      os << ",\n  \"server\": " << json_server();
+    }
+    os << "\n}\n";
+    if (options_->output.empty()) {
+      std::cout << os.str();
+    } else {
+      std::ofstream(options_->output) << os.str();
+    }
+  }
+
+  BenchOptions *options_;
+  vector<std::shared_ptr<PmPoolClient>> clients_;
+  uint64_t max_size_ = 0;
+  /// preloaded blocks per size.
+  vector<vector<uint64_t>> blocks_;
+  /// keys put by each thread.
+  vector<uint64_t> put_keys_;
+  uint64_t measure_start_ = 0;
+  uint64_t measure_end_ = 0;
+  OpResult results_[OP_NUM];
+  Histogram total_;
+  bool have_stats_ = false;
+  PmPoolStats stats_before_;
+  PmPoolStats stats_after_;
+};
+
+int parse_options(int argc, char **argv, BenchOptions *options) {
+  try {
+    options_description desc{"Options"};
+    desc.add_options()("help,h", "Help screen")(
+        "address,a", value<string>()->default_value("172.168.0.40"),
+        "set the rdma server address")(
+        "port,p", value<string>()->default_value("12346"),
+        "set the rdma server port")(
+        "threads,t", value<int>()->default_value(1),
+        "set threads issuing requests")(
+        "clients,c", value<int>()->default_value(1),
+        "set clients the threads are spread over round robin")(
+        "connections", value<int>()->default_value(1),
+        "set connections per client")(
+        "duration,d", value<int>()->default_value(10),
+        "set seconds measured")(
+        "warmup,w", value<int>()->default_value(2),
+        "set seconds run before measuring")(
+        "mode,m", value<string>()->default_value("closed"),
+        "set closed (loop), open (loop at a fixed rate) or poisson (open "
+        "loop with Poisson arrivals)")(
+        "rate,r", value<double>()->default_value(10000),
+        "set total requests per second in open loop modes")(
+        "sizes,s", value<string>()->default_value("4k"),
+        "set value sizes with optional weights, e.g. 4k:3,1m:1")(
+        "mix", value<string>()->default_value("write"),
+        "set operations with optional weights, of write, read, put, get "
+        "and alloc_free, e.g. write:1,read:4")(
+        "working_set", value<uint64_t>()->default_value(1024),
+        "set blocks and keys preloaded per value size")(
+        "seed", value<uint64_t>()->default_value(1),
+        "set seed of the random sizes and operations")(
+        "output,o", value<string>()->default_value(""),
+        "set file the JSON report is written to, stdout by default");
+
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << '\n';
+      return -1;
+    }
+    options->address = vm["address"].as<string>();
+    options->port = vm["port"].as<string>();
+    options->threads = vm["threads"].as<int>();
+    options->clients = vm["clients"].as<int>();
+    options->connections = vm["connections"].as<int>();
+    options->duration = vm["duration"].as<int>();
+    options->warmup = vm["warmup"].as<int>();
+    string mode = vm["mode"].as<string>();
+    options->open_loop = mode == "open" || mode == "poisson";
+    options->poisson = mode == "poisson";
+    options->rate = vm["rate"].as<double>();
+    options->working_set = vm["working_set"].as<uint64_t>();
+    options->seed = vm["seed"].as<uint64_t>();
+    options->sizes_text = vm["sizes"].as<string>();
+    options->mix_text = vm["mix"].as<string>();
+    options->output = vm["output"].as<string>();
+    if (options->threads < 1 || options->clients < 1 ||
+        options->connections < 1 || options->duration < 1 ||
+        options->warmup < 0 || options->working_set < 1) {
+      std::cerr << "threads, clients, connections, duration and working set "
+                   "must be positive"
+                << '\n';
+      return -1;
+    }
+    if (mode != "closed" && !options->open_loop) {
+      std::cerr << "unknown mode " << mode << '\n';
+      return -1;
+    }
+    if (options->open_loop && options->rate <= 0) {
+      std::cerr << "open loop modes need a positive rate" << '\n';
+      return -1;
+    }
+    if (!options->sizes.parse(options->sizes_text, parse_size)) {
+      std::cerr << "invalid sizes " << options->sizes_text << '\n';
+      return -1;
+    }
+    auto parse_op = [](const string &name, int *op) {
+      for (int i = 0; i < OP_NUM; i++) {
+        if (name == op_names[i]) {
+          *op = i;
+          return true;
+        }
+      }
+      return false;
+    };
+    if (!options->mix.parse(options->mix_text, parse_op)) {
+      std::cerr << "invalid mix " << options->mix_text << '\n';
+      return -1;
+    }
+  } catch (const boost::program_options::error &ex) {
+    std::cerr << ex.what() << '\n';
+    return -1;
+  }
+  return 0;
+}
+
+/// rpmp_bench --help lists the options, the report is JSON.
+int main(int argc, char **argv) {
+  BenchOptions options;
+  if (parse_options(argc, argv, &options)) {
+    return -1;
+  }
+  Bench bench(&options);
+  return bench.run();
+}
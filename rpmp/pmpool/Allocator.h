@@ -14,7 +14,10 @@
 
 #include <string>
 
+#include "Base.h"
+
 class Chunk;
+class CopyEngine;
 
 using std::string;
 
@@ -30,22 +33,69 @@ struct Addr {
   uint64_t size;
 };
 
+/// how the data written to a pool is made durable before it is acknowledged.
+enum DurabilityMode {
+  /// plain stores, data is durable only once the cache evicts it.
+  DURABILITY_VOLATILE,
+  /// non-temporal stores, drained by every write.
+  DURABILITY_PERSIST,
+  /// non-temporal stores, drained once per batch of completions by drain().
+  DURABILITY_GROUP_COMMIT
+};
+
+inline DurabilityMode to_durability_mode(const string& name) {
+  if (name == "volatile") {
+    return DURABILITY_VOLATILE;
+  }
+  if (name == "group") {
+    return DURABILITY_GROUP_COMMIT;
+  }
+  return DURABILITY_PERSIST;
+}
+
 struct DiskInfo {
-  DiskInfo(string& path_, uint64_t size_) : path(path_), size(size_) {}
+  DiskInfo(string& path_, uint64_t size_,
+           DurabilityMode durability_ = DURABILITY_PERSIST)
+      : path(path_), size(size_), durability(durability_) {}
   string path;
   uint64_t size;
+  DurabilityMode durability;
 };
 
 class Allocator {
  public:
+  virtual ~Allocator() = default;
   virtual int init() = 0;
   virtual uint64_t allocate_and_write(uint64_t buffer_size,
                                       const char* content = nullptr) = 0;
   virtual int write(uint64_t address, const char* content, uint64_t size) = 0;
   virtual int release(uint64_t address) = 0;
+  /// allocate from an arena, which is written once and released as a whole,
+  /// arena ids are chosen by the caller and must not be NO_ARENA.
+  virtual uint64_t allocate_in_arena(uint64_t arena, uint64_t buffer_size,
+                                     const char* content = nullptr) = 0;
+  /// release every block of the arena, return 0 if the arena does not exist.
+  virtual int release_arena(uint64_t arena) = 0;
   virtual int release_all() = 0;
   virtual int dump_all() = 0;
-  virtual uint64_t get_virtual_address(uint64_t address) = 0;
+  /// translate the global address of size bytes, return -1 unless they lie
+  /// in one allocated object.
+  virtual uint64_t get_virtual_address(uint64_t address, uint64_t size) = 0;
   virtual Chunk* get_rma_chunk() = 0;
+  /// make a range written through its virtual address durable.
+  virtual int persist(uint64_t address, uint64_t size) = 0;
+  /// flush data written through its virtual address, e.g. by RDMA, as the
+  /// durability mode of the pool requires.
+  virtual int flush(uint64_t address, uint64_t size) = 0;
+  /// wait for the writes and flushes left undrained in group commit mode.
+  virtual void drain() = 0;
+  /// copy durable writes with the engine instead of the PMDK copy.
+  virtual void set_copy_engine(CopyEngine* copyEngine) = 0;
+  /// fill in the space accounting of the pool, queue_depth is left alone.
+  virtual void get_stats(pool_stats* stats) = 0;
+  /// a persistent word of the pool for the pool metadata, 0 in a new pool and
+  /// after release_all.
+  virtual uint64_t get_meta_root() = 0;
+  virtual int set_meta_root(uint64_t address) = 0;
 };
 #endif  // PMPOOL_ALLOCATOR_H_
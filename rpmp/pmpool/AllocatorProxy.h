@@ -10,17 +10,24 @@
 #ifndef PMPOOL_ALLOCATORPROXY_H_
 #define PMPOOL_ALLOCATORPROXY_H_
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 #include <unordered_map>
 
 #include "Allocator.h"
 #include "Config.h"
+#include "CopyEngine.h"
 #include "DataServer.h"
 #include "Log.h"
+#include "MetaLog.h"
+#include "MetaStore.h"
 #include "PmemAllocator.h"
+#include "PmemSlabAllocator.h"
 #include "Base.h"
 
 using std::atomic;
@@ -38,31 +45,70 @@ class AllocatorProxy {
  public:
   AllocatorProxy() = delete;
   AllocatorProxy(Config *config, Log *log, NetworkServer *networkServer)
-      : config_(config), log_(log) {
+      : config_(config),
+        log_(log),
+        copyEngine_(make_shared<CopyEngine>(config->get_copy_threads())) {
     vector<string> paths = config_->get_pool_paths();
     vector<uint64_t> sizes = config_->get_pool_sizes();
     assert(paths.size() == sizes.size());
     for (int i = 0; i < paths.size(); i++) {
-      DiskInfo *diskInfo = new DiskInfo(paths[i], sizes[i]);
+      DiskInfo *diskInfo = new DiskInfo(
+          paths[i], sizes[i], to_durability_mode(config_->get_durability(i)));
       diskInfos_.push_back(diskInfo);
-      allocators_.push_back(
-          new PmemObjAllocator(log_, diskInfo, networkServer, i));
+      if (config_->get_allocator() == "slab") {
+        allocators_.push_back(
+            new PmemSlabAllocator(log_, diskInfo, networkServer, i));
+      } else {
+        allocators_.push_back(
+            new PmemObjAllocator(log_, diskInfo, networkServer, i));
+      }
+      allocators_[i]->set_copy_engine(copyEngine_.get());
+      metaLogs_.push_back(new MetaLog(allocators_[i]));
+      log_mtxs_.push_back(new std::mutex());
     }
+    live_blocks_.resize(paths.size(), 0);
+    log_->get_console_log()->info(
+        "copy into PMem with " + string(copyEngine_->get_kernel_name()) +
+        " kernel, " + std::to_string(copyEngine_->get_helper_num()) +
+        " helper threads");
   }
 
   ~AllocatorProxy() {
     for (int i = 0; i < config_->get_pool_paths().size(); i++) {
+      delete metaLogs_[i];
+      delete log_mtxs_[i];
       delete allocators_[i];
       delete diskInfos_[i];
     }
+    metaLogs_.clear();
+    log_mtxs_.clear();
     allocators_.clear();
     diskInfos_.clear();
   }
 
+  /// pools are independent, so they are created or recovered in parallel.
+  /// The key metadata is rebuilt from the meta logs of all pools afterwards.
   int init() {
+    vector<std::thread> threads;
+    vector<vector<meta_record>> records(diskInfos_.size());
     for (int i = 0; i < diskInfos_.size(); i++) {
-      allocators_[i]->init();
+      threads.emplace_back([this, i, &records] {
+        /// the index of a pool is built by this thread and its helpers, keep
+        /// it on the node of the pool.
+        if (i < config_->get_pool_nodes().size()) {
+          Numa::run_on_node(config_->get_pool_nodes()[i]);
+        }
+        allocators_[i]->init();
+        if (metaLogs_[i]->recover(&records[i])) {
+          log_->get_file_log()->error("corrupted meta log in " +
+                                      diskInfos_[i]->path);
+        }
+      });
     }
+    for (auto &t : threads) {
+      t.join();
+    }
+    recover_meta(&records);
     return 0;
   }
 
@@ -76,6 +122,27 @@ class AllocatorProxy {
       addr = allocators_[index % diskInfos_.size()]->allocate_and_write(
           size, content);
     }
+    return addr;
+  }
+
+  uint64_t allocate_in_arena(uint64_t arena, uint64_t size,
+                             const char *content = nullptr, int index = -1) {
+    if (index < 0) {
+      index = buffer_id_++;
+    }
+    return allocators_[index % diskInfos_.size()]->allocate_in_arena(
+        arena, size, content);
+  }
+
+  /// release the arena on every pool, return 0 if all succeed.
+  int release_arena(uint64_t arena) {
+    int res = 0;
+    for (int i = 0; i < diskInfos_.size(); i++) {
+      if (allocators_[i]->release_arena(arena)) {
+        res = -1;
+      }
+    }
+    return res;
   }
 
   int write(uint64_t address, const char *content, uint64_t size) {
@@ -83,14 +150,43 @@ class AllocatorProxy {
     return allocators_[wid]->write(address, content, size);
   }
 
+  /// flush data written to the block by other means than write, e.g. RDMA.
+  int flush(uint64_t address, uint64_t size) {
+    uint32_t wid = GET_WID(address);
+    return allocators_[wid]->flush(address, size);
+  }
+
+  void drain(uint32_t wid) { allocators_[wid]->drain(); }
+
+  void get_stats(uint32_t wid, pool_stats *stats) {
+    allocators_[wid]->get_stats(stats);
+  }
+
+  /// durability mode of the pool of the block, volatile for an invalid
+  /// address as there is nothing to make durable.
+  DurabilityMode get_durability(uint64_t address) {
+    uint32_t wid = GET_WID(address);
+    if (wid >= diskInfos_.size()) {
+      return DURABILITY_VOLATILE;
+    }
+    return diskInfos_[wid]->durability;
+  }
+
   int release(uint64_t address) {
     uint32_t wid = GET_WID(address);
     return allocators_[wid]->release(address);
   }
 
   int release_all() {
+    vector<std::unique_lock<std::mutex>> locks;
+    for (auto mtx : log_mtxs_) {
+      locks.emplace_back(*mtx);
+    }
+    metaStore_.clear();
     for (int i = 0; i < diskInfos_.size(); i++) {
       allocators_[i]->release_all();
+      metaLogs_[i]->clear();
+      live_blocks_[i] = 0;
     }
     return 0;
   }
@@ -102,9 +198,13 @@ class AllocatorProxy {
     return 0;
   }
 
-  uint64_t get_virtual_address(uint64_t address) {
+  /// return -1 unless size bytes at address lie in one allocated object.
+  uint64_t get_virtual_address(uint64_t address, uint64_t size) {
     uint32_t wid = GET_WID(address);
-    return allocators_[wid]->get_virtual_address(address);
+    if (wid >= diskInfos_.size()) {
+      return -1;
+    }
+    return allocators_[wid]->get_virtual_address(address, size);
   }
 
   Chunk *get_rma_chunk(uint64_t address) {
@@ -112,41 +212,144 @@ class AllocatorProxy {
     return allocators_[wid]->get_rma_chunk();
   }
 
-  void cache_chunk(uint64_t key, uint64_t address, uint64_t size) {
+  /// record a block of the key, the record is durable before it is visible.
+  /// Return -1 if the address is not in any pool.
+  int cache_chunk(uint64_t key, uint64_t address, uint64_t size) {
     block_meta bm = {address, size};
-    cache_chunk(key, bm);
+    return cache_chunk(key, bm);
   }
 
-  void cache_chunk(uint64_t key, block_meta bm) {
-    if (kv_meta_map.count(key)) {
-      kv_meta_map[key].push_back(bm);
-    } else {
-      vector<block_meta> bml;
-      bml.push_back(bm);
-      kv_meta_map[key] = bml;
+  int cache_chunk(uint64_t key, block_meta bm) {
+    uint32_t wid = GET_WID(bm.address);
+    if (wid >= diskInfos_.size()) {
+      return -1;
     }
+    std::lock_guard<std::mutex> l(*log_mtxs_[wid]);
+    metaStore_.append(key, bm, [&](uint64_t seq) {
+      meta_record record = {key, bm.address, bm.size, seq, 0, {0, 0, 0}};
+      if (metaLogs_[wid]->append(record)) {
+        log_->get_file_log()->warn("failed to persist metadata of key " +
+                                   std::to_string(key));
+      }
+    });
+    live_blocks_[wid]++;
+    maybe_compact(wid);
+    return 0;
   }
 
-  vector<block_meta> get_cached_chunk(uint64_t key) {
-    if (kv_meta_map.count(key)) {
-      return kv_meta_map[key];
-    }
-    return vector<block_meta>();
+  /// return the blocks of the key without copying them, nullptr if the key
+  /// does not exist.
+  shared_ptr<const vector<block_meta>> get_cached_chunk(uint64_t key) {
+    return metaStore_.get(key);
   }
 
-  void del_chunk(uint64_t key) {
-    if (kv_meta_map.count(key))  {
-      kv_meta_map.erase(key);
+  /// drop the key and return its blocks, which are no longer referenced by
+  /// the persistent metadata and can be released.
+  /// The seq of the tombstone is taken when the key is removed, so an
+  /// append racing with the removal is ordered the same way on recovery.
+  shared_ptr<const vector<block_meta>> del_chunk(uint64_t key) {
+    uint64_t seq = 0;
+    auto km = metaStore_.erase(key, &seq);
+    if (km == nullptr) {
+      return nullptr;
+    }
+    meta_record tombstone = {key, 0, 0, seq, 0, {0, 0, 0}};
+    vector<uint64_t> blocks(diskInfos_.size(), 0);
+    for (auto &bm : km->bml) {
+      blocks[GET_WID(bm.address)]++;
     }
+    for (int i = 0; i < diskInfos_.size(); i++) {
+      if (blocks[i] == 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> l(*log_mtxs_[i]);
+      if (metaLogs_[i]->append(tombstone)) {
+        log_->get_file_log()->warn("failed to persist deletion of key " +
+                                   std::to_string(key));
+      }
+      live_blocks_[i] -= blocks[i];
+      maybe_compact(i);
+    }
+    return shared_ptr<const vector<block_meta>>(km, &km->bml);
   }
 
  private:
+  /// replay the records of all pools in seq order, a key may have blocks in
+  /// several pools.
+  void recover_meta(vector<vector<meta_record>> *records) {
+    vector<meta_record> all;
+    for (auto &pool_records : *records) {
+      all.insert(all.end(), pool_records.begin(), pool_records.end());
+    }
+    std::sort(all.begin(), all.end(),
+              [](const meta_record &a, const meta_record &b) {
+                return a.seq < b.seq;
+              });
+    metaStore_.clear();
+    std::fill(live_blocks_.begin(), live_blocks_.end(), 0);
+    for (auto &record : all) {
+      metaStore_.advance_seq(record.seq);
+      if (record.address == 0) {
+        auto km = metaStore_.erase(record.key);
+        if (km != nullptr) {
+          for (auto &bm : km->bml) {
+            live_blocks_[GET_WID(bm.address)]--;
+          }
+        }
+      } else if (GET_WID(record.address) < diskInfos_.size()) {
+        metaStore_.replay(record.key, block_meta(record.address, record.size),
+                          record.seq);
+        live_blocks_[GET_WID(record.address)]++;
+      }
+    }
+    for (int i = 0; i < diskInfos_.size(); i++) {
+      if (metaLogs_[i]->size() > live_blocks_[i]) {
+        compact(i);
+      }
+    }
+  }
+
+  void maybe_compact(int wid) {
+    if (metaLogs_[wid]->size() >
+        2 * live_blocks_[wid] + META_LOG_RECORDS_PER_SEGMENT) {
+      compact(wid);
+    }
+  }
+
+  /// rewrite the log of a pool with its live blocks only. The original seqs
+  /// are kept, so the logs of the other pools stay consistent with it.
+  void compact(int wid) {
+    vector<meta_record> records;
+    metaStore_.for_each([&](uint64_t key, const key_meta &km) {
+      for (uint64_t i = 0; i < km.bml.size(); i++) {
+        if (GET_WID(km.bml[i].address) == wid) {
+          records.push_back({key, km.bml[i].address, km.bml[i].size,
+                             km.seqs[i], 0, {0, 0, 0}});
+        }
+      }
+    });
+    std::sort(records.begin(), records.end(),
+              [](const meta_record &a, const meta_record &b) {
+                return a.seq < b.seq;
+              });
+    if (metaLogs_[wid]->rewrite(records)) {
+      log_->get_file_log()->warn("failed to compact meta log in " +
+                                 diskInfos_[wid]->path);
+    }
+  }
+
   Config *config_;
   Log *log_;
   vector<Allocator *> allocators_;
   vector<DiskInfo *> diskInfos_;
+  std::shared_ptr<CopyEngine> copyEngine_;
   atomic<uint64_t> buffer_id_{0};
-  unordered_map<uint64_t, vector<block_meta>> kv_meta_map;
+  MetaStore metaStore_;
+  vector<MetaLog *> metaLogs_;
+  /// one lock per meta log, it also guards the live block count of the pool
+  /// and keeps the key metadata still while the log is compacted.
+  vector<std::mutex *> log_mtxs_;
+  vector<uint64_t> live_blocks_;
 };
 
 #endif  // PMPOOL_ALLOCATORPROXY_H_
@@ -24,6 +24,17 @@
     }                                                               \
   }
 
+/// Maximum number of sub-requests carried by one BATCH request, chosen so
+/// that a batch always fits into one network buffer.
+#define MAX_BATCH_SIZE 1024
+
+/// key of ALLOC and WRITE requests whose blocks do not belong to an arena,
+/// any other key is the id of the arena to allocate from.
+#define NO_ARENA 0
+
+/// A BATCH request is encoded as one RequestMsg header, whose size is the
+/// number of sub-requests, followed by that many RequestMsg. Its reply is one
+/// RequestReplyMsg header followed by one RequestReplyMsg per sub-request.
 struct RequestMsg {
   uint32_t type;
   uint64_t rid;
@@ -43,6 +54,45 @@ struct RequestReplyMsg {
   uint64_t key;
 };
 
+/// request types counted by a STATS reply, indexed by OpType.
+#define STATS_OP_NUM 16
+
+/// A STATS reply is one RequestReplyMsg, whose size is the number of pools,
+/// followed by one server_stats and one pool_stats per pool. Counters are
+/// totals since the server started, rates are taken between two replies.
+struct op_stats {
+  /// requests received.
+  uint64_t ops;
+  /// bytes written to or read from the pools.
+  uint64_t bytes;
+};
+
+struct server_stats {
+  /// ns since the server started.
+  uint64_t uptime;
+  /// replies waiting for the finalize worker.
+  uint64_t finalize_queue_depth;
+  /// bytes of the network buffer pool that are mapped, and in use by
+  /// transfers staged in DRAM.
+  uint64_t buffer_mapped;
+  uint64_t buffer_used;
+  /// gets that had to wait for a buffer to be put back.
+  uint64_t buffer_waits;
+  op_stats ops[STATS_OP_NUM];
+};
+
+struct pool_stats {
+  uint64_t capacity;
+  /// bytes taken by live blocks, free is capacity - used.
+  uint64_t used;
+  /// largest block that can still be allocated, free space beyond it is
+  /// fragmented.
+  uint64_t largest_free;
+  uint64_t blocks;
+  /// requests and RDMA completions waiting for the workers of the pool.
+  uint64_t queue_depth;
+};
+
 struct block_meta {
   block_meta() : block_meta(0, 0) {}
   block_meta(uint64_t _address, uint64_t _size)
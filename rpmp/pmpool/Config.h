@@ -12,11 +12,14 @@
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
 #include <boost/program_options.hpp>
 
+#include "Numa.h"
+
 using boost::program_options::error;
 using boost::program_options::options_description;
 using boost::program_options::value;
@@ -44,8 +47,40 @@ class Config {
           "set network buffer number")("network_worker,nw",
                                        value<int>()->default_value(1),
                                        "set network wroker number")(
-          "paths,ps", value<vector<string>>(), "set memory pool path")(
-          "sizes,ss", value<vector<int>>(), "set memory pool size")(
+          "paths,ps", value<vector<string>>()->multitoken(),
+          "set memory pool path")(
+          "sizes,ss", value<vector<uint64_t>>()->multitoken(),
+          "set memory pool size in bytes, one per path")(
+          "affinities,af", value<vector<int>>()->multitoken(),
+          "set worker cpu per pool, derived from NUMA topology by default")(
+          "allocator", value<string>()->default_value("pmemobj"),
+          "set pmem allocator, pmemobj or slab")(
+          "worker_mode", value<string>()->default_value("pipeline"),
+          "set request handling, pipeline or rtc (run to completion)")(
+          "poll_policy", value<string>()->default_value("spin"),
+          "set how idle workers wait, busy, spin (then park) or block")(
+          "poll_spin_num", value<int>()->default_value(2000),
+          "set empty polls before an idle worker parks")(
+          "worker_stats_interval", value<int>()->default_value(0),
+          "set seconds between worker statistics logs, 0 to disable")(
+          "latency_stats", value<bool>()->default_value(true),
+          "set whether per stage latency histograms are recorded")(
+          "latency_stats_interval", value<int>()->default_value(0),
+          "set seconds between latency histogram logs, 0 to disable")(
+          "buffer_num", value<int>()->default_value(4096),
+          "set maximum number of 1MB staging buffers")(
+          "buffer_init_num", value<int>()->default_value(256),
+          "set staging buffers mapped at startup, the rest on demand")(
+          "buffer_hugepage", value<bool>()->default_value(true),
+          "set whether staging buffers use hugepages")(
+          "buffer_prefault", value<bool>()->default_value(false),
+          "set whether staging buffers are faulted in when mapped")(
+          "zero_copy_write", value<bool>()->default_value(false),
+          "set whether writes are RDMA read straight into PMem")(
+          "durability", value<vector<string>>()->multitoken(),
+          "set volatile, persist or group (commit) per pool, or one for all")(
+          "copy_threads", value<int>()->default_value(0),
+          "set helper threads that share large copies into PMem")(
           "log,l", value<string>()->default_value("/tmp/rpmp.log"),
           "set rpmp log file path")("log_level,ll",
                                     value<string>()->default_value("warn"),
@@ -64,18 +99,46 @@ class Config {
       set_network_buffer_size(vm["network_buffer_size"].as<int>());
       set_network_buffer_num(vm["network_buffer_num"].as<int>());
       set_network_worker_num(vm["network_worker"].as<int>());
-      pool_paths_.push_back("/dev/dax0.0");
-      pool_paths_.push_back("/dev/dax0.1");
-      pool_paths_.push_back("/dev/dax1.0");
-      pool_paths_.push_back("/dev/dax1.1");
-      sizes_.push_back(126833655808L);
-      sizes_.push_back(126833655808L);
-      sizes_.push_back(126833655808L);
-      sizes_.push_back(126833655808L);
-      affinities_.push_back(2);
-      affinities_.push_back(41);
-      affinities_.push_back(22);
-      affinities_.push_back(60);
+      if (vm.count("paths")) {
+        pool_paths_ = vm["paths"].as<vector<string>>();
+        if (vm.count("sizes")) {
+          sizes_ = vm["sizes"].as<vector<uint64_t>>();
+        }
+        if (sizes_.size() != pool_paths_.size()) {
+          std::cerr << "one size is required per pool path" << '\n';
+          return -1;
+        }
+      } else {
+        pool_paths_.push_back("/dev/dax0.0");
+        pool_paths_.push_back("/dev/dax0.1");
+        pool_paths_.push_back("/dev/dax1.0");
+        pool_paths_.push_back("/dev/dax1.1");
+        sizes_.push_back(126833655808L);
+        sizes_.push_back(126833655808L);
+        sizes_.push_back(126833655808L);
+        sizes_.push_back(126833655808L);
+      }
+      vector<int> affinities;
+      if (vm.count("affinities")) {
+        affinities = vm["affinities"].as<vector<int>>();
+      }
+      discover_topology(affinities);
+      set_allocator(vm["allocator"].as<string>());
+      set_worker_mode(vm["worker_mode"].as<string>());
+      set_poll_policy(vm["poll_policy"].as<string>());
+      set_poll_spin_num(vm["poll_spin_num"].as<int>());
+      set_worker_stats_interval(vm["worker_stats_interval"].as<int>());
+      set_latency_stats(vm["latency_stats"].as<bool>());
+      set_latency_stats_interval(vm["latency_stats_interval"].as<int>());
+      set_buffer_num(vm["buffer_num"].as<int>());
+      set_buffer_init_num(vm["buffer_init_num"].as<int>());
+      set_buffer_hugepage(vm["buffer_hugepage"].as<bool>());
+      set_buffer_prefault(vm["buffer_prefault"].as<bool>());
+      set_zero_copy_write(vm["zero_copy_write"].as<bool>());
+      set_copy_threads(vm["copy_threads"].as<int>());
+      if (vm.count("durability")) {
+        set_durabilities(vm["durability"].as<vector<string>>());
+      }
       set_log_path(vm["log"].as<string>());
       set_log_level(vm["log_level"].as<string>());
     } catch (const error &ex) {
@@ -115,7 +178,109 @@ class Config {
 
   int get_pool_size() { return sizes_.size(); }
 
+  /// cpu of the worker that owns each pool.
   std::vector<uint64_t> get_affinities_() { return affinities_; }
+  /// cpu of the worker that receives the requests of each pool.
+  std::vector<uint64_t> get_recv_affinities() { return recv_affinities_; }
+
+  /// NUMA node of each pool, -1 if unknown.
+  std::vector<int> get_pool_nodes() { return pool_nodes_; }
+  /// NUMA node of the NIC serving the server address, -1 if unknown.
+  int get_nic_node() { return nic_node_; }
+
+  /// find the NUMA node of every pool and of the NIC, and place the workers
+  /// of a pool on cpus of its node, two distinct cpus per pool. Given
+  /// affinities take precedence, the receiving worker then runs on the cpu
+  /// before, as do the workers without known topology.
+  void discover_topology(const vector<int> &affinities) {
+    const int default_affinities[] = {2, 41, 22, 60};
+    pool_nodes_.clear();
+    affinities_.clear();
+    recv_affinities_.clear();
+    nic_node_ = Numa::node_of_address(ip_);
+    std::map<int, uint64_t> next_cpu;
+    for (uint64_t i = 0; i < pool_paths_.size(); i++) {
+      int node = Numa::node_of_path(pool_paths_[i]);
+      pool_nodes_.push_back(node);
+      vector<int> cpus = Numa::cpus_of_node(node);
+      if (i < affinities.size() || cpus.size() < 2) {
+        int cpu = i < affinities.size() ? affinities[i]
+                                        : default_affinities[i % 4];
+        affinities_.push_back(cpu);
+        recv_affinities_.push_back(cpu > 0 ? cpu - 1 : cpu);
+        continue;
+      }
+      /// leave the first cpu of the node to the system and network threads.
+      uint64_t &next = next_cpu[node];
+      recv_affinities_.push_back(cpus[1 + next++ % (cpus.size() - 1)]);
+      affinities_.push_back(cpus[1 + next++ % (cpus.size() - 1)]);
+    }
+  }
+
+  string get_allocator() { return allocator_; }
+  void set_allocator(string allocator) { allocator_ = allocator; }
+
+  /// in rtc mode one thread per allocator handles a request end to end.
+  bool is_run_to_completion() { return worker_mode_ == "rtc"; }
+  string get_worker_mode() { return worker_mode_; }
+  void set_worker_mode(string worker_mode) { worker_mode_ = worker_mode; }
+
+  string get_poll_policy() { return poll_policy_; }
+  void set_poll_policy(string poll_policy) { poll_policy_ = poll_policy; }
+
+  int get_poll_spin_num() { return poll_spin_num_; }
+  void set_poll_spin_num(int poll_spin_num) { poll_spin_num_ = poll_spin_num; }
+
+  int get_worker_stats_interval() { return worker_stats_interval_; }
+  void set_worker_stats_interval(int worker_stats_interval) {
+    worker_stats_interval_ = worker_stats_interval;
+  }
+
+  bool get_latency_stats() { return latency_stats_; }
+  void set_latency_stats(bool latency_stats) { latency_stats_ = latency_stats; }
+
+  int get_latency_stats_interval() { return latency_stats_interval_; }
+  void set_latency_stats_interval(int latency_stats_interval) {
+    latency_stats_interval_ = latency_stats_interval;
+  }
+
+  int get_buffer_num() { return buffer_num_; }
+  void set_buffer_num(int buffer_num) { buffer_num_ = buffer_num; }
+
+  int get_buffer_init_num() { return buffer_init_num_; }
+  void set_buffer_init_num(int buffer_init_num) {
+    buffer_init_num_ = buffer_init_num;
+  }
+
+  bool get_buffer_hugepage() { return buffer_hugepage_; }
+  void set_buffer_hugepage(bool buffer_hugepage) {
+    buffer_hugepage_ = buffer_hugepage;
+  }
+
+  bool get_buffer_prefault() { return buffer_prefault_; }
+  void set_buffer_prefault(bool buffer_prefault) {
+    buffer_prefault_ = buffer_prefault;
+  }
+
+  bool is_zero_copy_write() { return zero_copy_write_; }
+  void set_zero_copy_write(bool zero_copy_write) {
+    zero_copy_write_ = zero_copy_write;
+  }
+
+  /// durability mode of the pool, the last given mode applies to the rest.
+  string get_durability(uint64_t index) {
+    if (durabilities_.empty()) {
+      return "persist";
+    }
+    return index < durabilities_.size() ? durabilities_[index]
+                                        : durabilities_.back();
+  }
+  void set_durabilities(const vector<string> &durabilities) {
+    durabilities_ = durabilities;
+  }
+
+  int get_copy_threads() { return copy_threads_; }
+  void set_copy_threads(int copy_threads) { copy_threads_ = copy_threads; }
 
   string get_log_path() { return log_path_; }
   void set_log_path(string log_path) { log_path_ = log_path; }
@@ -132,6 +297,23 @@ class Config {
   vector<string> pool_paths_;
   vector<uint64_t> sizes_;
   vector<uint64_t> affinities_;
+  vector<uint64_t> recv_affinities_;
+  vector<int> pool_nodes_;
+  int nic_node_ = -1;
+  string allocator_;
+  string worker_mode_;
+  string poll_policy_;
+  int poll_spin_num_;
+  int worker_stats_interval_;
+  bool latency_stats_ = true;
+  int latency_stats_interval_ = 0;
+  int buffer_num_;
+  int buffer_init_num_;
+  bool buffer_hugepage_;
+  bool buffer_prefault_;
+  bool zero_copy_write_;
+  vector<string> durabilities_;
+  int copy_threads_ = 0;
   string log_path_;
   string log_level_;
 };
@@ -0,0 +1,238 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/CopyEngine.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Wednesday, April 1st 2020, 10:24:17 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_COPYENGINE_H_
+#define PMPOOL_COPYENGINE_H_
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "ThreadWrapper.h"
+#include "WorkerQueue.h"
+
+#define COPY_CACHE_LINE 64
+/// PMem write unit, full units are written without read-modify-write.
+#define COPY_UNIT 256
+/// copies from this size on are split across the helper threads.
+#define COPY_SPLIT_THRESHOLD (4 * 1024 * 1024)
+/// smallest part of a split copy.
+#define COPY_PART_MIN (1024 * 1024)
+
+/// copy whole cache lines to a 64 byte aligned dest with non-temporal stores,
+/// 64 bytes at a time until dest is aligned to COPY_UNIT, then a unit at a
+/// time.
+typedef void (*CopyKernel)(char *dest, const char *src, uint64_t size);
+
+__attribute__((target("avx512f"))) inline void copy_lines_avx512(
+    char *dest, const char *src, uint64_t size) {
+  for (; size != 0 && ((uint64_t)dest & (COPY_UNIT - 1)) != 0;
+       dest += 64, src += 64, size -= 64) {
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dest),
+                        _mm512_loadu_si512(src));
+  }
+  for (; size >= COPY_UNIT;
+       dest += COPY_UNIT, src += COPY_UNIT, size -= COPY_UNIT) {
+    __m512i v0 = _mm512_loadu_si512(src);
+    __m512i v1 = _mm512_loadu_si512(src + 64);
+    __m512i v2 = _mm512_loadu_si512(src + 128);
+    __m512i v3 = _mm512_loadu_si512(src + 192);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dest), v0);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dest + 64), v1);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dest + 128), v2);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dest + 192), v3);
+  }
+  for (; size != 0; dest += 64, src += 64, size -= 64) {
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dest),
+                        _mm512_loadu_si512(src));
+  }
+}
+
+__attribute__((target("avx2"))) inline void copy_lines_avx2(char *dest,
+                                                           const char *src,
+                                                           uint64_t size) {
+  for (; size != 0 && ((uint64_t)dest & (COPY_UNIT - 1)) != 0;
+       dest += 64, src += 64, size -= 64) {
+    __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+    __m256i v1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest), v0);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + 32), v1);
+  }
+  for (; size >= COPY_UNIT;
+       dest += COPY_UNIT, src += COPY_UNIT, size -= COPY_UNIT) {
+    __m256i v[8];
+    for (int i = 0; i < 8; i++) {
+      v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src) + i);
+    }
+    for (int i = 0; i < 8; i++) {
+      _mm256_stream_si256(reinterpret_cast<__m256i *>(dest) + i, v[i]);
+    }
+  }
+  for (; size != 0; dest += 64, src += 64, size -= 64) {
+    __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+    __m256i v1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest), v0);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + 32), v1);
+  }
+}
+
+/// SSE2 is always there on x86_64.
+inline void copy_lines_sse2(char *dest, const char *src, uint64_t size) {
+  for (; size != 0; dest += 64, src += 64, size -= 64) {
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) {
+      v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src) + i);
+    }
+    for (int i = 0; i < 4; i++) {
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dest) + i, v[i]);
+    }
+  }
+}
+
+class CopyEngine;
+
+/// one part of a split copy, pending is decremented once it is drained.
+struct CopyTask {
+  char *dest;
+  const char *src;
+  uint64_t size;
+  std::atomic<int> *pending;
+};
+
+class CopyHelper : public ThreadWrapper {
+ public:
+  CopyHelper() = delete;
+  explicit CopyHelper(CopyEngine *engine)
+      : engine_(engine), pendingTaskQueue_(POLL_BLOCK, 0) {}
+  ~CopyHelper() override = default;
+  int entry() override;
+  void abort() override {}
+  void addTask(const CopyTask &task) { pendingTaskQueue_.enqueue(task); }
+
+ private:
+  CopyEngine *engine_;
+  WorkerQueue<CopyTask> pendingTaskQueue_;
+};
+
+/**
+ * @brief CopyEngine copies data into PMem with non-temporal stores, so that it
+ * bypasses the cache and needs no flush, only a drain. The widest kernel the
+ * cpu supports is picked at runtime. Large copies are split at COPY_UNIT
+ * boundaries across helper threads, each helper drains its own part before it
+ * reports completion. The stores of the calling thread are not drained, so
+ * that group commit can drain them once per batch.
+ */
+class CopyEngine {
+ public:
+  CopyEngine(const CopyEngine &) = delete;
+  explicit CopyEngine(int helper_num = 0) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      kernel_ = copy_lines_avx512;
+      kernel_name_ = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+      kernel_ = copy_lines_avx2;
+      kernel_name_ = "avx2";
+    } else {
+      kernel_ = copy_lines_sse2;
+      kernel_name_ = "sse2";
+    }
+    for (int i = 0; i < helper_num; i++) {
+      helpers_.push_back(std::make_shared<CopyHelper>(this));
+      helpers_.back()->start();
+    }
+  }
+  ~CopyEngine() {
+    for (auto helper : helpers_) {
+      helper->stop();
+      helper->join();
+    }
+  }
+
+  void copy(char *dest, const char *src, uint64_t size) {
+    uint64_t part_num = helpers_.size() + 1;
+    if (size < COPY_SPLIT_THRESHOLD || part_num == 1) {
+      copy_part(dest, src, size);
+      return;
+    }
+    part_num = std::min(part_num, size / COPY_PART_MIN);
+    uint64_t part_size = (size + part_num - 1) / part_num;
+    part_size = (part_size + COPY_UNIT - 1) / COPY_UNIT * COPY_UNIT;
+    part_num = (size + part_size - 1) / part_size;
+    std::atomic<int> pending(part_num - 1);
+    for (uint64_t i = 1; i < part_num; i++) {
+      uint64_t offset = i * part_size;
+      uint64_t len = std::min(part_size, size - offset);
+      helpers_[next_helper_++ % helpers_.size()]->addTask(
+          {dest + offset, src + offset, len, &pending});
+    }
+    copy_part(dest, src, part_size);
+    while (pending.load(std::memory_order_acquire) != 0) {
+      _mm_pause();
+    }
+  }
+
+  /// copy on this thread, partial cache lines at both ends are written with
+  /// regular stores and flushed.
+  void copy_part(char *dest, const char *src, uint64_t size) {
+    uint64_t head = -(uint64_t)dest & (COPY_CACHE_LINE - 1);
+    if (head != 0) {
+      head = std::min(head, size);
+      copy_flush(dest, src, head);
+      dest += head;
+      src += head;
+      size -= head;
+    }
+    uint64_t lines = size & ~(uint64_t)(COPY_CACHE_LINE - 1);
+    if (lines != 0) {
+      kernel_(dest, src, lines);
+    }
+    if (size != lines) {
+      copy_flush(dest + lines, src + lines, size - lines);
+    }
+  }
+
+  /// wait for the non-temporal stores and flushes of this thread.
+  static void drain() { _mm_sfence(); }
+
+  const char *get_kernel_name() { return kernel_name_; }
+  int get_helper_num() { return helpers_.size(); }
+
+ private:
+  /// dest and dest + size - 1 are within one cache line.
+  static void copy_flush(char *dest, const char *src, uint64_t size) {
+    memcpy(dest, src, size);
+    _mm_clflush(dest);
+  }
+
+  CopyKernel kernel_;
+  const char *kernel_name_;
+  std::vector<std::shared_ptr<CopyHelper>> helpers_;
+  std::atomic<uint64_t> next_helper_{0};
+};
+
+inline int CopyHelper::entry() {
+  CopyTask tasks[WORKER_DEQUEUE_BULK];
+  size_t num = pendingTaskQueue_.dequeue_bulk(tasks, WORKER_DEQUEUE_BULK);
+  for (size_t i = 0; i < num; i++) {
+    engine_->copy_part(tasks[i].dest, tasks[i].src, tasks[i].size);
+    CopyEngine::drain();
+    tasks[i].pending->fetch_sub(1, std::memory_order_release);
+  }
+  return 0;
+}
+
+#endif  // PMPOOL_COPYENGINE_H_
@@ -9,29 +9,40 @@
 
 #include "pmpool/Event.h"
 
-#include "pmpool/buffer/CircularBuffer.h"
-
 Request::Request(RequestContext requestContext)
-    : data_(nullptr), size_(0), requestContext_(requestContext) {}
+    : requestContext_(requestContext) {}
 
-Request::Request(char *data, uint64_t size, Connection *con) : size_(size) {
-  data_ = static_cast<char *>(std::malloc(size));
-  memcpy(data_, data, size_);
-  requestContext_.con = con;
+RequestContext &Request::get_rc() { return requestContext_; }
+
+void Request::reset() {
+  requestContext_.type = (OpType)0;
+  requestContext_.rid = 0;
+  requestContext_.address = 0;
+  requestContext_.src_address = 0;
+  requestContext_.src_rkey = 0;
+  requestContext_.size = 0;
+  requestContext_.key = 0;
+  requestContext_.con = nullptr;
+  /// keep the capacity of the batch vector for the next request
+  requestContext_.batch.clear();
+  requestContext_.batch_parent = nullptr;
+  requestContext_.batch_index = 0;
+  requestContext_.stamp = 0;
 }
 
-Request::~Request() {
-  if (data_ != nullptr) {
-    std::free(data_);
-    data_ = nullptr;
+uint64_t Request::encoded_size() {
+  uint64_t size = sizeof(requestMsg_);
+  if (requestContext_.type == BATCH) {
+    size += sizeof(RequestMsg) * requestContext_.batch.size();
   }
+  return size;
 }
 
-RequestContext &Request::get_rc() { return requestContext_; }
-
-void Request::encode() {
+void Request::encode(char *data, uint64_t *size) {
   OpType rt = requestContext_.type;
-  assert(rt == ALLOC || rt == FREE || rt == WRITE || rt == READ);
+  assert(rt == ALLOC || rt == FREE || rt == WRITE || rt == READ || rt == PUT ||
+         rt == GET || rt == GET_META || rt == DELETE || rt == BATCH ||
+         rt == FREE_ARENA || rt == STATS);
   requestMsg_.type = requestContext_.type;
   requestMsg_.rid = requestContext_.rid;
   requestMsg_.address = requestContext_.address;
@@ -40,14 +51,26 @@ void Request::encode() {
   requestMsg_.size = requestContext_.size;
   requestMsg_.key = requestContext_.key;
 
-  size_ = sizeof(requestMsg_);
-  data_ = static_cast<char *>(std::malloc(size_));
-  memcpy(data_, &requestMsg_, size_);
+  auto msg_size = sizeof(requestMsg_);
+  *size = msg_size;
+
+  /// copy sub-requests of batch request
+  uint64_t batch_size = 0;
+  if (rt == BATCH) {
+    assert(requestContext_.batch.size() <= MAX_BATCH_SIZE);
+    requestMsg_.size = requestContext_.batch.size();
+    batch_size = sizeof(RequestMsg) * requestContext_.batch.size();
+    *size += batch_size;
+  }
+  memcpy(data, &requestMsg_, msg_size);
+  if (batch_size != 0) {
+    memcpy(data + msg_size, &requestContext_.batch[0], batch_size);
+  }
 }
 
-void Request::decode() {
-  assert(size_ == sizeof(requestMsg_));
-  memcpy(&requestMsg_, data_, size_);
+void Request::decode(const char *data, uint64_t size, Connection *con) {
+  assert(size >= sizeof(requestMsg_));
+  memcpy(&requestMsg_, data, sizeof(requestMsg_));
   requestContext_.type = (OpType)requestMsg_.type;
   requestContext_.rid = requestMsg_.rid;
   requestContext_.address = requestMsg_.address;
@@ -55,28 +78,64 @@ void Request::decode() {
   requestContext_.src_rkey = requestMsg_.src_rkey;
   requestContext_.size = requestMsg_.size;
   requestContext_.key = requestMsg_.key;
+  requestContext_.con = con;
+  requestContext_.batch_parent = nullptr;
+  requestContext_.batch_index = 0;
+  if (requestContext_.type == BATCH) {
+    assert(size == sizeof(requestMsg_) + requestMsg_.size * sizeof(RequestMsg));
+    requestContext_.batch.resize(requestMsg_.size);
+    if (requestMsg_.size != 0) {
+      memcpy(&requestContext_.batch[0], data + sizeof(requestMsg_),
+             requestMsg_.size * sizeof(RequestMsg));
+    }
+  } else {
+    requestContext_.batch.clear();
+    assert(size == sizeof(requestMsg_));
+  }
 }
 
 RequestReply::RequestReply(RequestReplyContext requestReplyContext)
-    : data_(nullptr), size_(0), requestReplyContext_(requestReplyContext) {}
+    : requestReplyContext_(requestReplyContext) {}
 
-RequestReply::RequestReply(char *data, uint64_t size, Connection *con)
-    : size_(size) {
-  data_ = static_cast<char *>(std::malloc(size_));
-  memcpy(data_, data, size_);
-  requestReplyContext_.con = con;
+RequestReplyContext &RequestReply::get_rrc() { return requestReplyContext_; }
+
+void RequestReply::reset() {
+  requestReplyContext_.type = (OpType)0;
+  requestReplyContext_.success = 0;
+  requestReplyContext_.rid = 0;
+  requestReplyContext_.address = 0;
+  requestReplyContext_.src_address = 0;
+  requestReplyContext_.dest_address = 0;
+  requestReplyContext_.src_rkey = 0;
+  requestReplyContext_.size = 0;
+  requestReplyContext_.key = 0;
+  requestReplyContext_.con = nullptr;
+  requestReplyContext_.ck = nullptr;
+  /// keep the capacity of the vectors for the next reply
+  requestReplyContext_.bml.clear();
+  requestReplyContext_.meta.reset();
+  requestReplyContext_.cks.clear();
+  requestReplyContext_.batch.clear();
+  requestReplyContext_.stats.clear();
+  requestReplyContext_.batch_parent = nullptr;
+  requestReplyContext_.batch_index = 0;
+  requestReplyContext_.stamp = 0;
+  pending_ = 0;
 }
 
-RequestReply::~RequestReply() {
-  if (data_ != nullptr) {
-    std::free(data_);
-    data_ = nullptr;
+uint64_t RequestReply::encoded_size() {
+  uint64_t size = sizeof(requestReplyMsg_);
+  if (requestReplyContext_.type == BATCH_REPLY) {
+    size += sizeof(RequestReplyMsg) * requestReplyContext_.batch.size();
+  } else if (requestReplyContext_.type == STATS_REPLY) {
+    size += sizeof(uint64_t) * requestReplyContext_.stats.size();
+  } else {
+    size += sizeof(block_meta) * block_list().size();
   }
+  return size;
 }
 
-RequestReplyContext &RequestReply::get_rrc() { return requestReplyContext_; }
-
-void RequestReply::encode() {
+void RequestReply::encode(char *data, uint64_t *size) {
   requestReplyMsg_.type = (OpType)requestReplyContext_.type;
   requestReplyMsg_.success = requestReplyContext_.success;
   requestReplyMsg_.rid = requestReplyContext_.rid;
@@ -84,33 +143,62 @@ void RequestReply::encode() {
   requestReplyMsg_.size = requestReplyContext_.size;
   requestReplyMsg_.key = requestReplyContext_.key;
   auto msg_size = sizeof(requestReplyMsg_);
-  size_ = msg_size;
-
-  /// copy data from block metadata list
-  uint32_t bml_size = 0;
-  if (!requestReplyContext_.bml.empty()) {
-    bml_size = sizeof(block_meta) * requestReplyContext_.bml.size();
-    size_ += bml_size;
+  *size = msg_size;
+
+  /// copy data from block metadata list, sub-request replies or stats
+  uint64_t bml_size = 0;
+  uint64_t batch_size = 0;
+  uint64_t stats_size = 0;
+  if (requestReplyContext_.type == BATCH_REPLY) {
+    requestReplyMsg_.size = requestReplyContext_.batch.size();
+    batch_size = sizeof(RequestReplyMsg) * requestReplyContext_.batch.size();
+    *size += batch_size;
+  } else if (requestReplyContext_.type == STATS_REPLY) {
+    stats_size = sizeof(uint64_t) * requestReplyContext_.stats.size();
+    *size += stats_size;
+  } else if (!block_list().empty()) {
+    bml_size = sizeof(block_meta) * block_list().size();
+    *size += bml_size;
   }
-  data_ = static_cast<char *>(std::malloc(size_));
-  memcpy(data_, &requestReplyMsg_, msg_size);
+  memcpy(data, &requestReplyMsg_, msg_size);
   if (bml_size != 0) {
-    memcpy(data_ + msg_size, &requestReplyContext_.bml[0], bml_size);
+    memcpy(data + msg_size, block_list().data(), bml_size);
+  }
+  if (batch_size != 0) {
+    memcpy(data + msg_size, &requestReplyContext_.batch[0], batch_size);
+  }
+  if (stats_size != 0) {
+    memcpy(data + msg_size, &requestReplyContext_.stats[0], stats_size);
   }
 }
 
-void RequestReply::decode() {
-  memcpy(&requestReplyMsg_, data_, size_);
+void RequestReply::decode(const char *data, uint64_t size, Connection *con) {
+  assert(size >= sizeof(requestReplyMsg_));
+  memcpy(&requestReplyMsg_, data, sizeof(requestReplyMsg_));
   requestReplyContext_.type = (OpType)requestReplyMsg_.type;
   requestReplyContext_.success = requestReplyMsg_.success;
   requestReplyContext_.rid = requestReplyMsg_.rid;
   requestReplyContext_.address = requestReplyMsg_.address;
   requestReplyContext_.size = requestReplyMsg_.size;
   requestReplyContext_.key = requestReplyMsg_.key;
-  if (size_ > sizeof(requestReplyMsg_)) {
-    auto bml_size = size_ - sizeof(requestReplyMsg_);
-    requestReplyContext_.bml.resize(bml_size / sizeof(block_meta));
-    memcpy(&requestReplyContext_.bml[0], data_ + sizeof(requestReplyMsg_),
-           bml_size);
+  requestReplyContext_.con = con;
+  requestReplyContext_.bml.clear();
+  requestReplyContext_.batch.clear();
+  requestReplyContext_.stats.clear();
+  if (size > sizeof(requestReplyMsg_)) {
+    auto extra_size = size - sizeof(requestReplyMsg_);
+    if (requestReplyContext_.type == BATCH_REPLY) {
+      requestReplyContext_.batch.resize(extra_size / sizeof(RequestReplyMsg));
+      memcpy(&requestReplyContext_.batch[0], data + sizeof(requestReplyMsg_),
+             extra_size);
+    } else if (requestReplyContext_.type == STATS_REPLY) {
+      requestReplyContext_.stats.resize(extra_size / sizeof(uint64_t));
+      memcpy(&requestReplyContext_.stats[0], data + sizeof(requestReplyMsg_),
+             extra_size);
+    } else {
+      requestReplyContext_.bml.resize(extra_size / sizeof(block_meta));
+      memcpy(&requestReplyContext_.bml[0], data + sizeof(requestReplyMsg_),
+             extra_size);
+    }
   }
 }
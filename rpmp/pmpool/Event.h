@@ -13,7 +13,9 @@
 #include <HPNL/ChunkMgr.h>
 #include <HPNL/Connection.h>
 
+#include <atomic>
 #include <future>  // NOLINT
+#include <memory>
 #include <vector>
 
 #include "pmpool/Base.h"
@@ -24,6 +26,7 @@ using std::promise;
 using std::vector;
 
 class RequestHandler;
+class RequestReply;
 class ClientRecvCallback;
 class Protocol;
 
@@ -37,6 +40,9 @@ enum OpType : uint32_t {
   GET,
   GET_META,
   DELETE,
+  BATCH,
+  FREE_ARENA,
+  STATS,
   REPLY = 1 << 16,
   ALLOC_REPLY,
   FREE_REPLY,
@@ -46,7 +52,10 @@ enum OpType : uint32_t {
   PUT_REPLY,
   GET_REPLY,
   GET_META_REPLY,
-  DELETE_REPLY
+  DELETE_REPLY,
+  BATCH_REPLY,
+  FREE_ARENA_REPLY,
+  STATS_REPLY
 };
 
 /**
@@ -69,6 +78,19 @@ struct RequestReplyContext {
   Connection* con;
   Chunk* ck;
   vector <block_meta> bml;
+  /// block list shared with the meta store, encoded in place of bml.
+  std::shared_ptr<const vector<block_meta>> meta;
+  /// RDMA chunks of a GET reply, one per block.
+  vector<Chunk*> cks;
+  /// replies of the sub-requests of a BATCH request.
+  vector<RequestReplyMsg> batch;
+  /// server_stats and the pool_stats of every pool of a STATS reply.
+  vector<uint64_t> stats;
+  /// the BATCH reply that this sub-request reply belongs to.
+  RequestReply* batch_parent;
+  uint64_t batch_index;
+  /// start of the current LatencyStage on the server, in ns.
+  uint64_t stamp;
 };
 
 template <class T>
@@ -89,18 +111,28 @@ class RequestReply {
  public:
   RequestReply() = delete;
   explicit RequestReply(RequestReplyContext requestReplyContext);
-  RequestReply(char* data, uint64_t size, Connection* con);
-  ~RequestReply();
+  ~RequestReply() = default;
   RequestReplyContext& get_rrc();
-  void decode();
-  void encode();
+  /// decode the reply in place from data, e.g. a receive chunk.
+  void decode(const char* data, uint64_t size, Connection* con);
+  /// encode the reply into data, which holds at least encoded_size() bytes.
+  void encode(char* data, uint64_t* size);
+  uint64_t encoded_size();
+  /// clear the context so that a pooled reply can be reused.
+  void reset();
 
  private:
+  const vector<block_meta>& block_list() {
+    return requestReplyContext_.meta ? *requestReplyContext_.meta
+                                     : requestReplyContext_.bml;
+  }
+
   friend Protocol;
-  char* data_;
-  uint64_t size_;
   RequestReplyMsg requestReplyMsg_;
   RequestReplyContext requestReplyContext_;
+  /// number of outstanding sub-requests of a BATCH reply,
+  /// or of outstanding RDMA writes of a GET reply.
+  std::atomic<uint64_t> pending_{0};
 };
 
 typedef promise<RequestReplyContext> Promise;
@@ -115,23 +147,31 @@ struct RequestContext {
   uint64_t size;
   uint64_t key;
   Connection* con;
+  /// sub-requests of a BATCH request.
+  vector<RequestMsg> batch;
+  RequestReply* batch_parent;
+  uint64_t batch_index;
+  /// time the server received the request, in ns.
+  uint64_t stamp;
 };
 
 class Request {
  public:
   Request() = delete;
   explicit Request(RequestContext requestContext);
-  Request(char* data, uint64_t size, Connection* con);
-  ~Request();
+  ~Request() = default;
   RequestContext& get_rc();
-  void encode();
-  void decode();
+  /// encode the request into data, which holds at least encoded_size() bytes.
+  void encode(char* data, uint64_t* size);
+  uint64_t encoded_size();
+  /// decode the request in place from data, e.g. a receive chunk.
+  void decode(const char* data, uint64_t size, Connection* con);
+  /// clear the context so that a pooled request can be reused.
+  void reset();
 
  private:
   friend RequestHandler;
   friend ClientRecvCallback;
-  char* data_;
-  uint64_t size_;
   RequestMsg requestMsg_;
   RequestContext requestContext_;
 };
@@ -0,0 +1,213 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/FlatIndex.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Friday, March 20th 2020, 10:05:12 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_FLATINDEX_H_
+#define PMPOOL_FLATINDEX_H_
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#define FLAT_INDEX_SHARD_BITS 6
+#define FLAT_INDEX_SHARDS (1 << FLAT_INDEX_SHARD_BITS)
+#define FLAT_INDEX_MIN_CAPACITY 64
+
+/**
+ * @brief FlatIndex maps 64 bit keys to 64 bit values, keys 0 and ~0 are
+ * reserved. Entries are stored inline in open addressing tables with linear
+ * probing, 16 bytes per slot, instead of one heap node per entry. Keys are
+ * spread over independent shards, each guarded by its own mutex, so
+ * concurrent updates rarely meet.
+ */
+class FlatIndex {
+ public:
+  FlatIndex() {
+    for (int i = 0; i < FLAT_INDEX_SHARDS; i++) {
+      shards_[i].entries.resize(FLAT_INDEX_MIN_CAPACITY);
+    }
+  }
+  FlatIndex(const FlatIndex &) = delete;
+
+  /// return false if the key already exists.
+  bool insert(uint64_t key, uint64_t value) {
+    assert(key != EMPTY_KEY && key != TOMBSTONE_KEY);
+    uint64_t hash = mix(key);
+    Shard &shard = shards_[hash >> (64 - FLAT_INDEX_SHARD_BITS)];
+    std::lock_guard<std::mutex> l(shard.mtx);
+    if (lookup(shard, key, hash) != nullptr) {
+      return false;
+    }
+    if ((shard.size + shard.tombstones + 1) * 10 > shard.entries.size() * 7) {
+      rehash(&shard);
+    }
+    Entry *entry = probe(&shard, hash, [](const Entry &e) {
+      return e.key == EMPTY_KEY || e.key == TOMBSTONE_KEY;
+    });
+    if (entry->key == TOMBSTONE_KEY) {
+      shard.tombstones--;
+    }
+    entry->key = key;
+    entry->value = value;
+    shard.size++;
+    return true;
+  }
+
+  bool find(uint64_t key, uint64_t *value) {
+    uint64_t hash = mix(key);
+    Shard &shard = shards_[hash >> (64 - FLAT_INDEX_SHARD_BITS)];
+    std::lock_guard<std::mutex> l(shard.mtx);
+    Entry *entry = lookup(shard, key, hash);
+    if (entry == nullptr) {
+      return false;
+    }
+    *value = entry->value;
+    return true;
+  }
+
+  /// remove the key and return its value, return false if it does not exist.
+  bool erase(uint64_t key, uint64_t *value = nullptr) {
+    uint64_t hash = mix(key);
+    Shard &shard = shards_[hash >> (64 - FLAT_INDEX_SHARD_BITS)];
+    std::lock_guard<std::mutex> l(shard.mtx);
+    Entry *entry = lookup(shard, key, hash);
+    if (entry == nullptr) {
+      return false;
+    }
+    if (value != nullptr) {
+      *value = entry->value;
+    }
+    entry->key = TOMBSTONE_KEY;
+    shard.size--;
+    shard.tombstones++;
+    return true;
+  }
+
+  uint64_t size() {
+    uint64_t size = 0;
+    for (int i = 0; i < FLAT_INDEX_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      size += shards_[i].size;
+    }
+    return size;
+  }
+
+  /// call f(key, value) on every entry, shard by shard. f must not modify
+  /// the index.
+  template <class F>
+  void for_each(F f) {
+    for (int i = 0; i < FLAT_INDEX_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      for (const Entry &entry : shards_[i].entries) {
+        if (entry.key != EMPTY_KEY && entry.key != TOMBSTONE_KEY) {
+          f(entry.key, entry.value);
+        }
+      }
+    }
+  }
+
+  /// size the shards for num entries up front, so that a bulk load does not
+  /// rehash on the way.
+  void reserve(uint64_t num) {
+    uint64_t per_shard = num / FLAT_INDEX_SHARDS + 1;
+    for (int i = 0; i < FLAT_INDEX_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      uint64_t capacity = shards_[i].entries.size();
+      while ((per_shard + shards_[i].size) * 10 > capacity * 5) {
+        capacity *= 2;
+      }
+      if (capacity != shards_[i].entries.size()) {
+        resize(&shards_[i], capacity);
+      }
+    }
+  }
+
+  void clear() {
+    for (int i = 0; i < FLAT_INDEX_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      shards_[i].entries.assign(FLAT_INDEX_MIN_CAPACITY, Entry());
+      shards_[i].size = 0;
+      shards_[i].tombstones = 0;
+    }
+  }
+
+ private:
+  static const uint64_t EMPTY_KEY = 0;
+  static const uint64_t TOMBSTONE_KEY = ~0ULL;
+
+  struct Entry {
+    uint64_t key = EMPTY_KEY;
+    uint64_t value = 0;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mtx;
+    std::vector<Entry> entries;
+    uint64_t size = 0;
+    uint64_t tombstones = 0;
+  };
+
+  /// finalizer of splitmix64, the low bits pick the slot and the high bits
+  /// pick the shard.
+  static uint64_t mix(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+  }
+
+  template <class Pred>
+  static Entry *probe(Shard *shard, uint64_t hash, Pred pred) {
+    uint64_t mask = shard->entries.size() - 1;
+    for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+      Entry &entry = shard->entries[i];
+      if (pred(entry)) {
+        return &entry;
+      }
+    }
+  }
+
+  static Entry *lookup(Shard &shard, uint64_t key, uint64_t hash) {
+    Entry *entry = probe(&shard, hash, [key](const Entry &e) {
+      return e.key == key || e.key == EMPTY_KEY;
+    });
+    return entry->key == key ? entry : nullptr;
+  }
+
+  /// grow the table if it is mostly live entries, otherwise only drop the
+  /// tombstones.
+  static void rehash(Shard *shard) {
+    uint64_t capacity = shard->entries.size();
+    if ((shard->size + 1) * 10 > capacity * 5) {
+      capacity *= 2;
+    }
+    resize(shard, capacity);
+  }
+
+  static void resize(Shard *shard, uint64_t capacity) {
+    std::vector<Entry> entries(capacity);
+    entries.swap(shard->entries);
+    shard->tombstones = 0;
+    for (const Entry &old : entries) {
+      if (old.key == EMPTY_KEY || old.key == TOMBSTONE_KEY) {
+        continue;
+      }
+      *probe(shard, mix(old.key),
+             [](const Entry &e) { return e.key == EMPTY_KEY; }) = old;
+    }
+  }
+
+  Shard shards_[FLAT_INDEX_SHARDS];
+};
+
+#endif  // PMPOOL_FLATINDEX_H_
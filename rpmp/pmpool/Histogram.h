@@ -0,0 +1,184 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/Histogram.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Thursday, April 2nd 2020, 11:16:52 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_HISTOGRAM_H_
+#define PMPOOL_HISTOGRAM_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <string>
+
+/// each power of two range is split into 2^HISTOGRAM_SUB_BITS linear buckets,
+/// so a recorded value is off by less than 1/16.
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+/// larger values are counted in the last bucket, 2^40ns is about 18 minutes.
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS \
+  ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * @brief Histogram is a lock-free log-linear histogram in the style of
+ * HdrHistogram. Threads record concurrently with relaxed atomic adds, reads
+ * and reset are not atomic with respect to concurrent records.
+ */
+class Histogram {
+ public:
+  Histogram() { reset(); }
+  Histogram(const Histogram &) = delete;
+
+  void record(uint64_t value) {
+    counts_[index(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max &&
+           !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t get_count() { return count_.load(std::memory_order_relaxed); }
+  uint64_t get_max() { return max_.load(std::memory_order_relaxed); }
+  double get_mean() {
+    uint64_t count = get_count();
+    return count ? sum_.load(std::memory_order_relaxed) / (double)count : 0;
+  }
+
+  /// the highest value of the bucket that holds the percentile, 0 if empty.
+  uint64_t get_percentile(double percentile) {
+    uint64_t count = get_count();
+    if (count == 0) {
+      return 0;
+    }
+    uint64_t target = count * percentile / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen > target) {
+        return std::min(highest(i), get_max());
+      }
+    }
+    return get_max();
+  }
+
+  void reset() {
+    for (auto &c : counts_) {
+      c.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  static int index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+      return value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= HISTOGRAM_MAX_BITS) {
+      return HISTOGRAM_BUCKETS - 1;
+    }
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS +
+           ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+  }
+
+  static uint64_t highest(int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+      return index;
+    }
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(HISTOGRAM_SUB_BUCKETS +
+                                 index % HISTOGRAM_SUB_BUCKETS)
+                      << shift;
+    return lowest + (1ULL << shift) - 1;
+  }
+
+ private:
+  std::atomic<uint64_t> counts_[HISTOGRAM_BUCKETS];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+/// stages a request passes through on the server.
+enum LatencyStage {
+  /// from being received to being picked up by a worker.
+  STAGE_RECV_QUEUE,
+  /// of the staging buffer or PMem block of a request.
+  STAGE_ALLOCATE,
+  /// from posting the RDMA operation to handling its completion.
+  STAGE_RDMA,
+  /// of the data into PMem, or its flush after a zero-copy write.
+  STAGE_COPY,
+  /// from being finalized to being picked up by the finalize worker.
+  STAGE_FINALIZE_QUEUE,
+  /// posting the reply.
+  STAGE_SEND,
+  STAGE_NUM
+};
+
+/// OpType without the REPLY bit, larger ones are not recorded.
+#define LATENCY_OP_NUM 16
+
+/**
+ * @brief LatencyStats keeps one Histogram of nanoseconds per request type and
+ * LatencyStage.
+ */
+class LatencyStats {
+ public:
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void record(uint32_t op, LatencyStage stage, uint64_t ns) {
+    if (op < LATENCY_OP_NUM) {
+      histograms_[op][stage].record(ns);
+    }
+  }
+
+  Histogram &get(uint32_t op, LatencyStage stage) {
+    return histograms_[op][stage];
+  }
+
+  void reset() {
+    for (auto &op : histograms_) {
+      for (auto &histogram : op) {
+        histogram.reset();
+      }
+    }
+  }
+
+  static const char *stage_name(int stage) {
+    static const char *names[] = {"recv queue", "allocate",       "rdma",
+                                  "copy",       "finalize queue", "send"};
+    return names[stage];
+  }
+
+  /// count, mean, percentiles and max of the histogram in us.
+  static std::string format(Histogram *histogram) {
+    auto us = [](double ns) { return std::to_string(ns / 1000); };
+    return "count " + std::to_string(histogram->get_count()) + ", mean " +
+           us(histogram->get_mean()) + "us, p50 " +
+           us(histogram->get_percentile(50)) + "us, p99 " +
+           us(histogram->get_percentile(99)) + "us, p99.9 " +
+           us(histogram->get_percentile(99.9)) + "us, max " +
+           us(histogram->get_max()) + "us";
+  }
+
+ private:
+  Histogram histograms_[LATENCY_OP_NUM][STAGE_NUM];
+};
+
+#endif  // PMPOOL_HISTOGRAM_H_
@@ -0,0 +1,205 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/MetaLog.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Monday, March 23rd 2020, 2:05:51 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_METALOG_H_
+#define PMPOOL_METALOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Allocator.h"
+
+using std::vector;
+
+#define META_LOG_MAGIC 0x474f4c4154454d52ULL  // "RMETALOG"
+#define META_LOG_SEGMENT_SIZE (1ULL << 20)
+#define META_LOG_RECORDS_PER_SEGMENT \
+  (META_LOG_SEGMENT_SIZE / sizeof(meta_record) - 1)
+
+// meta log segment header stored in pmem, followed by the records
+struct meta_log_hdr {
+  uint64_t magic;
+  uint64_t next;
+  uint64_t reserved[6];
+};
+
+// one key to block update, a record with address 0 drops every block of the
+// key that has a smaller seq. A record is valid only if its check matches, so it
+// takes a single flush.
+struct meta_record {
+  uint64_t key;
+  uint64_t address;
+  uint64_t size;
+  uint64_t seq;
+  uint64_t check;
+  uint64_t reserved[3];
+};
+
+/**
+ * @brief MetaLog is an append-only log of key metadata updates kept in the
+ * pool it describes, so that keys survive a restart together with their
+ * data. The log is a chain of segments allocated from the pool, the first of
+ * which is the meta root of the pool. It is not thread safe.
+ */
+class MetaLog {
+ public:
+  MetaLog() = delete;
+  MetaLog(const MetaLog &) = delete;
+  explicit MetaLog(Allocator *allocator) : allocator_(allocator) {}
+
+  /// read back the valid records in log order and continue appending after
+  /// the last of them.
+  int recover(vector<meta_record> *records) {
+    segments_.clear();
+    tail_pos_ = 0;
+    record_num_ = 0;
+    uint64_t address = allocator_->get_meta_root();
+    while (address != 0) {
+      meta_log_hdr *hdr = segment(address);
+      if (hdr == nullptr || hdr->magic != META_LOG_MAGIC) {
+        return -1;
+      }
+      segments_.push_back(address);
+      meta_record *record = first_record(hdr);
+      tail_pos_ = 0;
+      while (tail_pos_ < META_LOG_RECORDS_PER_SEGMENT &&
+             record[tail_pos_].check == checksum(record[tail_pos_])) {
+        records->push_back(record[tail_pos_]);
+        tail_pos_++;
+      }
+      record_num_ += tail_pos_;
+      address = hdr->next;
+    }
+    return 0;
+  }
+
+  int append(const meta_record &record) { return append(record, true); }
+
+  /// replace the log with the given records. The new chain is switched in by
+  /// a single meta root update, the old segments are released afterwards and
+  /// leak if the server stops in between.
+  int rewrite(const vector<meta_record> &records) {
+    vector<uint64_t> old_segments;
+    old_segments.swap(segments_);
+    tail_pos_ = 0;
+    record_num_ = 0;
+    for (auto &record : records) {
+      if (append(record, false)) {
+        release_segments(segments_);
+        segments_.swap(old_segments);
+        return -1;
+      }
+    }
+    allocator_->set_meta_root(segments_.empty() ? 0 : segments_[0]);
+    release_segments(old_segments);
+    return 0;
+  }
+
+  uint64_t size() { return record_num_; }
+
+  /// forget the segments after the pool has been released as a whole.
+  void clear() {
+    segments_.clear();
+    tail_pos_ = 0;
+    record_num_ = 0;
+  }
+
+  static uint64_t checksum(const meta_record &record) {
+    uint64_t hash = mix(record.key);
+    hash = mix(hash ^ record.address);
+    hash = mix(hash ^ record.size);
+    hash = mix(hash ^ record.seq);
+    return hash | 1;
+  }
+
+ private:
+  /// a new first segment is published through the meta root only if
+  /// publish is set, later segments are linked to the tail segment.
+  int append(const meta_record &record, bool publish) {
+    if (segments_.empty() || tail_pos_ == META_LOG_RECORDS_PER_SEGMENT) {
+      uint64_t address = new_segment();
+      if (address == (uint64_t)-1) {
+        return -1;
+      }
+      if (segments_.empty()) {
+        if (publish) {
+          allocator_->set_meta_root(address);
+        }
+      } else {
+        meta_log_hdr *tail = segment(segments_.back());
+        tail->next = address;
+        allocator_->persist(segments_.back() + offsetof(meta_log_hdr, next),
+                            sizeof(uint64_t));
+      }
+      segments_.push_back(address);
+      tail_pos_ = 0;
+    }
+    meta_record *dest = first_record(segment(segments_.back())) + tail_pos_;
+    *dest = record;
+    dest->check = checksum(record);
+    allocator_->persist(segments_.back() + sizeof(meta_log_hdr) +
+                            tail_pos_ * sizeof(meta_record),
+                        sizeof(meta_record));
+    tail_pos_++;
+    record_num_++;
+    return 0;
+  }
+
+  /// finalizer of splitmix64
+  static uint64_t mix(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+  }
+
+  meta_log_hdr *segment(uint64_t address) {
+    uint64_t va =
+        allocator_->get_virtual_address(address, META_LOG_SEGMENT_SIZE);
+    if (va == (uint64_t)-1) {
+      return nullptr;
+    }
+    return reinterpret_cast<meta_log_hdr *>(va);
+  }
+
+  static meta_record *first_record(meta_log_hdr *hdr) {
+    return reinterpret_cast<meta_record *>(hdr + 1);
+  }
+
+  /// allocate a zeroed segment, zero checks are never valid.
+  uint64_t new_segment() {
+    vector<char> image(META_LOG_SEGMENT_SIZE, 0);
+    auto hdr = reinterpret_cast<meta_log_hdr *>(image.data());
+    hdr->magic = META_LOG_MAGIC;
+    uint64_t address =
+        allocator_->allocate_and_write(META_LOG_SEGMENT_SIZE, image.data());
+    if (address == (uint64_t)-1) {
+      return -1;
+    }
+    allocator_->persist(address, META_LOG_SEGMENT_SIZE);
+    return address;
+  }
+
+  void release_segments(const vector<uint64_t> &segments) {
+    for (auto address : segments) {
+      allocator_->release(address);
+    }
+  }
+
+  Allocator *allocator_;
+  vector<uint64_t> segments_;
+  uint64_t tail_pos_ = 0;
+  uint64_t record_num_ = 0;
+};
+
+#endif  // PMPOOL_METALOG_H_
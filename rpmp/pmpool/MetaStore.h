@@ -0,0 +1,170 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/MetaStore.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Monday, March 23rd 2020, 9:40:18 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_METASTORE_H_
+#define PMPOOL_METASTORE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "Base.h"
+
+#define META_STORE_SHARD_BITS 6
+#define META_STORE_SHARDS (1 << META_STORE_SHARD_BITS)
+
+using std::shared_ptr;
+using std::unordered_map;
+using std::vector;
+
+/// blocks of one key in write order, seqs are the meta log sequence numbers
+/// of the blocks.
+struct key_meta {
+  vector<block_meta> bml;
+  vector<uint64_t> seqs;
+};
+
+/**
+ * @brief MetaStore maps keys to the blocks written under them. Keys are
+ * spread over independent shards. Readers take a reference to the block list
+ * under the shard lock and use it without copying it or holding any lock. A
+ * list that is referenced by a reader is never modified, an append copies it
+ * and swaps the pointer. Otherwise the block is appended in place.
+ *
+ * Seqs are assigned under the shard lock, so the seqs of a key are in the
+ * order of its updates.
+ */
+class MetaStore {
+ public:
+  MetaStore() = default;
+  MetaStore(const MetaStore &) = delete;
+
+  /// return nullptr if the key does not exist.
+  shared_ptr<const vector<block_meta>> get(uint64_t key) {
+    shared_ptr<const key_meta> km;
+    {
+      Shard &shard = shard_of(key);
+      std::lock_guard<std::mutex> l(shard.mtx);
+      auto it = shard.map.find(key);
+      if (it == shard.map.end()) {
+        return nullptr;
+      }
+      km = it->second;
+    }
+    return shared_ptr<const vector<block_meta>>(km, &km->bml);
+  }
+
+  /// append the block with the next seq and return the seq. persist(seq) is
+  /// called under the shard lock before the block is visible, so it must not
+  /// use the store.
+  template <class F>
+  uint64_t append(uint64_t key, const block_meta &bm, F persist) {
+    Shard &shard = shard_of(key);
+    std::lock_guard<std::mutex> l(shard.mtx);
+    uint64_t seq = next_seq_++;
+    persist(seq);
+    append_locked(&shard, key, bm, seq);
+    return seq;
+  }
+
+  /// append a replayed block with its original seq.
+  void replay(uint64_t key, const block_meta &bm, uint64_t seq) {
+    Shard &shard = shard_of(key);
+    std::lock_guard<std::mutex> l(shard.mtx);
+    append_locked(&shard, key, bm, seq);
+  }
+
+  /// remove the key and return its blocks, nullptr if it does not exist.
+  /// The seq of the removal is returned in seq if it is not nullptr.
+  shared_ptr<const key_meta> erase(uint64_t key, uint64_t *seq = nullptr) {
+    Shard &shard = shard_of(key);
+    std::lock_guard<std::mutex> l(shard.mtx);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      return nullptr;
+    }
+    shared_ptr<const key_meta> km = it->second;
+    shard.map.erase(it);
+    if (seq != nullptr) {
+      *seq = next_seq_++;
+    }
+    return km;
+  }
+
+  /// make the seqs assigned from now on greater than seq.
+  void advance_seq(uint64_t seq) {
+    uint64_t next = next_seq_.load();
+    while (next <= seq && !next_seq_.compare_exchange_weak(next, seq + 1)) {
+    }
+  }
+
+  /// call f(key, key_meta) on every key, shard by shard.
+  template <class F>
+  void for_each(F f) {
+    for (int i = 0; i < META_STORE_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      for (auto &kv : shards_[i].map) {
+        f(kv.first, *kv.second);
+      }
+    }
+  }
+
+  uint64_t size() {
+    uint64_t size = 0;
+    for (int i = 0; i < META_STORE_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      size += shards_[i].map.size();
+    }
+    return size;
+  }
+
+  void clear() {
+    for (int i = 0; i < META_STORE_SHARDS; i++) {
+      std::lock_guard<std::mutex> l(shards_[i].mtx);
+      shards_[i].map.clear();
+    }
+  }
+
+ private:
+  struct alignas(64) Shard {
+    std::mutex mtx;
+    unordered_map<uint64_t, shared_ptr<key_meta>> map;
+  };
+
+  /// new references are only taken under the shard lock, so a list that is
+  /// not shared here stays private until the lock is released.
+  static void append_locked(Shard *shard, uint64_t key, const block_meta &bm,
+                            uint64_t seq) {
+    auto &km = shard->map[key];
+    if (!km) {
+      km = std::make_shared<key_meta>();
+    } else if (km.use_count() > 1) {
+      km = std::make_shared<key_meta>(*km);
+    } else {
+      // order the reads of the last reader before the update.
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    km->bml.push_back(bm);
+    km->seqs.push_back(seq);
+  }
+
+  Shard &shard_of(uint64_t key) {
+    uint64_t hash = key * 0x9e3779b97f4a7c15ULL;
+    return shards_[hash >> (64 - META_STORE_SHARD_BITS)];
+  }
+
+  Shard shards_[META_STORE_SHARDS];
+  std::atomic<uint64_t> next_seq_{1};
+};
+
+#endif  // PMPOOL_METASTORE_H_
@@ -13,16 +13,19 @@
 #include "Config.h"
 #include "Event.h"
 #include "Log.h"
-#include "buffer/CircularBuffer.h"
+#include "buffer/BufferPool.h"
 
 NetworkServer::NetworkServer(Config *config, Log *log)
     : config_(config), log_(log) {
   time = 0;
 }
 
+/// the buffer pool unregisters its own segments, what is left is owned by
+/// the server, e.g. the pmem pools.
 NetworkServer::~NetworkServer() {
-  for (int i = 0; i < buffer_id_; i++) {
-    unregister_rma_buffer(i);
+  bufferPool_.reset();
+  for (int buffer_id : registered_) {
+    server_->unreg_rma_buffer(buffer_id);
   }
 }
 
@@ -44,60 +47,103 @@ int NetworkServer::start() {
   CHK_ERR("hpnl server listen", server_->listen(config_->get_ip().c_str(),
                                                 config_->get_port().c_str()));
 
-  circularBuffer_ =
-      std::make_shared<CircularBuffer>(1024 * 1024, 4096, true, this);
+  BufferPoolOptions options;
+  options.init_slab_num = config_->get_buffer_init_num();
+  options.hugepage = config_->get_buffer_hugepage();
+  options.prefault = config_->get_buffer_prefault();
+  options.numa_node = config_->get_nic_node();
+  bufferPool_ = std::make_shared<BufferPool>(
+      1024 * 1024, config_->get_buffer_num(), this, options);
   return 0;
 }
 
 void NetworkServer::wait() { server_->wait(); }
 
 Chunk *NetworkServer::register_rma_buffer(char *rma_buffer, uint64_t size) {
-  return server_->reg_rma_buffer(rma_buffer, size, buffer_id_++);
+  int buffer_id = buffer_id_++;
+  Chunk *ck = server_->reg_rma_buffer(rma_buffer, size, buffer_id);
+  if (ck != nullptr) {
+    std::lock_guard<std::mutex> l(registered_mtx_);
+    registered_.insert(buffer_id);
+  }
+  return ck;
 }
 
 void NetworkServer::unregister_rma_buffer(int buffer_id) {
+  {
+    std::lock_guard<std::mutex> l(registered_mtx_);
+    registered_.erase(buffer_id);
+  }
   server_->unreg_rma_buffer(buffer_id);
 }
 
-void NetworkServer::get_dram_buffer(RequestReplyContext *rrc) {
-  char *buffer = circularBuffer_->get(rrc->size);
+int NetworkServer::get_dram_buffer(RequestReplyContext *rrc, bool wait) {
+  char *buffer = bufferPool_->get(rrc->size, wait ? BUFFER_POOL_WAIT_MS : 0);
+  if (buffer == nullptr) {
+    rrc->ck = nullptr;
+    return -1;
+  }
   rrc->dest_address = (uint64_t)buffer;
 
-  Chunk *base_ck = circularBuffer_->get_rma_chunk();
-  uint64_t offset = circularBuffer_->get_offset(rrc->dest_address);
+  Chunk *base_ck = bufferPool_->get_rma_chunk(buffer);
 
   // encapsulate new chunk
-  Chunk *ck = new Chunk();
-  ck->buffer = static_cast<char *>(base_ck->buffer) + offset;
+  Chunk *ck = chunkPool_.get();
+  ck->buffer = buffer;
   ck->capacity = base_ck->capacity;
-  ck->buffer_id = buffer_id_++;
+  uint32_t id;
+  if (!rmaChunks_.try_insert(ck, &id)) {
+    chunkPool_.put(ck);
+    bufferPool_->put(buffer, rrc->size);
+    rrc->ck = nullptr;
+    return -1;
+  }
+  ck->buffer_id = id;
   ck->mr = base_ck->mr;
   ck->size = rrc->size;
   rrc->ck = ck;
+  return 0;
 }
 
 void NetworkServer::reclaim_dram_buffer(RequestReplyContext *rrc) {
   char *buffer_tmp = reinterpret_cast<char *>(rrc->dest_address);
-  circularBuffer_->put(buffer_tmp, rrc->size);
-  delete rrc->ck;
+  bufferPool_->put(buffer_tmp, rrc->size);
+  rmaChunks_.erase(rrc->ck->buffer_id);
+  chunkPool_.put(rrc->ck);
+}
+
+BufferPoolStats NetworkServer::get_buffer_stats() {
+  return bufferPool_->get_stats();
 }
 
-void NetworkServer::get_pmem_buffer(RequestReplyContext *rrc, Chunk *base_ck) {
-  Chunk *ck = new Chunk();
+int NetworkServer::get_pmem_buffer(RequestReplyContext *rrc, Chunk *base_ck) {
+  Chunk *ck = chunkPool_.get();
   ck->buffer = reinterpret_cast<char *>(rrc->dest_address);
   ck->capacity = rrc->size;
-  ck->buffer_id = buffer_id_++;
+  uint32_t id;
+  if (!rmaChunks_.try_insert(ck, &id)) {
+    chunkPool_.put(ck);
+    rrc->ck = nullptr;
+    return -1;
+  }
+  ck->buffer_id = id;
   ck->mr = base_ck->mr;
   ck->size = rrc->size;
   rrc->ck = ck;
+  return 0;
 }
 
 void NetworkServer::reclaim_pmem_buffer(RequestReplyContext *rrc) {
   if (rrc->ck != nullptr) {
-    delete rrc->ck;
+    rmaChunks_.erase(rrc->ck->buffer_id);
+    chunkPool_.put(rrc->ck);
   }
 }
 
+Chunk *NetworkServer::get_rma_chunk(uint64_t buffer_id) {
+  return rmaChunks_.get(buffer_id);
+}
+
 ChunkMgr *NetworkServer::get_chunk_mgr() { return chunkMgr_.get(); }
 
 void NetworkServer::set_recv_callback(Callback *callback) {
@@ -116,19 +162,27 @@ void NetworkServer::set_write_callback(Callback *callback) {
   server_->set_write_callback(callback);
 }
 
-void NetworkServer::send(char *data, uint64_t size, Connection *con) {
-  auto ck = chunkMgr_->get(con);
-  std::memcpy(reinterpret_cast<char *>(ck->buffer), data, size);
+void NetworkServer::send(RequestReply *rr) {
+  RequestReplyContext &rrc = rr->get_rrc();
+  auto ck = chunkMgr_->get(rrc.con);
+  assert(rr->encoded_size() <= ck->capacity);
+  uint64_t size = 0;
+  rr->encode(reinterpret_cast<char *>(ck->buffer), &size);
   ck->size = size;
-  con->send(ck);
+  rrc.con->send(ck);
 }
 
 void NetworkServer::read(RequestReply *rr) {
-  RequestReplyContext rrc = rr->get_rrc();
+  RequestReplyContext &rrc = rr->get_rrc();
   rrc.con->read(rrc.ck, 0, rrc.size, rrc.src_address, rrc.src_rkey);
 }
 
 void NetworkServer::write(RequestReply *rr) {
-  RequestReplyContext rrc = rr->get_rrc();
+  RequestReplyContext &rrc = rr->get_rrc();
   rrc.con->write(rrc.ck, 0, rrc.size, rrc.src_address, rrc.src_rkey);
 }
+
+void NetworkServer::write(Chunk *ck, uint64_t size, uint64_t remote_address,
+                          uint64_t remote_rkey, Connection *con) {
+  con->write(ck, 0, size, remote_address, remote_rkey);
+}
@@ -16,10 +16,20 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>  // NOLINT
+#include <unordered_set>
 
+#include "ObjectPool.h"
 #include "RmaBufferRegister.h"
+#include "SlotTable.h"
 
-class CircularBuffer;
+/// maximum number of RDMA operations in flight.
+#define RMA_CHUNK_TABLE_SIZE 65536
+/// number of RDMA chunk wrappers allocated up front.
+#define RMA_CHUNK_POOL_SIZE 4096
+
+class BufferPool;
+struct BufferPoolStats;
 class Config;
 class RequestReply;
 class RequestReplyContext;
@@ -46,18 +56,29 @@ class NetworkServer : public RmaBufferRegister {
   /// unregister RDMA region for given buffer.
   void unregister_rma_buffer(int buffer_id) override;
 
-  /// get DRAM buffer from circular buffer pool.
-  void get_dram_buffer(RequestReplyContext *rrc);
+  /// get DRAM buffer from the buffer pool.
+  /// return -1 if the request is larger than a buffer can be, clients split
+  /// such transfers into segments, or if no buffer was put back within
+  /// BUFFER_POOL_WAIT_MS. Without wait, return -1 at once if the pool is
+  /// exhausted, for callers that put the buffers back themselves.
+  int get_dram_buffer(RequestReplyContext *rrc, bool wait = true);
 
-  /// reclaim DRAM buffer from circular buffer pool.
+  /// reclaim DRAM buffer from the buffer pool.
   void reclaim_dram_buffer(RequestReplyContext *rrc);
 
-  /// get Persistent Memory buffer from circular buffer pool
-  void get_pmem_buffer(RequestReplyContext *rrc, Chunk *ck);
+  BufferPoolStats get_buffer_stats();
+
+  /// get Persistent Memory buffer from circular buffer pool, return -1 if
+  /// all RDMA chunk ids are in use.
+  int get_pmem_buffer(RequestReplyContext *rrc, Chunk *ck);
 
   /// reclaim Persistent Memory buffer form circular buffer pool
   void reclaim_pmem_buffer(RequestReplyContext *rrc);
 
+  /// return the in-flight RDMA chunk with the given buffer id, the chunk is
+  /// valid until its buffer is reclaimed.
+  Chunk *get_rma_chunk(uint64_t buffer_id);
+
   /// return the pointer of chunk manager.
   ChunkMgr *get_chunk_mgr();
 
@@ -68,17 +89,27 @@ class NetworkServer : public RmaBufferRegister {
   void set_read_callback(Callback *callback);
   void set_write_callback(Callback *callback);
 
-  void send(char *data, uint64_t size, Connection *con);
+  /// encode the reply directly into a send chunk and send it.
+  void send(RequestReply *rr);
   void read(RequestReply *rrc);
   void write(RequestReply *rrc);
+  /// RDMA write size bytes of ck to the remote address.
+  void write(Chunk *ck, uint64_t size, uint64_t remote_address,
+             uint64_t remote_rkey, Connection *con);
 
  private:
   Config *config_;
   Log* log_;
   std::shared_ptr<Server> server_;
   std::shared_ptr<ChunkMgr> chunkMgr_;
-  std::shared_ptr<CircularBuffer> circularBuffer_;
+  std::shared_ptr<BufferPool> bufferPool_;
   std::atomic<uint64_t> buffer_id_{0};
+  /// ids registered and not unregistered yet, owned by the server on exit.
+  std::mutex registered_mtx_;
+  std::unordered_set<int> registered_;
+  SlotTable<Chunk> rmaChunks_{RMA_CHUNK_TABLE_SIZE};
+  ObjectPool<Chunk> chunkPool_{[]() { return new Chunk(); },
+                               RMA_CHUNK_POOL_SIZE};
   uint64_t time;
 };
 
@@ -0,0 +1,163 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/Numa.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Thursday, March 26th 2020, 10:18:33 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_NUMA_H_
+#define PMPOOL_NUMA_H_
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/// memory policies of mbind(2), defined here to avoid a libnuma dependency.
+#define NUMA_MPOL_PREFERRED 1
+#define NUMA_MPOL_BIND 2
+
+/**
+ * @brief Numa discovers the NUMA node of pool devices and NICs from sysfs and
+ * places threads and memory on a node. Every query returns -1 or an empty
+ * list if the topology is unknown, e.g. on a single node machine without
+ * sysfs NUMA entries, so callers fall back to no placement.
+ */
+class Numa {
+ public:
+  /// node of a device dax (/dev/daxX.Y) or of the block device holding a
+  /// file on a fsdax mount.
+  static int node_of_path(const string &path) {
+    string name = path.substr(path.find_last_of('/') + 1);
+    if (path.compare(0, 8, "/dev/dax") == 0) {
+      int node = read_int("/sys/bus/dax/devices/" + name + "/numa_node");
+      if (node < 0) {
+        node = read_int("/sys/class/dax/" + name + "/device/numa_node");
+      }
+      return node;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      string dir = path.substr(0, path.find_last_of('/'));
+      if (dir.empty() || stat(dir.c_str(), &st) != 0) {
+        return -1;
+      }
+    }
+    dev_t dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+    string sys = "/sys/dev/block/" + std::to_string(major(dev)) + ":" +
+                 std::to_string(minor(dev));
+    int node = read_int(sys + "/device/numa_node");
+    if (node < 0) {
+      /// a partition, the node belongs to the parent disk.
+      node = read_int(sys + "/../device/numa_node");
+    }
+    return node;
+  }
+
+  /// node of the NIC that owns the IPv4 address.
+  static int node_of_address(const string &ip) {
+    struct ifaddrs *ifaddr;
+    if (getifaddrs(&ifaddr) != 0) {
+      return -1;
+    }
+    int node = -1;
+    for (struct ifaddrs *ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
+      if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET) {
+        continue;
+      }
+      char host[INET_ADDRSTRLEN];
+      auto addr = reinterpret_cast<struct sockaddr_in *>(ifa->ifa_addr);
+      if (inet_ntop(AF_INET, &addr->sin_addr, host, sizeof(host)) &&
+          ip == host) {
+        node = read_int(string("/sys/class/net/") + ifa->ifa_name +
+                        "/device/numa_node");
+        break;
+      }
+    }
+    freeifaddrs(ifaddr);
+    return node;
+  }
+
+  /// cpus of the node, parsed from its cpulist, e.g. "0-19,40-59".
+  static vector<int> cpus_of_node(int node) {
+    vector<int> cpus;
+    if (node < 0) {
+      return cpus;
+    }
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) +
+                     "/cpulist");
+    string list;
+    if (!std::getline(in, list)) {
+      return cpus;
+    }
+    std::stringstream ss(list);
+    string range;
+    while (std::getline(ss, range, ',')) {
+      if (range.empty()) {
+        continue;
+      }
+      size_t dash = range.find('-');
+      int first = atoi(range.c_str());
+      int last = dash == string::npos ? first : atoi(range.c_str() + dash + 1);
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    }
+    return cpus;
+  }
+
+  /// restrict the calling thread to the cpus of the node, so that its
+  /// allocations are served from the node by the first touch policy.
+  static int run_on_node(int node) {
+    vector<int> cpus = cpus_of_node(node);
+    if (cpus.empty()) {
+      return -1;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus) {
+      CPU_SET(cpu, &cpuset);
+    }
+    return sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+  }
+
+  /// prefer the node for the pages of the range, it must be called before
+  /// the pages are touched or registered.
+  static int bind_memory(void *addr, uint64_t len, int node) {
+    if (node < 0 || node >= 64) {
+      return -1;
+    }
+    unsigned long nodemask = 1UL << node;  // NOLINT
+    return syscall(SYS_mbind, addr, len, NUMA_MPOL_PREFERRED, &nodemask,
+                   sizeof(nodemask) * 8, 0);
+  }
+
+ private:
+  static int read_int(const string &file) {
+    std::ifstream in(file);
+    int value;
+    if (!(in >> value)) {
+      return -1;
+    }
+    return value;
+  }
+};
+
+#endif  // PMPOOL_NUMA_H_
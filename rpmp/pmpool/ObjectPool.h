@@ -0,0 +1,61 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/ObjectPool.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Wednesday, March 18th 2020, 9:21:05 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_OBJECTPOOL_H_
+#define PMPOOL_OBJECTPOOL_H_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "queue/concurrentqueue.h"
+
+using moodycamel::ConcurrentQueue;
+
+/**
+ * @brief ObjectPool recycles objects on the request path so that the steady
+ * state performs no heap allocation. Free objects are kept in a lock-free
+ * queue, which keeps one sub-queue per producer thread, so objects mostly
+ * return to the worker that released them. A new object is created only when
+ * the pool is empty.
+ */
+template <class T>
+class ObjectPool {
+ public:
+  ObjectPool() = delete;
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool(std::function<T *()> factory, uint32_t initial_num)
+      : factory_(factory) {
+    for (uint32_t i = 0; i < initial_num; i++) {
+      free_objects_.enqueue(factory_());
+    }
+  }
+  ~ObjectPool() {
+    T *t;
+    while (free_objects_.try_dequeue(t)) {
+      delete t;
+    }
+  }
+
+  T *get() {
+    T *t;
+    if (free_objects_.try_dequeue(t)) {
+      return t;
+    }
+    return factory_();
+  }
+
+  void put(T *t) { free_objects_.enqueue(t); }
+
+ private:
+  std::function<T *()> factory_;
+  ConcurrentQueue<T *> free_objects_;
+};
+
+#endif  // PMPOOL_OBJECTPOOL_H_
@@ -10,25 +10,39 @@
 #ifndef PMPOOL_PMEMALLOCATOR_H_
 #define PMPOOL_PMEMALLOCATOR_H_
 
+#include <libpmem.h>
 #include <libpmemobj.h>
 
 #include <atomic>
 #include <chrono>  // NOLINT
 #include <iostream>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <vector>
 
 #include "Allocator.h"
+#include "CopyEngine.h"
 #include "DataServer.h"
+#include "FlatIndex.h"
 #include "Log.h"
 #include "NetworkServer.h"
 
 using std::shared_ptr;
 using std::unordered_map;
+using std::vector;
 
 #define PMEMOBJ_ALLOCATOR_LAYOUT_NAME "pmemobj_allocator_layout"
+// index entries per checkpoint segment, segments are loaded in parallel.
+#define PMEMOBJ_CHECKPOINT_SEGMENT_ENTRIES (1 << 20)
+#define PMEMOBJ_RECOVERY_THREADS 8
+// blocks are also indexed at every granule boundary inside them, so that an
+// address inside a block is found without an ordered index. Segments of
+// large transfers start at multiples of a larger size into their block, so
+// they are always past a boundary.
+#define PMEMOBJ_GRANULE_SIZE (1ULL << 20)
 
 // block header stored in pmem
 struct block_hdr {
@@ -44,12 +58,31 @@ struct block_entry {
   PMEMoid data;
 };
 
+// one in-memory index entry, address to block entry offset
+struct index_entry {
+  uint64_t addr;
+  uint64_t off;
+};
+
+// segment of the index checkpoint stored in pmem, followed by num entries
+// of the index, or of the granule index if granules is set.
+struct index_checkpoint {
+  PMEMoid next;
+  uint64_t num;
+  uint64_t granules;
+};
+
 // pmem root entry
 struct Base {
   PMEMoid head;
   PMEMoid tail;
   PMEMrwlock rwlock;
   uint64_t bytes_written;
+  // index checkpoint written on close, it matches the block list only while
+  // clean is set.
+  PMEMoid checkpoint;
+  uint64_t clean;
+  uint64_t meta_root;
 };
 
 struct PmemContext {
@@ -59,7 +92,7 @@ struct PmemContext {
 };
 
 // pmem data allocation types
-enum types { BLOCK_ENTRY_TYPE, DATA_TYPE, MAX_TYPE };
+enum types { BLOCK_ENTRY_TYPE, DATA_TYPE, CHECKPOINT_TYPE, MAX_TYPE };
 
 /**
  * @brief libpmemobj based implementation of Allocator interface.
@@ -83,6 +116,9 @@ class PmemObjAllocator : public Allocator {
                                     err_msg);
       }
     }
+    if (pmemContext_.pop != nullptr) {
+      is_pmem_ = pmem_is_pmem(pmemContext_.pop, diskInfo_->size);
+    }
     return 0;
   }
 
@@ -117,19 +153,10 @@ class PmemObjAllocator : public Allocator {
                             (uint64_t)pmemContext_.pop, wid_);
     bep->hdr.size = size;
 
-    uint64_t start =
-        std::chrono::high_resolution_clock::now().time_since_epoch() /
-        std::chrono::milliseconds(1);
     char *pmem_data = static_cast<char *>(pmemobj_direct(bep->data));
     if (content != nullptr) {
-      memcpy(pmem_data, content, size);
+      copy_data(pmem_data, content, size);
     }
-    uint64_t end =
-        std::chrono::high_resolution_clock::now().time_since_epoch() /
-        std::chrono::milliseconds(1);
-    total += (end - start);
-    // std::cout << "index " << wid_ << ", total is " << total / 1000.0
-    //           << std::endl;
 
     // add the modified root object to the undo data
     pmemobj_tx_add_range(pmemContext_.poid, 0, sizeof(struct Base));
@@ -160,43 +187,36 @@ class PmemObjAllocator : public Allocator {
   }
 
   int write(uint64_t address, const char *content, uint64_t size) override {
-    std::unique_lock<std::mutex> l(mtx);
-    if (!index_map.count(address)) {
+    char *pmem_data = translate(address, size);
+    if (pmem_data == nullptr) {
       return -1;
     }
-    PMEMoid data = index_map[address];
-    struct block_entry *bep = (struct block_entry *)pmemobj_direct(data);
-    char *pmem_data = static_cast<char *>(pmemobj_direct(bep->data));
-    // pmemobj_memcpy_persist(pmemContext_.pop, pmem_data, content, size);
-    uint64_t start =
-        std::chrono::high_resolution_clock::now().time_since_epoch() /
-        std::chrono::milliseconds(1);
-    memcpy(pmem_data, content, size);
-    uint64_t end =
-        std::chrono::high_resolution_clock::now().time_since_epoch() /
-        std::chrono::milliseconds(1);
-    total += (end - start);
-    l.unlock();
+    copy_data(pmem_data, content, size);
     return 0;
   }
 
-  uint64_t get_virtual_address(uint64_t address) {
-    std::unique_lock<std::mutex> l(mtx);
-    if (!index_map.count(address)) {
+  uint64_t get_virtual_address(uint64_t address, uint64_t size) override {
+    char *pmem_data = translate(address, size);
+    if (pmem_data == nullptr) {
       return -1;
     }
-    PMEMoid data = index_map[address];
-    struct block_entry *bep = (struct block_entry *)pmemobj_direct(data);
-    char *pmem_data = static_cast<char *>(pmemobj_direct(bep->data));
-    l.unlock();
     return (uint64_t)pmem_data;
   }
 
   int release(uint64_t address) override {
     jmp_buf env;
+    // the index entry is taken inside the transaction, so a concurrent
+    // release of the same address fails instead of freeing the block twice.
+    // It is put back if the transaction aborts.
+    volatile uint64_t taken_off = 0;
+    volatile uint64_t taken_size = 0;
     if (setjmp(env)) {
       // end the transaction
       (void)pmemobj_tx_end();
+      if (taken_off != 0) {
+        index_.insert(address, taken_off);
+        index_granules(address, taken_size, taken_off);
+      }
       return -1;
     }
 
@@ -206,43 +226,75 @@ class PmemObjAllocator : public Allocator {
       perror("pmemobj_tx_begin failed in pmemkv put");
       return -1;
     }
-    if (!index_map.count(address)) {
+    uint64_t off;
+    if (!index_.erase(address, &off)) {
       (void)pmemobj_tx_end();
       perror("address not found");
       return -1;
     }
-    PMEMoid data = index_map[address];
+    PMEMoid data = {pmemContext_.poid.pool_uuid_lo, off};
     struct block_entry *bep = (struct block_entry *)pmemobj_direct(data);
+    taken_off = off;
+    taken_size = bep->hdr.size;
+    unindex_granules(address, bep->hdr.size);
     struct block_entry *prev_bep =
         (struct block_entry *)pmemobj_direct(bep->hdr.pre);
     struct block_entry *next_bep =
         (struct block_entry *)pmemobj_direct(bep->hdr.next);
     pmemobj_tx_add_range(pmemContext_.poid, 0, sizeof(struct Base));
     if (prev_bep == nullptr) {
-      if (next_bep == nullptr) {
-        pmemContext_.base->head = OID_NULL;
-        pmemContext_.base->tail = OID_NULL;
-      } else {
-        pmemContext_.base->head = bep->hdr.next;
-        next_bep->hdr.pre = OID_NULL;
-      }
+      pmemContext_.base->head = bep->hdr.next;
     } else {
-      pmemobj_tx_add_range(bep->hdr.pre, 0, sizeof(struct Base));
+      pmemobj_tx_add_range(bep->hdr.pre, 0, sizeof(struct block_entry));
       prev_bep->hdr.next = bep->hdr.next;
     }
+    if (next_bep == nullptr) {
+      pmemContext_.base->tail = bep->hdr.pre;
+    } else {
+      pmemobj_tx_add_range(bep->hdr.next, 0, sizeof(struct block_entry));
+      next_bep->hdr.pre = bep->hdr.pre;
+    }
     pmemContext_.base->bytes_written -= bep->hdr.size;
-    pmemobj_tx_add_range(data, 0, sizeof(struct Base));
-    bep->hdr.pre = OID_NULL;
-    bep->hdr.next = OID_NULL;
-    pmemobj_free(&data);
-    pmemobj_free(&bep->data);
+    pmemobj_tx_free(bep->data);
+    pmemobj_tx_free(data);
 
     pmemobj_tx_commit();
     (void)pmemobj_tx_end();
-
     return 0;
   }
 
+  /// arenas are emulated with ordinary blocks, membership is kept in memory
+  /// only, so blocks of an arena become ordinary blocks after a restart.
+  uint64_t allocate_in_arena(uint64_t arena, uint64_t size,
+                             const char *content = nullptr) override {
+    uint64_t address = allocate_and_write(size, content);
+    if (address != (uint64_t)-1) {
+      std::lock_guard<std::mutex> l(arena_mtx_);
+      arenas_[arena].push_back(address);
+    }
+    return address;
+  }
+
+  int release_arena(uint64_t arena) override {
+    vector<uint64_t> addresses;
+    {
+      std::lock_guard<std::mutex> l(arena_mtx_);
+      auto it = arenas_.find(arena);
+      if (it == arenas_.end()) {
+        return 0;
+      }
+      addresses.swap(it->second);
+      arenas_.erase(it);
+    }
+    int res = 0;
+    for (auto address : addresses) {
+      if (release(address)) {
+        res = -1;
+      }
+    }
+    return res;
+  }
+
   int release_all() override {
     PMEMoid cur_oid = pmemContext_.base->head;
     while (cur_oid.off != 0 && cur_oid.pool_uuid_lo != 0) {
@@ -258,6 +310,12 @@ class PmemObjAllocator : public Allocator {
     pmemContext_.base->head = OID_NULL;
     pmemContext_.base->tail = OID_NULL;
     pmemContext_.base->bytes_written = 0;
+    set_meta_root(0);
+    free_meta();
+    {
+      std::lock_guard<std::mutex> l(arena_mtx_);
+      arenas_.clear();
+    }
 
     return 0;
   }
@@ -291,7 +349,73 @@ class PmemObjAllocator : public Allocator {
 
   Chunk *get_rma_chunk() { return base_ck; }
 
+  int persist(uint64_t address, uint64_t size) override {
+    char *pmem_data = translate(address, size);
+    if (pmem_data == nullptr) {
+      return -1;
+    }
+    pmemobj_persist(pmemContext_.pop, pmem_data, size);
+    return 0;
+  }
+
+  int flush(uint64_t address, uint64_t size) override {
+    char *pmem_data = translate(address, size);
+    if (pmem_data == nullptr) {
+      return -1;
+    }
+    if (diskInfo_->durability == DURABILITY_PERSIST) {
+      pmemobj_persist(pmemContext_.pop, pmem_data, size);
+    } else if (diskInfo_->durability == DURABILITY_GROUP_COMMIT) {
+      pmemobj_flush(pmemContext_.pop, pmem_data, size);
+    }
+    return 0;
+  }
+
+  void drain() override { pmemobj_drain(pmemContext_.pop); }
+
+  void set_copy_engine(CopyEngine *copyEngine) override {
+    copyEngine_ = copyEngine;
+  }
+
+  /// libpmemobj does not expose its free lists, so the free space is
+  /// reported as one block.
+  void get_stats(pool_stats *stats) override {
+    stats->capacity = diskInfo_->size;
+    stats->used = pmemContext_.base != nullptr
+                      ? pmemContext_.base->bytes_written
+                      : 0;
+    stats->largest_free =
+        stats->capacity > stats->used ? stats->capacity - stats->used : 0;
+    stats->blocks = index_.size();
+  }
+
+  uint64_t get_meta_root() override { return pmemContext_.base->meta_root; }
+
+  int set_meta_root(uint64_t address) override {
+    pmemContext_.base->meta_root = address;
+    pmemobj_persist(pmemContext_.pop, &pmemContext_.base->meta_root,
+                    sizeof(uint64_t));
+    return 0;
+  }
+
  private:
+  /// copy data into the pool, bypassing the cache unless it is volatile.
+  void copy_data(char *dest, const char *src, uint64_t size) {
+    if (diskInfo_->durability == DURABILITY_VOLATILE) {
+      memcpy(dest, src, size);
+      return;
+    }
+    if (copyEngine_ != nullptr && is_pmem_) {
+      copyEngine_->copy(dest, src, size);
+    } else {
+      pmemobj_memcpy(pmemContext_.pop, dest, src, size,
+                     PMEMOBJ_F_MEM_NONTEMPORAL | PMEMOBJ_F_MEM_NODRAIN);
+    }
+    if (diskInfo_->durability == DURABILITY_PERSIST) {
+      pmemobj_drain(pmemContext_.pop);
+    }
+  }
+
   int create() {
     // debug setting
     int sds_write_value = 0;
@@ -310,6 +434,10 @@ class PmemObjAllocator : public Allocator {
     pmemContext_.base->head = OID_NULL;
     pmemContext_.base->tail = OID_NULL;
     pmemContext_.base->bytes_written = 0;
+    pmemContext_.base->checkpoint = OID_NULL;
+    pmemContext_.base->clean = 0;
+    pmemContext_.base->meta_root = 0;
+    recovered_ = true;
 
     if (server_) {
       base_ck = server_->register_rma_buffer(
@@ -344,36 +472,249 @@ class PmemObjAllocator : public Allocator {
 
     pmemContext_.poid = pmemobj_root(pmemContext_.pop, sizeof(struct Base));
     pmemContext_.base = (struct Base *)pmemobj_direct(pmemContext_.poid);
-    PMEMoid next = pmemContext_.base->head;
-    while (next.off != 0 && next.pool_uuid_lo != 0) {
-      if (update_meta(next)) {
-        return -1;
+    uint64_t start =
+        std::chrono::high_resolution_clock::now().time_since_epoch() /
+        std::chrono::milliseconds(1);
+    bool clean = pmemContext_.base->clean;
+    // any update from now on invalidates the checkpoint.
+    pmemContext_.base->clean = 0;
+    pmemobj_persist(pmemContext_.pop, &pmemContext_.base->clean,
+                    sizeof(uint64_t));
+    bool from_checkpoint = clean && load_checkpoint() == 0;
+    if (!from_checkpoint) {
+      free_meta();
+      PMEMoid next = pmemContext_.base->head;
+      while (next.off != 0 && next.pool_uuid_lo != 0) {
+        if (update_meta(next)) {
+          return -1;
+        }
+        struct block_entry *bep = (struct block_entry *)pmemobj_direct(next);
+        next = bep->hdr.next;
       }
-      struct block_entry *bep = (struct block_entry *)pmemobj_direct(next);
-      next = bep->hdr.next;
     }
+    if (free_checkpoint()) {
+      return -1;
+    }
+    recovered_ = true;
+    uint64_t end =
+        std::chrono::high_resolution_clock::now().time_since_epoch() /
+        std::chrono::milliseconds(1);
+    log_->get_file_log()->info(
+        "recovered " + std::to_string(index_.size()) + " blocks of " +
+        diskInfo_->path +
+        (from_checkpoint ? " from checkpoint" : " from block list") +
+        " in " + std::to_string(end - start) + "ms");
     return 0;
   }
 
   void close() {
-    pmemobj_close(pmemContext_.pop);
+    if (pmemContext_.pop != nullptr) {
+      // an index that failed to recover must not be checkpointed.
+      if (recovered_ && write_checkpoint()) {
+        log_->get_file_log()->warn("failed to checkpoint index of " +
+                                   diskInfo_->path);
+      }
+      pmemobj_close(pmemContext_.pop);
+      pmemContext_.pop = nullptr;
+    }
     free_meta();
   }
 
+  /// dump the index and the granule index as a chain of segments so that the
+  /// next open loads them in parallel instead of walking the block list. Each segment is linked
+  /// into the root as it is allocated, so an interrupted checkpoint is
+  /// reclaimed by the next open.
+  int write_checkpoint() {
+    if (free_checkpoint()) {
+      return -1;
+    }
+    if (checkpoint_index(&index_, 0) || checkpoint_index(&granules_, 1)) {
+      return -1;
+    }
+    pmemContext_.base->clean = 1;
+    pmemobj_persist(pmemContext_.pop, &pmemContext_.base->clean,
+                    sizeof(uint64_t));
+    return 0;
+  }
+
+  /// add the entries of index to the checkpoint as segments of the kind.
+  int checkpoint_index(FlatIndex *index, uint64_t granules) {
+    uint64_t num = index->size();
+    vector<index_checkpoint *> segments;
+    for (uint64_t i = 0; i < num; i += PMEMOBJ_CHECKPOINT_SEGMENT_ENTRIES) {
+      uint64_t seg_num = std::min<uint64_t>(
+          num - i, PMEMOBJ_CHECKPOINT_SEGMENT_ENTRIES);
+      PMEMoid head = pmemContext_.base->checkpoint;
+      if (pmemobj_alloc(pmemContext_.pop, &pmemContext_.base->checkpoint,
+                        sizeof(struct index_checkpoint) +
+                            seg_num * sizeof(struct index_entry),
+                        CHECKPOINT_TYPE, construct_checkpoint, &head)) {
+        return -1;
+      }
+      auto seg = (struct index_checkpoint *)pmemobj_direct(
+          pmemContext_.base->checkpoint);
+      seg->num = seg_num;
+      seg->granules = granules;
+      segments.push_back(seg);
+    }
+    // segments were prepended, fill them from the tail of the chain.
+    uint64_t pos = 0;
+    index->for_each([&](uint64_t addr, uint64_t off) {
+      if (pos == num) {
+        return;
+      }
+      uint64_t seg_id = pos / PMEMOBJ_CHECKPOINT_SEGMENT_ENTRIES;
+      index_checkpoint *seg = segments[segments.size() - 1 - seg_id];
+      checkpoint_entries(seg)[pos % PMEMOBJ_CHECKPOINT_SEGMENT_ENTRIES] = {
+          addr, off};
+      pos++;
+    });
+    if (pos != num) {
+      return -1;
+    }
+    for (auto seg : segments) {
+      pmemobj_persist(pmemContext_.pop, seg,
+                      sizeof(struct index_checkpoint) +
+                          seg->num * sizeof(struct index_entry));
+    }
+    return 0;
+  }
+
+  /// load the checkpoint segments into the index with one thread per group
+  /// of segments.
+  int load_checkpoint() {
+    vector<index_checkpoint *> segments;
+    uint64_t num[2] = {0, 0};
+    PMEMoid next = pmemContext_.base->checkpoint;
+    while (!OID_IS_NULL(next)) {
+      auto seg = (struct index_checkpoint *)pmemobj_direct(next);
+      segments.push_back(seg);
+      num[seg->granules ? 1 : 0] += seg->num;
+      next = seg->next;
+    }
+    index_.reserve(num[0]);
+    granules_.reserve(num[1]);
+    std::atomic<bool> failed(false);
+    std::atomic<uint64_t> seg_id(0);
+    auto load = [&]() {
+      for (uint64_t i = seg_id++; i < segments.size(); i = seg_id++) {
+        index_entry *entries = checkpoint_entries(segments[i]);
+        FlatIndex &index = segments[i]->granules ? granules_ : index_;
+        for (uint64_t j = 0; j < segments[i]->num; j++) {
+          if (!index.insert(entries[j].addr, entries[j].off)) {
+            failed = true;
+          }
+        }
+      }
+    };
+    vector<std::thread> threads;
+    uint64_t thread_num =
+        std::min<uint64_t>(segments.size(), PMEMOBJ_RECOVERY_THREADS);
+    for (uint64_t i = 1; i < thread_num; i++) {
+      threads.emplace_back(load);
+    }
+    load();
+    for (auto &t : threads) {
+      t.join();
+    }
+    return failed ? -1 : 0;
+  }
+
+  int free_checkpoint() {
+    while (!OID_IS_NULL(pmemContext_.base->checkpoint)) {
+      jmp_buf env;
+      if (setjmp(env)) {
+        (void)pmemobj_tx_end();
+        return -1;
+      }
+      if (pmemobj_tx_begin(pmemContext_.pop, env, TX_PARAM_NONE)) {
+        return -1;
+      }
+      PMEMoid head = pmemContext_.base->checkpoint;
+      auto seg = (struct index_checkpoint *)pmemobj_direct(head);
+      pmemobj_tx_add_range(pmemContext_.poid, 0, sizeof(struct Base));
+      pmemContext_.base->checkpoint = seg->next;
+      pmemobj_tx_free(head);
+      pmemobj_tx_commit();
+      (void)pmemobj_tx_end();
+    }
+    return 0;
+  }
+
+  static int construct_checkpoint(PMEMobjpool *pop, void *ptr, void *arg) {
+    auto seg = reinterpret_cast<struct index_checkpoint *>(ptr);
+    seg->next = *reinterpret_cast<PMEMoid *>(arg);
+    seg->num = 0;
+    seg->granules = 0;
+    pmemobj_persist(pop, seg, sizeof(struct index_checkpoint));
+    return 0;
+  }
+
+  static index_entry *checkpoint_entries(index_checkpoint *seg) {
+    return reinterpret_cast<index_entry *>(seg + 1);
+  }
+
+  /// the global address of a block is the offset of its data in the pool.
+  /// The address may point into a block, the access must stay inside the
+  /// block that contains it. The block is found through the index, or
+  /// through the granule the address lies in, and bounded by the size in its
+  /// header.
+  char *translate(uint64_t address, uint64_t size) {
+    uint64_t offset = address & ((1ULL << 48) - 1);
+    if (GET_WID(address) != (uint64_t)wid_ || offset == 0 ||
+        offset >= diskInfo_->size) {
+      return nullptr;
+    }
+    uint64_t off;
+    if (!index_.find(address, &off) &&
+        !granules_.find(address & ~(PMEMOBJ_GRANULE_SIZE - 1), &off)) {
+      return nullptr;
+    }
+    PMEMoid oid = {pmemContext_.poid.pool_uuid_lo, off};
+    struct block_entry *bep = (struct block_entry *)pmemobj_direct(oid);
+    uint64_t start = bep->hdr.addr;
+    if (address < start || address - start > bep->hdr.size ||
+        size > bep->hdr.size - (address - start)) {
+      return nullptr;
+    }
+    return reinterpret_cast<char *>(pmemContext_.pop) + offset;
+  }
+
+  /// the index finds the block entry on release and bounds accesses to the
+  /// block.
   int update_meta(const PMEMoid &oid) {
-    std::lock_guard<std::mutex> l(mtx);
     struct block_entry *bep = (struct block_entry *)pmemobj_direct(oid);
-    if (!index_map.count(bep->hdr.addr)) {
-      index_map[bep->hdr.addr] = oid;
-    } else {
-      assert("invalide operation.");
+    if (!index_.insert(bep->hdr.addr, oid.off)) {
+      assert(false && "invalide operation.");
+      return -1;
     }
+    index_granules(bep->hdr.addr, bep->hdr.size, oid.off);
     return 0;
   }
 
+  /// first granule boundary past the start of a block.
+  static uint64_t first_granule(uint64_t address) {
+    return (address & ~(PMEMOBJ_GRANULE_SIZE - 1)) + PMEMOBJ_GRANULE_SIZE;
+  }
+
+  void index_granules(uint64_t address, uint64_t size, uint64_t off) {
+    for (uint64_t granule = first_granule(address); granule < address + size;
+         granule += PMEMOBJ_GRANULE_SIZE) {
+      granules_.insert(granule, off);
+    }
+  }
+
+  void unindex_granules(uint64_t address, uint64_t size) {
+    for (uint64_t granule = first_granule(address); granule < address + size;
+         granule += PMEMOBJ_GRANULE_SIZE) {
+      granules_.erase(granule);
+    }
+  }
+
   int free_meta() {
-    std::lock_guard<std::mutex> l(mtx);
-    index_map.clear();
+    index_.clear();
+    granules_.clear();
+    return 0;
   }
 
  private:
@@ -381,12 +722,17 @@ class PmemObjAllocator : public Allocator {
   DiskInfo *diskInfo_;
   NetworkServer *server_;
   int wid_;
-  PmemContext pmemContext_;
-  std::mutex mtx;
-  unordered_map<uint64_t, PMEMoid> index_map;
-  uint64_t total = 0;
+  PmemContext pmemContext_ = {};
+  FlatIndex index_;
+  /// granule boundary to the block entry of the block it lies in.
+  FlatIndex granules_;
+  bool recovered_ = false;
+  std::mutex arena_mtx_;
+  unordered_map<uint64_t, vector<uint64_t>> arenas_;
   char str[1048576];
   Chunk *base_ck;
+  int is_pmem_ = 0;
+  CopyEngine *copyEngine_ = nullptr;
 };
 
 #endif  // PMPOOL_PMEMALLOCATOR_H_
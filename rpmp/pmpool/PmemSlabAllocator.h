@@ -0,0 +1,967 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/PmemSlabAllocator.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Thursday, March 19th 2020, 2:17:40 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_PMEMSLABALLOCATOR_H_
+#define PMPOOL_PMEMSLABALLOCATOR_H_
+
+#include <libpmem.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Allocator.h"
+#include "CopyEngine.h"
+#include "Log.h"
+#include "NetworkServer.h"
+
+using std::unordered_map;
+using std::vector;
+
+#define PMEM_SLAB_MAGIC 0x42414c53504d5052ULL  // "RPMPSLAB"
+/// every slab is carved into objects of one size class.
+#define PMEM_SLAB_SIZE (4ULL << 20)
+#define PMEM_SLAB_MIN_CLASS 256
+/// one bit per object of the smallest size class.
+#define PMEM_SLAB_BITMAP_SIZE (PMEM_SLAB_SIZE / PMEM_SLAB_MIN_CLASS / 8)
+#define PMEM_SLAB_POOL_HEADER_SIZE 4096
+#define PMEM_SLAB_THREAD_CACHES 64
+#define PMEM_SLAB_OFFSET_MASK ((1ULL << 48) - 1)
+/// maximum number of live arenas per pool.
+#define PMEM_SLAB_ARENA_NUM 4096
+#define PMEM_SLAB_ARENA_ALIGN 64
+
+/// persistent slab header: state in the low 32 bits, argument in the high
+/// 32 bits, which is the size class of a small slab or the number of slabs of
+/// a large run. It is a single word, so updating it is failure atomic.
+#define SLAB_HDR(state, arg) (((uint64_t)(arg) << 32) | (uint32_t)(state))
+#define SLAB_HDR_STATE(hdr) ((uint32_t)(hdr))
+#define SLAB_HDR_ARG(hdr) ((uint32_t)((hdr) >> 32))
+
+enum slab_state : uint32_t {
+  SLAB_FREE = 0,
+  SLAB_SMALL,
+  SLAB_LARGE,
+  SLAB_LARGE_TAIL,
+  SLAB_ARENA
+};
+
+enum arena_state : uint32_t { ARENA_FREE = 0, ARENA_ACTIVE };
+
+/// an arena slab is tagged with the record of its arena and the low bits of
+/// the record generation, a tag that does not match a live record is stale.
+#define ARENA_TAG(record, generation) \
+  (((uint32_t)(record) << 16) | ((generation)&0xffff))
+#define ARENA_TAG_RECORD(tag) ((tag) >> 16)
+
+// pool header stored at the beginning of the mapping
+struct slab_pool_hdr {
+  uint64_t magic;
+  uint64_t slab_size;
+  uint64_t slab_num;
+  uint64_t arena_offset;
+  uint64_t slab_hdr_offset;
+  uint64_t bitmap_offset;
+  uint64_t data_offset;
+  uint64_t meta_root;
+};
+
+// arena record, state is a SLAB_HDR like word of state and generation
+struct arena_record {
+  uint64_t arena;
+  uint64_t state;
+};
+
+/**
+ * @brief libpmem based implementation of Allocator interface.
+ * The pool is split into fixed size slabs. A small object is taken from a slab
+ * of its size class and recorded by one bit of the persistent bitmap of the
+ * slab, so allocation and release cost one atomic update and one cache line
+ * flush. Each thread allocates from slabs it owns exclusively, other threads
+ * only ever clear bits of them. Objects larger than a slab take a run of
+ * whole slabs. Memory is never zeroed, and the global address of an object is
+ * its offset in the mapping, so translation needs no lookup.
+ * Arenas serve data that is written once and dropped all together: objects
+ * are bump allocated into slabs of the arena, and releasing the arena is a
+ * single persistent update of its record.
+ */
+class PmemSlabAllocator : public Allocator {
+ public:
+  PmemSlabAllocator() = delete;
+  explicit PmemSlabAllocator(Log *log, DiskInfo *diskInfo,
+                             NetworkServer *server, int wid)
+      : log_(log), diskInfo_(diskInfo), server_(server), wid_(wid) {
+    for (uint64_t p = PMEM_SLAB_MIN_CLASS; p < PMEM_SLAB_SIZE; p *= 2) {
+      class_sizes_.push_back(p);
+      class_sizes_.push_back(p + p / 4);
+      class_sizes_.push_back(p + p / 2);
+      class_sizes_.push_back(p + p * 3 / 4);
+    }
+    class_sizes_.push_back(PMEM_SLAB_SIZE);
+    classes_.reset(new SizeClass[class_sizes_.size()]);
+    for (uint32_t i = 0; i < class_sizes_.size(); i++) {
+      classes_[i].objs_per_slab = PMEM_SLAB_SIZE / class_sizes_[i];
+    }
+    caches_.reset(new ThreadCache[PMEM_SLAB_THREAD_CACHES]);
+    for (int i = 0; i < PMEM_SLAB_THREAD_CACHES; i++) {
+      caches_[i].current.assign(class_sizes_.size(), -1);
+      caches_[i].hint.assign(class_sizes_.size(), 0);
+    }
+  }
+  ~PmemSlabAllocator() { close(); }
+
+  int init() override {
+    base_ = static_cast<char *>(pmem_map_file(diskInfo_->path.c_str(), 0, 0,
+                                              0, &mapped_len_, &is_pmem_));
+    if (base_ == nullptr) {
+      base_ = static_cast<char *>(
+          pmem_map_file(diskInfo_->path.c_str(), diskInfo_->size,
+                        PMEM_FILE_CREATE, 0666, &mapped_len_, &is_pmem_));
+    }
+    if (base_ == nullptr) {
+      string err_msg = pmem_errormsg();
+      log_->get_file_log()->error("failed to map pmem pool, errmsg: " +
+                                  err_msg);
+      return -1;
+    }
+    hdr_ = reinterpret_cast<slab_pool_hdr *>(base_);
+    if (hdr_->magic != PMEM_SLAB_MAGIC || hdr_->slab_size != PMEM_SLAB_SIZE) {
+      if (format()) {
+        return -1;
+      }
+    }
+    if (recover()) {
+      return -1;
+    }
+
+    if (server_) {
+      base_ck = server_->register_rma_buffer(base_, mapped_len_);
+      assert(base_ck != nullptr);
+      log_->get_console_log()->info(
+          "successfully registered Persistent Memory(" + diskInfo_->path +
+          ") as RDMA region");
+    }
+    return 0;
+  }
+
+  uint64_t allocate_and_write(uint64_t size,
+                              const char *content = nullptr) override {
+    if (size == 0) {
+      size = 1;
+    }
+    char *data = size > PMEM_SLAB_SIZE ? allocate_large(size)
+                                       : allocate_small(size_to_class(size));
+    if (data == nullptr) {
+      return -1;
+    }
+    if (content != nullptr) {
+      copy_data(data, content, size);
+    }
+    return TO_GLOB(data, base_, wid_);
+  }
+
+  int write(uint64_t address, const char *content, uint64_t size) override {
+    uint64_t offset = address & PMEM_SLAB_OFFSET_MASK;
+    if (!contains(address) || size > object_capacity(offset)) {
+      return -1;
+    }
+    copy_data(base_ + offset, content, size);
+    return 0;
+  }
+
+  /// the range must lie in an allocated object, not a free slab.
+  uint64_t get_virtual_address(uint64_t address, uint64_t size) override {
+    if (!contains(address)) {
+      return -1;
+    }
+    uint64_t capacity = object_capacity(address & PMEM_SLAB_OFFSET_MASK);
+    if (capacity == 0 || size > capacity) {
+      return -1;
+    }
+    return (uint64_t)(base_ + (address & PMEM_SLAB_OFFSET_MASK));
+  }
+
+  int release(uint64_t address) override {
+    if (!contains(address)) {
+      return -1;
+    }
+    uint64_t offset = (address & PMEM_SLAB_OFFSET_MASK) - hdr_->data_offset;
+    uint32_t slab = offset / PMEM_SLAB_SIZE;
+    uint64_t slab_offset = offset % PMEM_SLAB_SIZE;
+    uint64_t hdr = __atomic_load_n(&slab_hdrs_[slab], __ATOMIC_ACQUIRE);
+    switch (SLAB_HDR_STATE(hdr)) {
+      case SLAB_SMALL: {
+        uint32_t cls = SLAB_HDR_ARG(hdr);
+        if (slab_offset % class_sizes_[cls] != 0) {
+          return -1;
+        }
+        return release_small(slab, cls, slab_offset / class_sizes_[cls]);
+      }
+      case SLAB_LARGE: {
+        if (slab_offset != 0) {
+          return -1;
+        }
+        return release_large(slab, SLAB_HDR_ARG(hdr));
+      }
+      case SLAB_ARENA: {
+        /// reclaimed together with the arena
+        return 0;
+      }
+      default: { return -1; }
+    }
+  }
+
+  uint64_t allocate_in_arena(uint64_t arena, uint64_t size,
+                             const char *content = nullptr) override {
+    std::shared_ptr<Arena> a = get_arena(arena);
+    if (a == nullptr) {
+      return -1;
+    }
+    uint64_t aligned = align_up(size == 0 ? 1 : size, PMEM_SLAB_ARENA_ALIGN);
+    char *data;
+    {
+      std::lock_guard<std::mutex> l(a->mtx);
+      if (a->released) {
+        return -1;
+      }
+      if (aligned > a->remaining) {
+        uint32_t num = (aligned + PMEM_SLAB_SIZE - 1) / PMEM_SLAB_SIZE;
+        int64_t slab = take_free_slabs(num);
+        if (slab < 0) {
+          return -1;
+        }
+        for (uint32_t i = 0; i < num; i++) {
+          slab_hdrs_[slab + i] =
+              SLAB_HDR(SLAB_ARENA, ARENA_TAG(a->record, a->generation));
+          slabs_[slab + i].cls = SLAB_CLASS_ARENA;
+          a->slabs.push_back(slab + i);
+        }
+        persist(&slab_hdrs_[slab], num * sizeof(uint64_t));
+        a->cur = slab_data(slab);
+        a->remaining = num * PMEM_SLAB_SIZE;
+      }
+      data = a->cur;
+      a->cur += aligned;
+      a->remaining -= aligned;
+    }
+    if (content != nullptr) {
+      copy_data(data, content, size);
+    }
+    return TO_GLOB(data, base_, wid_);
+  }
+
+  int release_arena(uint64_t arena) override {
+    std::shared_ptr<Arena> a;
+    {
+      std::lock_guard<std::mutex> l(arenas_mtx_);
+      auto it = arenas_.find(arena);
+      if (it == arenas_.end()) {
+        return 0;
+      }
+      a = it->second;
+      arenas_.erase(it);
+    }
+    std::lock_guard<std::mutex> l(a->mtx);
+    a->released = true;
+    /// the only persistent step, slab headers of the arena become stale.
+    set_arena_state(a->record, SLAB_HDR(ARENA_FREE, a->generation));
+    for (uint32_t slab : a->slabs) {
+      slabs_[slab].cls = SLAB_CLASS_FREE;
+    }
+    {
+      std::lock_guard<std::mutex> slab_l(slab_mtx_);
+      free_slabs_.insert(a->slabs.begin(), a->slabs.end());
+    }
+    std::lock_guard<std::mutex> arenas_l(arenas_mtx_);
+    free_records_.push_back(a->record);
+    return 0;
+  }
+
+  int release_all() override {
+    std::lock_guard<std::mutex> arenas_l(arenas_mtx_);
+    std::lock_guard<std::mutex> l(slab_mtx_);
+    for (int i = 0; i < PMEM_SLAB_THREAD_CACHES; i++) {
+      std::lock_guard<std::mutex> cache_l(caches_[i].mtx);
+      caches_[i].current.assign(class_sizes_.size(), -1);
+      caches_[i].hint.assign(class_sizes_.size(), 0);
+    }
+    for (uint32_t i = 0; i < class_sizes_.size(); i++) {
+      std::lock_guard<std::mutex> class_l(classes_[i].mtx);
+      classes_[i].partial.clear();
+    }
+    memset_persist(base_ + hdr_->bitmap_offset, 0,
+                   hdr_->slab_num * PMEM_SLAB_BITMAP_SIZE);
+    memset_persist(slab_hdrs_, 0, hdr_->slab_num * sizeof(uint64_t));
+    memset_persist(records_, 0, PMEM_SLAB_ARENA_NUM * sizeof(arena_record));
+    set_meta_root(0);
+    arenas_.clear();
+    free_records_.clear();
+    for (uint32_t i = 0; i < PMEM_SLAB_ARENA_NUM; i++) {
+      free_records_.push_back(PMEM_SLAB_ARENA_NUM - 1 - i);
+    }
+    free_slabs_.clear();
+    for (uint32_t i = 0; i < hdr_->slab_num; i++) {
+      slabs_[i].reset();
+      free_slabs_.insert(i);
+    }
+    return 0;
+  }
+
+  int dump_all() override {
+    std::cout << "******************worker " << wid_
+              << " start dump*********************" << std::endl;
+    vector<uint64_t> slabs(class_sizes_.size(), 0);
+    vector<uint64_t> objs(class_sizes_.size(), 0);
+    uint64_t large = 0;
+    uint64_t arena = 0;
+    uint64_t free = 0;
+    for (uint32_t i = 0; i < hdr_->slab_num; i++) {
+      int32_t cls = slabs_[i].cls.load();
+      if (cls >= 0) {
+        slabs[cls]++;
+        objs[cls] += slabs_[i].used.load();
+      } else if (cls == SLAB_CLASS_LARGE) {
+        large++;
+      } else if (cls == SLAB_CLASS_ARENA) {
+        arena++;
+      } else {
+        free++;
+      }
+    }
+    for (uint32_t i = 0; i < class_sizes_.size(); i++) {
+      if (slabs[i] != 0) {
+        std::cout << "class " << class_sizes_[i] << ": " << slabs[i]
+                  << " slabs, " << objs[i] << " objects" << std::endl;
+      }
+    }
+    std::cout << "large slabs " << large << ", arena slabs " << arena
+              << ", free slabs " << free << std::endl;
+    std::cout << "******************worker " << wid_
+              << " end dump*********************" << std::endl;
+    return 0;
+  }
+
+  Chunk *get_rma_chunk() override { return base_ck; }
+
+  int persist(uint64_t address, uint64_t size) override {
+    uint64_t offset = address & PMEM_SLAB_OFFSET_MASK;
+    if (!contains(address) || size > mapped_len_ - offset) {
+      return -1;
+    }
+    persist(base_ + offset, size);
+    return 0;
+  }
+
+  int flush(uint64_t address, uint64_t size) override {
+    uint64_t offset = address & PMEM_SLAB_OFFSET_MASK;
+    if (!contains(address) || size > mapped_len_ - offset) {
+      return -1;
+    }
+    if (diskInfo_->durability == DURABILITY_VOLATILE) {
+      return 0;
+    }
+    if (is_pmem_ && diskInfo_->durability == DURABILITY_GROUP_COMMIT) {
+      pmem_flush(base_ + offset, size);
+    } else {
+      persist(base_ + offset, size);
+    }
+    return 0;
+  }
+
+  void drain() override {
+    if (is_pmem_) {
+      pmem_drain();
+    }
+  }
+
+  void set_copy_engine(CopyEngine *copyEngine) override {
+    copyEngine_ = copyEngine;
+  }
+
+  /// a snapshot of the volatile slab state, taken without stopping
+  /// allocations. Blocks of arenas are not counted, only their slabs.
+  void get_stats(pool_stats *stats) override {
+    stats->capacity = hdr_->slab_num * PMEM_SLAB_SIZE;
+    stats->used = 0;
+    stats->blocks = 0;
+    uint64_t largest_object = 0;
+    for (uint32_t i = 0; i < hdr_->slab_num; i++) {
+      int32_t cls = slabs_[i].cls.load();
+      if (cls >= 0) {
+        uint32_t used = slabs_[i].used.load();
+        stats->used += used * class_sizes_[cls];
+        stats->blocks += used;
+        if (used < classes_[cls].objs_per_slab) {
+          largest_object = std::max(largest_object, class_sizes_[cls]);
+        }
+      } else if (cls == SLAB_CLASS_LARGE || cls == SLAB_CLASS_ARENA) {
+        stats->used += PMEM_SLAB_SIZE;
+        if (SLAB_HDR_STATE(slab_hdrs_[i]) == SLAB_LARGE) {
+          stats->blocks++;
+        }
+      }
+    }
+    uint64_t run = 0;
+    uint64_t longest = 0;
+    {
+      std::lock_guard<std::mutex> l(slab_mtx_);
+      uint32_t prev = 0;
+      for (uint32_t slab : free_slabs_) {
+        run = (run != 0 && slab == prev + 1) ? run + 1 : 1;
+        longest = std::max(longest, run);
+        prev = slab;
+      }
+    }
+    stats->largest_free =
+        std::max<uint64_t>(longest * PMEM_SLAB_SIZE, largest_object);
+  }
+
+  uint64_t get_meta_root() override { return hdr_->meta_root; }
+
+  int set_meta_root(uint64_t address) override {
+    hdr_->meta_root = address;
+    persist(&hdr_->meta_root, sizeof(uint64_t));
+    return 0;
+  }
+
+ private:
+  static const int32_t SLAB_CLASS_FREE = -1;
+  static const int32_t SLAB_CLASS_LARGE = -2;
+  static const int32_t SLAB_CLASS_ARENA = -3;
+
+  // volatile state of a slab, rebuilt from the bitmaps on open
+  struct SlabState {
+    void reset() {
+      used = 0;
+      cls = SLAB_CLASS_FREE;
+      owned = false;
+      in_partial = false;
+    }
+    std::atomic<uint32_t> used{0};
+    /// size class, changed only under the mutex of the size class.
+    std::atomic<int32_t> cls{SLAB_CLASS_FREE};
+    bool owned = false;
+    bool in_partial = false;
+  };
+
+  struct SizeClass {
+    uint32_t objs_per_slab;
+    std::mutex mtx;
+    /// slabs with free objects that no thread owns.
+    std::set<uint32_t> partial;
+  };
+
+  // volatile state of an arena
+  struct Arena {
+    std::mutex mtx;
+    uint32_t record;
+    uint32_t generation;
+    vector<uint32_t> slabs;
+    /// bump pointer, an arena continues in a new slab after a restart.
+    char *cur = nullptr;
+    uint64_t remaining = 0;
+    bool released = false;
+  };
+
+  // slabs a thread allocates from, one per size class
+  struct ThreadCache {
+    std::mutex mtx;
+    vector<int64_t> current;
+    vector<uint32_t> hint;
+  };
+
+  static uint32_t thread_cache_index() {
+    static std::atomic<uint32_t> next_index{0};
+    thread_local uint32_t index = next_index++;
+    return index % PMEM_SLAB_THREAD_CACHES;
+  }
+
+  uint32_t size_to_class(uint64_t size) {
+    return std::lower_bound(class_sizes_.begin(), class_sizes_.end(), size) -
+           class_sizes_.begin();
+  }
+
+  bool contains(uint64_t address) {
+    uint64_t offset = address & PMEM_SLAB_OFFSET_MASK;
+    return GET_WID(address) == (uint64_t)wid_ && hdr_ != nullptr &&
+           offset >= hdr_->data_offset &&
+           offset < hdr_->data_offset + hdr_->slab_num * PMEM_SLAB_SIZE;
+  }
+
+  /// number of bytes from offset to the end of the object it points into.
+  uint64_t object_capacity(uint64_t offset) {
+    uint64_t data_offset = offset - hdr_->data_offset;
+    uint32_t slab = data_offset / PMEM_SLAB_SIZE;
+    uint64_t hdr = __atomic_load_n(&slab_hdrs_[slab], __ATOMIC_ACQUIRE);
+    switch (SLAB_HDR_STATE(hdr)) {
+      case SLAB_SMALL: {
+        uint64_t size = class_sizes_[SLAB_HDR_ARG(hdr)];
+        return size - data_offset % PMEM_SLAB_SIZE % size;
+      }
+      case SLAB_LARGE: {
+        return SLAB_HDR_ARG(hdr) * PMEM_SLAB_SIZE -
+               data_offset % PMEM_SLAB_SIZE;
+      }
+      case SLAB_ARENA: {
+        uint32_t last = slab + 1;
+        while (last < hdr_->slab_num && slab_hdrs_[last] == hdr) {
+          last++;
+        }
+        return (last - slab) * PMEM_SLAB_SIZE - data_offset % PMEM_SLAB_SIZE;
+      }
+      default: { return 0; }
+    }
+  }
+
+  /// find the arena or create it with a free record.
+  std::shared_ptr<Arena> get_arena(uint64_t arena) {
+    std::lock_guard<std::mutex> l(arenas_mtx_);
+    auto it = arenas_.find(arena);
+    if (it != arenas_.end()) {
+      return it->second;
+    }
+    if (free_records_.empty()) {
+      log_->get_file_log()->error("no free arena record in pmem pool " +
+                                  diskInfo_->path);
+      return nullptr;
+    }
+    uint32_t record = free_records_.back();
+    free_records_.pop_back();
+    auto a = std::make_shared<Arena>();
+    a->record = record;
+    a->generation = SLAB_HDR_ARG(records_[record].state) + 1;
+    records_[record].arena = arena;
+    persist(&records_[record].arena, sizeof(uint64_t));
+    set_arena_state(record, SLAB_HDR(ARENA_ACTIVE, a->generation));
+    arenas_[arena] = a;
+    return a;
+  }
+
+  void set_arena_state(uint32_t record, uint64_t state) {
+    __atomic_store_n(&records_[record].state, state, __ATOMIC_RELEASE);
+    persist(&records_[record].state, sizeof(uint64_t));
+  }
+
+  uint64_t *bitmap(uint32_t slab) {
+    return reinterpret_cast<uint64_t *>(base_ + hdr_->bitmap_offset +
+                                        slab * PMEM_SLAB_BITMAP_SIZE);
+  }
+
+  char *slab_data(uint32_t slab) {
+    return base_ + hdr_->data_offset + slab * PMEM_SLAB_SIZE;
+  }
+
+  void set_slab_hdr(uint32_t slab, uint64_t hdr) {
+    __atomic_store_n(&slab_hdrs_[slab], hdr, __ATOMIC_RELEASE);
+    persist(&slab_hdrs_[slab], sizeof(uint64_t));
+  }
+
+  char *allocate_small(uint32_t cls) {
+    ThreadCache &cache = caches_[thread_cache_index()];
+    std::lock_guard<std::mutex> l(cache.mtx);
+    while (true) {
+      int64_t slab = cache.current[cls];
+      if (slab >= 0) {
+        int64_t obj = take_object(slab, cls, &cache.hint[cls]);
+        if (obj >= 0) {
+          return slab_data(slab) + obj * class_sizes_[cls];
+        }
+        release_slab(slab, cls);
+      }
+      cache.current[cls] = acquire_slab(cls);
+      cache.hint[cls] = 0;
+      if (cache.current[cls] < 0) {
+        return nullptr;
+      }
+    }
+  }
+
+  /// set the first free bit of an owned slab, return the object index.
+  int64_t take_object(uint32_t slab, uint32_t cls, uint32_t *hint) {
+    uint64_t *words = bitmap(slab);
+    uint32_t objs = classes_[cls].objs_per_slab;
+    uint32_t word_num = (objs + 63) / 64;
+    for (uint32_t n = 0; n < word_num; n++) {
+      uint32_t w = (*hint + n) % word_num;
+      uint64_t valid = (w == word_num - 1 && objs % 64 != 0)
+                           ? (1ULL << (objs % 64)) - 1
+                           : ~0ULL;
+      uint64_t free_bits =
+          ~__atomic_load_n(&words[w], __ATOMIC_ACQUIRE) & valid;
+      if (free_bits == 0) {
+        continue;
+      }
+      uint32_t bit = __builtin_ctzll(free_bits);
+      /// only the owner sets bits, other threads may clear bits concurrently.
+      __atomic_fetch_or(&words[w], 1ULL << bit, __ATOMIC_ACQ_REL);
+      persist(&words[w], sizeof(uint64_t));
+      slabs_[slab].used++;
+      *hint = w;
+      return w * 64 + bit;
+    }
+    return -1;
+  }
+
+  int64_t acquire_slab(uint32_t cls) {
+    SizeClass &sc = classes_[cls];
+    {
+      std::lock_guard<std::mutex> l(sc.mtx);
+      if (!sc.partial.empty()) {
+        uint32_t slab = *sc.partial.begin();
+        sc.partial.erase(sc.partial.begin());
+        slabs_[slab].in_partial = false;
+        slabs_[slab].owned = true;
+        return slab;
+      }
+    }
+    int64_t slab = take_free_slabs(1);
+    if (slab < 0) {
+      return -1;
+    }
+    set_slab_hdr(slab, SLAB_HDR(SLAB_SMALL, cls));
+    std::lock_guard<std::mutex> l(sc.mtx);
+    slabs_[slab].owned = true;
+    slabs_[slab].cls = cls;
+    return slab;
+  }
+
+  /// hand an owned slab back, it stays with its size class unless empty.
+  void release_slab(uint32_t slab, uint32_t cls) {
+    SizeClass &sc = classes_[cls];
+    std::lock_guard<std::mutex> l(sc.mtx);
+    slabs_[slab].owned = false;
+    update_slab(slab, cls);
+  }
+
+  /// move an unowned slab to the partial list or back to the free slabs,
+  /// the mutex of its size class must be held.
+  void update_slab(uint32_t slab, uint32_t cls) {
+    SlabState &state = slabs_[slab];
+    uint32_t used = state.used;
+    if (used == 0) {
+      if (state.in_partial) {
+        classes_[cls].partial.erase(slab);
+        state.in_partial = false;
+      }
+      state.cls = SLAB_CLASS_FREE;
+      put_free_slabs(slab, 1);
+    } else if (used < classes_[cls].objs_per_slab && !state.in_partial) {
+      classes_[cls].partial.insert(slab);
+      state.in_partial = true;
+    }
+  }
+
+  int release_small(uint32_t slab, uint32_t cls, uint64_t obj) {
+    uint64_t *word = &bitmap(slab)[obj / 64];
+    uint64_t mask = 1ULL << (obj % 64);
+    if (!(__atomic_fetch_and(word, ~mask, __ATOMIC_ACQ_REL) & mask)) {
+      return -1;
+    }
+    persist(word, sizeof(uint64_t));
+    SizeClass &sc = classes_[cls];
+    uint32_t prev = slabs_[slab].used.fetch_sub(1);
+    /// the slab became partial or empty, it may need to change lists.
+    if (prev == sc.objs_per_slab || prev == 1) {
+      std::lock_guard<std::mutex> l(sc.mtx);
+      if (slabs_[slab].cls == (int32_t)cls && !slabs_[slab].owned) {
+        update_slab(slab, cls);
+      }
+    }
+    return 0;
+  }
+
+  char *allocate_large(uint64_t size) {
+    uint32_t num = (size + PMEM_SLAB_SIZE - 1) / PMEM_SLAB_SIZE;
+    int64_t slab = take_free_slabs(num);
+    if (slab < 0) {
+      return nullptr;
+    }
+    /// tails first, a run without a valid head is dropped on recovery.
+    for (uint32_t i = 1; i < num; i++) {
+      slab_hdrs_[slab + i] = SLAB_HDR(SLAB_LARGE_TAIL, 0);
+    }
+    persist(&slab_hdrs_[slab + 1], (num - 1) * sizeof(uint64_t));
+    set_slab_hdr(slab, SLAB_HDR(SLAB_LARGE, num));
+    for (uint32_t i = 0; i < num; i++) {
+      slabs_[slab + i].cls = SLAB_CLASS_LARGE;
+    }
+    return slab_data(slab);
+  }
+
+  int release_large(uint32_t slab, uint32_t num) {
+    uint64_t hdr = SLAB_HDR(SLAB_LARGE, num);
+    if (!__atomic_compare_exchange_n(&slab_hdrs_[slab], &hdr,
+                                     SLAB_HDR(SLAB_FREE, 0), false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return -1;
+    }
+    persist(&slab_hdrs_[slab], sizeof(uint64_t));
+    for (uint32_t i = 0; i < num; i++) {
+      slabs_[slab + i].cls = SLAB_CLASS_FREE;
+    }
+    put_free_slabs(slab, num);
+    return 0;
+  }
+
+  /// take num contiguous free slabs, return the first one or -1.
+  /// Single slabs come from the end of the pool to keep long runs at the
+  /// beginning for large objects.
+  int64_t take_free_slabs(uint32_t num) {
+    std::lock_guard<std::mutex> l(slab_mtx_);
+    if (free_slabs_.empty()) {
+      return -1;
+    }
+    if (num == 1) {
+      uint32_t slab = *free_slabs_.rbegin();
+      free_slabs_.erase(slab);
+      return slab;
+    }
+    uint32_t start = 0;
+    uint32_t len = 0;
+    for (uint32_t slab : free_slabs_) {
+      if (len != 0 && slab == start + len) {
+        len++;
+      } else {
+        start = slab;
+        len = 1;
+      }
+      if (len == num) {
+        free_slabs_.erase(free_slabs_.find(start),
+                          free_slabs_.upper_bound(start + num - 1));
+        return start;
+      }
+    }
+    return -1;
+  }
+
+  void put_free_slabs(uint32_t slab, uint32_t num) {
+    /// an empty small slab is freed here, a large run was freed by its head.
+    if (num == 1) {
+      set_slab_hdr(slab, SLAB_HDR(SLAB_FREE, 0));
+    } else {
+      memset_persist(&slab_hdrs_[slab + 1], 0, (num - 1) * sizeof(uint64_t));
+    }
+    std::lock_guard<std::mutex> l(slab_mtx_);
+    for (uint32_t i = 0; i < num; i++) {
+      free_slabs_.insert(slab + i);
+    }
+  }
+
+  int format() {
+    uint64_t per_slab = sizeof(uint64_t) + PMEM_SLAB_BITMAP_SIZE;
+    uint64_t arena_offset = PMEM_SLAB_POOL_HEADER_SIZE;
+    uint64_t slab_hdr_offset =
+        arena_offset + PMEM_SLAB_ARENA_NUM * sizeof(arena_record);
+    if (mapped_len_ < slab_hdr_offset + per_slab + PMEM_SLAB_SIZE) {
+      log_->get_file_log()->error("pmem pool " + diskInfo_->path +
+                                  " is too small");
+      return -1;
+    }
+    uint64_t slab_num =
+        (mapped_len_ - slab_hdr_offset) / (per_slab + PMEM_SLAB_SIZE);
+    uint64_t bitmap_offset, data_offset;
+    while (true) {
+      bitmap_offset = align_up(slab_hdr_offset + slab_num * sizeof(uint64_t),
+                               PMEM_SLAB_POOL_HEADER_SIZE);
+      data_offset = align_up(bitmap_offset + slab_num * PMEM_SLAB_BITMAP_SIZE,
+                             PMEM_SLAB_SIZE);
+      if (data_offset + slab_num * PMEM_SLAB_SIZE <= mapped_len_) {
+        break;
+      }
+      slab_num--;
+    }
+    hdr_->magic = 0;
+    persist(&hdr_->magic, sizeof(uint64_t));
+    memset_persist(base_ + PMEM_SLAB_POOL_HEADER_SIZE, 0,
+                   bitmap_offset + slab_num * PMEM_SLAB_BITMAP_SIZE -
+                       PMEM_SLAB_POOL_HEADER_SIZE);
+    hdr_->slab_size = PMEM_SLAB_SIZE;
+    hdr_->slab_num = slab_num;
+    hdr_->arena_offset = arena_offset;
+    hdr_->slab_hdr_offset = slab_hdr_offset;
+    hdr_->bitmap_offset = bitmap_offset;
+    hdr_->data_offset = data_offset;
+    hdr_->meta_root = 0;
+    persist(hdr_, sizeof(slab_pool_hdr));
+    hdr_->magic = PMEM_SLAB_MAGIC;
+    persist(&hdr_->magic, sizeof(uint64_t));
+    return 0;
+  }
+
+  /// rebuild the volatile slab state from the persistent headers and bitmaps.
+  int recover() {
+    records_ = reinterpret_cast<arena_record *>(base_ + hdr_->arena_offset);
+    slab_hdrs_ = reinterpret_cast<uint64_t *>(base_ + hdr_->slab_hdr_offset);
+    slabs_.reset(new SlabState[hdr_->slab_num]);
+    free_slabs_.clear();
+    arenas_.clear();
+    free_records_.clear();
+    for (uint32_t i = PMEM_SLAB_ARENA_NUM; i-- > 0;) {
+      if (SLAB_HDR_STATE(records_[i].state) != ARENA_ACTIVE) {
+        free_records_.push_back(i);
+        continue;
+      }
+      auto a = std::make_shared<Arena>();
+      a->record = i;
+      a->generation = SLAB_HDR_ARG(records_[i].state);
+      arenas_[records_[i].arena] = a;
+    }
+    for (uint32_t slab = 0; slab < hdr_->slab_num; slab++) {
+      uint64_t hdr = slab_hdrs_[slab];
+      uint32_t arg = SLAB_HDR_ARG(hdr);
+      switch (SLAB_HDR_STATE(hdr)) {
+        case SLAB_SMALL: {
+          if (arg >= class_sizes_.size()) {
+            break;
+          }
+          uint32_t objs = classes_[arg].objs_per_slab;
+          uint32_t used = 0;
+          for (uint32_t w = 0; w < (objs + 63) / 64; w++) {
+            used += __builtin_popcountll(bitmap(slab)[w]);
+          }
+          if (used == 0) {
+            break;
+          }
+          slabs_[slab].used = used;
+          slabs_[slab].cls = arg;
+          if (used < objs) {
+            classes_[arg].partial.insert(slab);
+            slabs_[slab].in_partial = true;
+          }
+          continue;
+        }
+        case SLAB_LARGE: {
+          uint32_t num = 1;
+          while (num < arg && slab + num < hdr_->slab_num &&
+                 SLAB_HDR_STATE(slab_hdrs_[slab + num]) == SLAB_LARGE_TAIL) {
+            num++;
+          }
+          if (arg == 0 || num != arg) {
+            break;
+          }
+          for (uint32_t i = 0; i < num; i++) {
+            slabs_[slab + i].cls = SLAB_CLASS_LARGE;
+          }
+          slab += num - 1;
+          continue;
+        }
+        case SLAB_ARENA: {
+          uint32_t record = ARENA_TAG_RECORD(arg);
+          if (record >= PMEM_SLAB_ARENA_NUM ||
+              SLAB_HDR_STATE(records_[record].state) != ARENA_ACTIVE) {
+            break;
+          }
+          auto a = arenas_[records_[record].arena];
+          if (arg != ARENA_TAG(record, a->generation)) {
+            break;
+          }
+          slabs_[slab].cls = SLAB_CLASS_ARENA;
+          a->slabs.push_back(slab);
+          continue;
+        }
+        default: { break; }
+      }
+      /// free, empty or torn slab
+      if (hdr != SLAB_HDR(SLAB_FREE, 0)) {
+        set_slab_hdr(slab, SLAB_HDR(SLAB_FREE, 0));
+      }
+      free_slabs_.insert(slab);
+    }
+    return 0;
+  }
+
+  void close() {
+    if (base_ != nullptr) {
+      pmem_unmap(base_, mapped_len_);
+      base_ = nullptr;
+      hdr_ = nullptr;
+    }
+  }
+
+  static uint64_t align_up(uint64_t value, uint64_t align) {
+    return (value + align - 1) / align * align;
+  }
+
+  void persist(const void *addr, uint64_t len) {
+    if (is_pmem_) {
+      pmem_persist(addr, len);
+    } else {
+      pmem_msync(addr, len);
+    }
+  }
+
+  void copy_persist(char *dest, const char *src, uint64_t len) {
+    if (is_pmem_) {
+      pmem_memcpy_persist(dest, src, len);
+    } else {
+      memcpy(dest, src, len);
+      pmem_msync(dest, len);
+    }
+  }
+
+  /// copy data into the pool as its durability mode requires, without
+  /// pmem the copy is synced by every mode but volatile.
+  void copy_data(char *dest, const char *src, uint64_t len) {
+    if (diskInfo_->durability == DURABILITY_VOLATILE) {
+      memcpy(dest, src, len);
+    } else if (!is_pmem_) {
+      copy_persist(dest, src, len);
+    } else {
+      if (copyEngine_ != nullptr) {
+        copyEngine_->copy(dest, src, len);
+      } else {
+        pmem_memcpy(dest, src, len,
+                    PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+      }
+      if (diskInfo_->durability == DURABILITY_PERSIST) {
+        pmem_drain();
+      }
+    }
+  }
+
+  void memset_persist(void *dest, int c, uint64_t len) {
+    if (is_pmem_) {
+      pmem_memset_persist(dest, c, len);
+    } else {
+      memset(dest, c, len);
+      pmem_msync(dest, len);
+    }
+  }
+
+ private:
+  Log *log_;
+  DiskInfo *diskInfo_;
+  NetworkServer *server_;
+  int wid_;
+  char *base_ = nullptr;
+  size_t mapped_len_ = 0;
+  int is_pmem_ = 0;
+  CopyEngine *copyEngine_ = nullptr;
+  slab_pool_hdr *hdr_ = nullptr;
+  uint64_t *slab_hdrs_ = nullptr;
+  arena_record *records_ = nullptr;
+  vector<uint64_t> class_sizes_;
+  std::unique_ptr<SizeClass[]> classes_;
+  std::unique_ptr<SlabState[]> slabs_;
+  std::unique_ptr<ThreadCache[]> caches_;
+  std::mutex slab_mtx_;
+  std::set<uint32_t> free_slabs_;
+  std::mutex arenas_mtx_;
+  unordered_map<uint64_t, std::shared_ptr<Arena>> arenas_;
+  vector<uint32_t> free_records_;
+  Chunk *base_ck = nullptr;
+};
+
+#endif  // PMPOOL_PMEMSLABALLOCATOR_H_
@@ -11,12 +11,15 @@
 
 #include <assert.h>
 
+#include <set>
+
 #include "AllocatorProxy.h"
 #include "Config.h"
 #include "Digest.h"
 #include "Event.h"
 #include "Log.h"
 #include "NetworkServer.h"
+#include "buffer/BufferPool.h"
 
 RecvCallback::RecvCallback(Protocol *protocol, ChunkMgr *chunkMgr)
     : protocol_(protocol), chunkMgr_(chunkMgr) {}
@@ -25,9 +28,11 @@ void RecvCallback::operator()(void *buffer_id, void *buffer_size) {
   auto buffer_id_ = *static_cast<int *>(buffer_id);
   Chunk *ck = chunkMgr_->get(buffer_id_);
   assert(*static_cast<uint64_t *>(buffer_size) == ck->size);
-  Request *request = new Request(reinterpret_cast<char *>(ck->buffer), ck->size,
-                                 reinterpret_cast<Connection *>(ck->con));
-  request->decode();
+  /// decode into a pooled request, the chunk is reposted right after.
+  Request *request = protocol_->get_request();
+  request->decode(reinterpret_cast<char *>(ck->buffer), ck->size,
+                  reinterpret_cast<Connection *>(ck->con));
+  request->get_rc().stamp = protocol_->stamp();
   protocol_->enqueue_recv_msg(request);
   chunkMgr_->reclaim(ck, static_cast<Connection *>(ck->con));
 }
@@ -44,11 +49,6 @@ SendCallback::SendCallback(ChunkMgr *chunkMgr) : chunkMgr_(chunkMgr) {}
 void SendCallback::operator()(void *buffer_id, void *buffer_size) {
   auto buffer_id_ = *static_cast<int *>(buffer_id);
   auto ck = chunkMgr_->get(buffer_id_);
-
-  /// free the memory of class RequestReply
-  auto reqeustReply = static_cast<RequestReply *>(ck->ptr);
-  delete reqeustReply;
-
   chunkMgr_->reclaim(ck, static_cast<Connection *>(ck->con));
 }
 
@@ -60,7 +60,11 @@ void WriteCallback::operator()(void *buffer_id, void *buffer_size) {
 }
 
 RecvWorker::RecvWorker(Protocol *protocol, int index)
-    : protocol_(protocol), index_(index) {
+    : protocol_(protocol),
+      index_(index),
+      pendingRecvRequestQueue_(
+          to_poll_policy(protocol->config_->get_poll_policy()),
+          protocol->config_->get_poll_spin_num()) {
   init = false;
 }
 
@@ -69,11 +73,11 @@ int RecvWorker::entry() {
     set_affinity(index_);
     init = true;
   }
-  Request *request;
-  bool res = pendingRecvRequestQueue_.wait_dequeue_timed(
-      request, std::chrono::milliseconds(1000));
-  if (res) {
-    protocol_->handle_recv_msg(request);
+  Request *requests[WORKER_DEQUEUE_BULK];
+  size_t num =
+      pendingRecvRequestQueue_.dequeue_bulk(requests, WORKER_DEQUEUE_BULK);
+  for (size_t i = 0; i < num; i++) {
+    protocol_->handle_recv_msg(requests[i]);
   }
   return 0;
 }
@@ -84,8 +88,16 @@ void RecvWorker::addTask(Request *request) {
   pendingRecvRequestQueue_.enqueue(request);
 }
 
+WorkerStats RecvWorker::get_stats() {
+  return pendingRecvRequestQueue_.get_stats();
+}
+
 ReadWorker::ReadWorker(Protocol *protocol, int index)
-    : protocol_(protocol), index_(index) {
+    : protocol_(protocol),
+      index_(index),
+      pendingReadRequestQueue_(
+          to_poll_policy(protocol->config_->get_poll_policy()),
+          protocol->config_->get_poll_spin_num()) {
   init = false;
 }
 
@@ -94,12 +106,13 @@ int ReadWorker::entry() {
     set_affinity(index_);
     init = true;
   }
-  RequestReply *requestReply;
-  bool res = pendingReadRequestQueue_.wait_dequeue_timed(
-      requestReply, std::chrono::milliseconds(1000));
-  if (res) {
-    protocol_->handle_rma_msg(requestReply);
+  RequestReply *requestReplies[WORKER_DEQUEUE_BULK];
+  size_t num = pendingReadRequestQueue_.dequeue_bulk(requestReplies,
+                                                     WORKER_DEQUEUE_BULK);
+  for (size_t i = 0; i < num; i++) {
+    protocol_->handle_rma_msg(requestReplies[i], &uncommitted_);
   }
+  protocol_->commit(&uncommitted_);
   return 0;
 }
 
@@ -109,14 +122,29 @@ void ReadWorker::addTask(RequestReply *rr) {
   pendingReadRequestQueue_.enqueue(rr);
 }
 
-FinalizeWorker::FinalizeWorker(Protocol *protocol) : protocol_(protocol) {}
+WorkerStats ReadWorker::get_stats() {
+  return pendingReadRequestQueue_.get_stats();
+}
+
+FinalizeWorker::FinalizeWorker(Protocol *protocol)
+    : protocol_(protocol),
+      pendingRequestReplyQueue_(
+          to_poll_policy(protocol->config_->get_poll_policy()),
+          protocol->config_->get_poll_spin_num()) {
+  init = false;
+}
 
 int FinalizeWorker::entry() {
-  RequestReply *requestReply;
-  bool res = pendingRequestReplyQueue_.wait_dequeue_timed(
-      requestReply, std::chrono::milliseconds(1000));
-  if (res) {
-    protocol_->handle_finalize_msg(requestReply);
+  if (!init) {
+    /// replies are sent from here, stay close to the NIC.
+    Numa::run_on_node(protocol_->config_->get_nic_node());
+    init = true;
+  }
+  RequestReply *requestReplies[WORKER_DEQUEUE_BULK];
+  size_t num = pendingRequestReplyQueue_.dequeue_bulk(requestReplies,
+                                                      WORKER_DEQUEUE_BULK);
+  for (size_t i = 0; i < num; i++) {
+    protocol_->handle_finalize_msg(requestReplies[i]);
   }
   return 0;
 }
@@ -127,16 +155,92 @@ void FinalizeWorker::addTask(RequestReply *requestReply) {
   pendingRequestReplyQueue_.enqueue(requestReply);
 }
 
+WorkerStats FinalizeWorker::get_stats() {
+  return pendingRequestReplyQueue_.get_stats();
+}
+
+ShardWorker::ShardWorker(Protocol *protocol, int index)
+    : protocol_(protocol),
+      index_(index),
+      pendingTaskQueue_(to_poll_policy(protocol->config_->get_poll_policy()),
+                        protocol->config_->get_poll_spin_num()) {
+  init = false;
+}
+
+int ShardWorker::entry() {
+  if (!init) {
+    set_affinity(index_);
+    init = true;
+  }
+  ShardTask tasks[WORKER_DEQUEUE_BULK];
+  size_t num = pendingTaskQueue_.dequeue_bulk(tasks, WORKER_DEQUEUE_BULK);
+  for (size_t i = 0; i < num; i++) {
+    if (tasks[i].request != nullptr) {
+      protocol_->handle_recv_msg(tasks[i].request);
+    } else {
+      protocol_->handle_rma_msg(tasks[i].requestReply, &uncommitted_);
+    }
+  }
+  protocol_->commit(&uncommitted_);
+  return 0;
+}
+
+void ShardWorker::abort() {}
+
+void ShardWorker::addTask(Request *request) {
+  pendingTaskQueue_.enqueue({request, nullptr});
+}
+
+void ShardWorker::addTask(RequestReply *requestReply) {
+  pendingTaskQueue_.enqueue({nullptr, requestReply});
+}
+
+WorkerStats ShardWorker::get_stats() { return pendingTaskQueue_.get_stats(); }
+
+StatsWorker::StatsWorker(Protocol *protocol, int interval,
+                         int latency_interval)
+    : protocol_(protocol),
+      interval_(interval),
+      latency_interval_(latency_interval),
+      elapsed_(0) {}
+
+int StatsWorker::entry() {
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  elapsed_++;
+  if (interval_ > 0 && elapsed_ % interval_ == 0) {
+    protocol_->report_worker_stats();
+  }
+  if (latency_interval_ > 0 && elapsed_ % latency_interval_ == 0) {
+    protocol_->report_latency_stats();
+  }
+  return 0;
+}
+
+void StatsWorker::abort() {}
+
 Protocol::Protocol(Config *config, Log *log, NetworkServer *server,
                    AllocatorProxy *allocatorProxy)
     : config_(config),
       log_(log),
       networkServer_(server),
-      allocatorProxy_(allocatorProxy) {
+      allocatorProxy_(allocatorProxy),
+      requestPool_([]() { return new Request(RequestContext()); },
+                   REQUEST_POOL_SIZE),
+      requestReplyPool_(
+          []() { return new RequestReply(RequestReplyContext()); },
+          REQUEST_POOL_SIZE) {
   time = 0;
+  runToCompletion_ = config_->is_run_to_completion();
+  zeroCopyWrite_ = config_->is_zero_copy_write();
+  latencyStatsEnabled_ = config_->get_latency_stats();
+  startTime_ = LatencyStats::now();
 }
 
 Protocol::~Protocol() {
+  if (statsWorker_) {
+    statsWorker_->stop();
+    statsWorker_->join();
+  }
   for (auto worker : recvWorkers_) {
     worker->stop();
     worker->join();
@@ -145,8 +249,14 @@ Protocol::~Protocol() {
     worker->stop();
     worker->join();
   }
-  finalizeWorker_->stop();
-  finalizeWorker_->join();
+  for (auto worker : shardWorkers_) {
+    worker->stop();
+    worker->join();
+  }
+  if (finalizeWorker_) {
+    finalizeWorker_->stop();
+    finalizeWorker_->join();
+  }
 }
 
 int Protocol::init() {
@@ -158,18 +268,43 @@ int Protocol::init() {
   writeCallback_ = std::make_shared<WriteCallback>(this);
 
   for (int i = 0; i < config_->get_pool_size(); i++) {
-    auto recvWorker = new RecvWorker(this, config_->get_affinities_()[i] - 1);
-    recvWorker->start();
-    recvWorkers_.push_back(std::shared_ptr<RecvWorker>(recvWorker));
+    log_->get_file_log()->info(
+        "pool " + config_->get_pool_paths()[i] + " on numa node " +
+        std::to_string(config_->get_pool_nodes()[i]) + ", worker cpus " +
+        std::to_string(config_->get_recv_affinities()[i]) + " and " +
+        std::to_string(config_->get_affinities_()[i]));
   }
 
-  finalizeWorker_ = make_shared<FinalizeWorker>(this);
-  finalizeWorker_->start();
+  if (runToCompletion_) {
+    for (int i = 0; i < config_->get_pool_size(); i++) {
+      auto shardWorker = new ShardWorker(this, config_->get_affinities_()[i]);
+      shardWorker->start();
+      shardWorkers_.push_back(std::shared_ptr<ShardWorker>(shardWorker));
+    }
+  } else {
+    for (int i = 0; i < config_->get_pool_size(); i++) {
+      auto recvWorker =
+          new RecvWorker(this, config_->get_recv_affinities()[i]);
+      recvWorker->start();
+      recvWorkers_.push_back(std::shared_ptr<RecvWorker>(recvWorker));
+    }
+
+    finalizeWorker_ = make_shared<FinalizeWorker>(this);
+    finalizeWorker_->start();
 
-  for (int i = 0; i < config_->get_pool_size(); i++) {
-    auto readWorker = new ReadWorker(this, config_->get_affinities_()[i]);
-    readWorker->start();
-    readWorkers_.push_back(std::shared_ptr<ReadWorker>(readWorker));
+    for (int i = 0; i < config_->get_pool_size(); i++) {
+      auto readWorker = new ReadWorker(this, config_->get_affinities_()[i]);
+      readWorker->start();
+      readWorkers_.push_back(std::shared_ptr<ReadWorker>(readWorker));
+    }
+  }
+
+  if (config_->get_worker_stats_interval() > 0 ||
+      (latencyStatsEnabled_ && config_->get_latency_stats_interval() > 0)) {
+    statsWorker_ = make_shared<StatsWorker>(
+        this, config_->get_worker_stats_interval(),
+        latencyStatsEnabled_ ? config_->get_latency_stats_interval() : 0);
+    statsWorker_->start();
   }
 
   networkServer_->set_recv_callback(recvCallback_.get());
@@ -180,32 +315,49 @@ int Protocol::init() {
 }
 
 void Protocol::enqueue_recv_msg(Request *request) {
-  RequestContext rc = request->get_rc();
-  if (rc.address != 0) {
-    auto wid = GET_WID(rc.address);
-    recvWorkers_[wid]->addTask(request);
+  RequestContext &rc = request->get_rc();
+  uint64_t wid = rc.address != 0 ? GET_WID(rc.address)
+                                 : rc.rid % config_->get_pool_size();
+  if (runToCompletion_) {
+    shardWorkers_[wid]->addTask(request);
   } else {
-    recvWorkers_[rc.rid % config_->get_pool_size()]->addTask(request);
+    recvWorkers_[wid]->addTask(request);
   }
 }
 
 void Protocol::handle_recv_msg(Request *request) {
-  RequestContext rc = request->get_rc();
-  RequestReplyContext rrc;
+  RequestContext &rc = request->get_rc();
+  RequestReply *requestReply = get_request_reply();
+  RequestReplyContext &rrc = requestReply->get_rrc();
+  rrc.batch_parent = rc.batch_parent;
+  rrc.batch_index = rc.batch_index;
+  uint64_t now = record_latency(rc.type, STAGE_RECV_QUEUE, rc.stamp);
+  if (rc.type < STATS_OP_NUM) {
+    opCounts_[rc.type].fetch_add(1, std::memory_order_relaxed);
+  }
   switch (rc.type) {
     case ALLOC: {
-      uint64_t addr = allocatorProxy_->allocate_and_write(
-          rc.size, nullptr, rc.rid % config_->get_pool_size());
-      auto wid = GET_WID(addr);
-      assert(wid == rc.rid % config_->get_pool_size());
+      uint64_t addr =
+          rc.key == NO_ARENA
+              ? allocatorProxy_->allocate_and_write(
+                    rc.size, nullptr, rc.rid % config_->get_pool_size())
+              : allocatorProxy_->allocate_in_arena(
+                    rc.key, rc.size, nullptr,
+                    rc.rid % config_->get_pool_size());
+      record_latency(rc.type, STAGE_ALLOCATE, now);
       rrc.type = ALLOC_REPLY;
-      rrc.success = 0;
+      /// a full pool or arena fails the allocation with address -1.
+      if (addr == (uint64_t)-1) {
+        rrc.success = -1;
+      } else {
+        assert(GET_WID(addr) == rc.rid % config_->get_pool_size());
+        rrc.success = 0;
+      }
       rrc.rid = rc.rid;
       rrc.address = addr;
       rrc.size = rc.size;
+      rrc.key = rc.key;
       rrc.con = rc.con;
-      RequestReply *requestReply = new RequestReply(rrc);
-      rrc.ck->ptr = requestReply;
       enqueue_finalize_msg(requestReply);
       break;
     }
@@ -216,8 +368,6 @@ void Protocol::handle_recv_msg(Request *request) {
       rrc.address = rc.address;
       rrc.size = rc.size;
       rrc.con = rc.con;
-      RequestReply *requestReply = new RequestReply(rrc);
-      rrc.ck->ptr = requestReply;
       enqueue_finalize_msg(requestReply);
       break;
     }
@@ -229,14 +379,21 @@ void Protocol::handle_recv_msg(Request *request) {
       rrc.src_address = rc.src_address;
       rrc.src_rkey = rc.src_rkey;
       rrc.size = rc.size;
+      rrc.key = rc.key;
       rrc.con = rc.con;
-      networkServer_->get_dram_buffer(&rrc);
-      RequestReply *requestReply = new RequestReply(rrc);
+      /// in rtc mode only this shard puts its buffers back, waiting for one
+      /// would wait forever.
+      int res = zeroCopyWrite_
+                    ? get_pmem_target(&rrc)
+                    : networkServer_->get_dram_buffer(&rrc, !runToCompletion_);
+      rrc.stamp = record_latency(rc.type, STAGE_ALLOCATE, now);
+      if (res != 0) {
+        rrc.success = -1;
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
       rrc.ck->ptr = requestReply;
 
-      std::unique_lock<std::mutex> lk(rrcMtx_);
-      rrcMap_[rrc.ck->buffer_id] = requestReply;
-      lk.unlock();
       networkServer_->read(requestReply);
       break;
     }
@@ -249,16 +406,19 @@ void Protocol::handle_recv_msg(Request *request) {
       rrc.src_rkey = rc.src_rkey;
       rrc.size = rc.size;
       rrc.con = rc.con;
-      rrc.dest_address = allocatorProxy_->get_virtual_address(rrc.address);
+      rrc.dest_address =
+          allocatorProxy_->get_virtual_address(rrc.address, rrc.size);
       rrc.ck = nullptr;
-      Chunk *base_ck = allocatorProxy_->get_rma_chunk(rrc.address);
-      networkServer_->get_pmem_buffer(&rrc, base_ck);
-      RequestReply *requestReply = new RequestReply(rrc);
+      if (rrc.dest_address == (uint64_t)-1 ||
+          networkServer_->get_pmem_buffer(
+              &rrc, allocatorProxy_->get_rma_chunk(rrc.address))) {
+        rrc.success = -1;
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
       rrc.ck->ptr = requestReply;
+      rrc.stamp = stamp();
 
-      std::unique_lock<std::mutex> lk(rrcMtx_);
-      rrcMap_[rrc.ck->buffer_id] = requestReply;
-      lk.unlock();
       networkServer_->write(requestReply);
       break;
     }
@@ -272,13 +432,26 @@ void Protocol::handle_recv_msg(Request *request) {
       rrc.size = rc.size;
       rrc.key = rc.key;
       rrc.con = rc.con;
-      networkServer_->get_dram_buffer(&rrc);
-      RequestReply *requestReply = new RequestReply(rrc);
+      /// a block the client already wrote is only recorded under the key.
+      if (rc.address != 0 && rc.src_address == 0) {
+        if (allocatorProxy_->get_virtual_address(rc.address, rc.size) ==
+            (uint64_t)-1) {
+          rrc.success = -1;
+        }
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
+      int res = zeroCopyWrite_
+                    ? get_pmem_target(&rrc)
+                    : networkServer_->get_dram_buffer(&rrc, !runToCompletion_);
+      rrc.stamp = record_latency(rc.type, STAGE_ALLOCATE, now);
+      if (res != 0) {
+        rrc.success = -1;
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
       rrc.ck->ptr = requestReply;
 
-      std::unique_lock<std::mutex> lk(rrcMtx_);
-      rrcMap_[rrc.ck->buffer_id] = requestReply;
-      lk.unlock();
       networkServer_->read(requestReply);
       break;
     }
@@ -289,9 +462,75 @@ void Protocol::handle_recv_msg(Request *request) {
       rrc.size = rc.size;
       rrc.key = rc.key;
       rrc.con = rc.con;
-      RequestReply *requestReply = new RequestReply(rrc);
-      rrc.ck->ptr = requestReply;
       enqueue_finalize_msg(requestReply);
+      break;
+    }
+    case GET: {
+      rrc.type = GET_REPLY;
+      rrc.success = 0;
+      rrc.rid = rc.rid;
+      rrc.key = rc.key;
+      rrc.src_address = rc.src_address;
+      rrc.src_rkey = rc.src_rkey;
+      rrc.con = rc.con;
+      rrc.meta = allocatorProxy_->get_cached_chunk(rc.key);
+      rrc.size = 0;
+      /// a missing key is an error, not an empty value.
+      if (rrc.meta == nullptr) {
+        rrc.success = -1;
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
+      const vector<block_meta> &bml = *rrc.meta;
+      for (auto &bm : bml) {
+        rrc.size += bm.size;
+      }
+      /// client buffer is too small, reply the required size.
+      if (rrc.size > rc.size) {
+        rrc.success = -1;
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
+      for (auto &bm : bml) {
+        RequestReplyContext block_rrc = {};
+        block_rrc.size = bm.size;
+        block_rrc.dest_address =
+            allocatorProxy_->get_virtual_address(bm.address, bm.size);
+        if (block_rrc.dest_address == (uint64_t)-1) {
+          rrc.success = -1;
+          break;
+        }
+        Chunk *base_ck = allocatorProxy_->get_rma_chunk(bm.address);
+        if (networkServer_->get_pmem_buffer(&block_rrc, base_ck)) {
+          rrc.success = -1;
+          break;
+        }
+        rrc.cks.push_back(block_rrc.ck);
+      }
+      if (rrc.success || rrc.cks.empty()) {
+        for (auto ck : rrc.cks) {
+          rrc.ck = ck;
+          networkServer_->reclaim_pmem_buffer(&rrc);
+        }
+        rrc.cks.clear();
+        rrc.ck = nullptr;
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
+      /// write every block to the client buffer, reply once all of the RDMA
+      /// writes completed.
+      requestReply->pending_ = rrc.cks.size();
+      for (auto ck : rrc.cks) {
+        ck->ptr = requestReply;
+      }
+      rrc.stamp = stamp();
+      uint64_t offset = 0;
+      for (uint64_t i = 0; i < rrc.cks.size(); i++) {
+        networkServer_->write(rrc.cks[i], bml[i].size,
+                              rrc.src_address + offset, rrc.src_rkey, rrc.con);
+        offset += bml[i].size;
+      }
+      break;
     }
     case DELETE: {
       rrc.type = DELETE_REPLY;
@@ -299,80 +538,401 @@ void Protocol::handle_recv_msg(Request *request) {
       rrc.con = rc.con;
       rrc.rid = rc.rid;
       rrc.success = 0;
+      enqueue_finalize_msg(requestReply);
+      break;
+    }
+    case FREE_ARENA: {
+      rrc.type = FREE_ARENA_REPLY;
+      rrc.success = allocatorProxy_->release_arena(rc.key);
+      rrc.rid = rc.rid;
+      rrc.key = rc.key;
+      rrc.con = rc.con;
+      enqueue_finalize_msg(requestReply);
+      break;
+    }
+    case STATS: {
+      rrc.type = STATS_REPLY;
+      rrc.success = 0;
+      rrc.rid = rc.rid;
+      rrc.size = config_->get_pool_size();
+      rrc.con = rc.con;
+      get_stats(&rrc.stats);
+      enqueue_finalize_msg(requestReply);
+      break;
+    }
+    case BATCH: {
+      rrc.type = BATCH_REPLY;
+      rrc.success = 0;
+      rrc.rid = rc.rid;
+      rrc.con = rc.con;
+      rrc.batch.resize(rc.batch.size());
+      if (rc.batch.empty()) {
+        enqueue_finalize_msg(requestReply);
+        break;
+      }
+      requestReply->pending_ = rc.batch.size();
+      /// fan sub-requests out to the workers that own their allocators.
+      for (uint64_t i = 0; i < rc.batch.size(); i++) {
+        RequestMsg &msg = rc.batch[i];
+        if (msg.type != ALLOC && msg.type != FREE && msg.type != WRITE &&
+            msg.type != READ) {
+          rrc.batch[i].type = msg.type | REPLY;
+          rrc.batch[i].success = -1;
+          rrc.batch[i].rid = msg.rid;
+          if (--requestReply->pending_ == 0) {
+            finalize_batch_msg(requestReply);
+          }
+          continue;
+        }
+        Request *sub_request = get_request();
+        RequestContext &sub_rc = sub_request->get_rc();
+        sub_rc.type = (OpType)msg.type;
+        sub_rc.rid = msg.rid;
+        sub_rc.address = msg.address;
+        sub_rc.src_address = msg.src_address;
+        sub_rc.src_rkey = msg.src_rkey;
+        sub_rc.size = msg.size;
+        sub_rc.key = msg.key;
+        sub_rc.con = rc.con;
+        sub_rc.batch_parent = requestReply;
+        sub_rc.batch_index = i;
+        sub_rc.stamp = stamp();
+        enqueue_recv_msg(sub_request);
+      }
+      break;
+    }
+    default: {
+      put_request_reply(requestReply);
+      break;
     }
-    default: { break; }
   }
 
-  delete request;
+  put_request(request);
+}
+
+Request *Protocol::get_request() {
+  Request *request = requestPool_.get();
+  request->reset();
+  return request;
+}
+
+void Protocol::put_request(Request *request) { requestPool_.put(request); }
+
+RequestReply *Protocol::get_request_reply() {
+  RequestReply *requestReply = requestReplyPool_.get();
+  requestReply->reset();
+  return requestReply;
+}
+
+void Protocol::put_request_reply(RequestReply *requestReply) {
+  requestReplyPool_.put(requestReply);
+}
+
+void Protocol::complete_batch_msg(RequestReply *requestReply) {
+  RequestReplyContext &rrc = requestReply->get_rrc();
+  RequestReply *parent = rrc.batch_parent;
+  RequestReplyMsg &msg = parent->get_rrc().batch[rrc.batch_index];
+  msg.type = rrc.type;
+  msg.success = rrc.success;
+  msg.rid = rrc.rid;
+  msg.address = rrc.address;
+  msg.size = rrc.size;
+  msg.key = rrc.key;
+  put_request_reply(requestReply);
+  if (--parent->pending_ == 0) {
+    finalize_batch_msg(parent);
+  }
+}
+
+void Protocol::finalize_batch_msg(RequestReply *requestReply) {
+  RequestReplyContext &rrc = requestReply->get_rrc();
+  for (auto &sub : rrc.batch) {
+    if (sub.success) {
+      rrc.success++;
+    }
+  }
+  finalize(requestReply);
 }
 
 void Protocol::enqueue_finalize_msg(RequestReply *requestReply) {
-  finalizeWorker_->addTask(requestReply);
+  if (requestReply->get_rrc().batch_parent != nullptr) {
+    complete_batch_msg(requestReply);
+    return;
+  }
+  finalize(requestReply);
+}
+
+void Protocol::report_worker_stats() {
+  auto report = [this](const string &name, WorkerStats stats) {
+    log_->get_file_log()->info(
+        name + ": wakeups " + std::to_string(stats.wakeups) +
+        ", empty polls " + std::to_string(stats.spins) + ", batches " +
+        std::to_string(stats.batches) + ", average batch " +
+        std::to_string(stats.batches ? stats.tasks / (double)stats.batches
+                                     : 0.0) +
+        ", depth " + std::to_string(stats.depth));
+  };
+  for (uint64_t i = 0; i < recvWorkers_.size(); i++) {
+    report("recv worker " + std::to_string(i), recvWorkers_[i]->get_stats());
+  }
+  for (uint64_t i = 0; i < readWorkers_.size(); i++) {
+    report("read worker " + std::to_string(i), readWorkers_[i]->get_stats());
+  }
+  for (uint64_t i = 0; i < shardWorkers_.size(); i++) {
+    report("shard worker " + std::to_string(i), shardWorkers_[i]->get_stats());
+  }
+  if (finalizeWorker_) {
+    report("finalize worker", finalizeWorker_->get_stats());
+  }
+}
+
+uint64_t Protocol::stamp() {
+  return latencyStatsEnabled_ ? LatencyStats::now() : 0;
+}
+
+uint64_t Protocol::record_latency(uint32_t type, LatencyStage stage,
+                                  uint64_t since) {
+  if (!latencyStatsEnabled_) {
+    return 0;
+  }
+  uint64_t now = LatencyStats::now();
+  if (since != 0) {
+    latencyStats_.record(type & (REPLY - 1), stage, now - since);
+  }
+  return now;
+}
+
+void Protocol::report_latency_stats() {
+  static const char *op_names[] = {
+      "",    "alloc", "free",     "prepare", "write", "read",
+      "put", "get",   "get_meta", "delete",  "batch", "free_arena",
+      "stats"};
+  for (uint32_t op = ALLOC; op <= STATS; op++) {
+    for (int stage = 0; stage < STAGE_NUM; stage++) {
+      Histogram &histogram = latencyStats_.get(op, (LatencyStage)stage);
+      if (histogram.get_count() == 0) {
+        continue;
+      }
+      log_->get_file_log()->info(string(op_names[op]) + " " +
+                                 LatencyStats::stage_name(stage) + ": " +
+                                 LatencyStats::format(&histogram));
+    }
+  }
+  latencyStats_.reset();
+}
+
+LatencyStats *Protocol::get_latency_stats() { return &latencyStats_; }
+
+void Protocol::get_stats(vector<uint64_t> *words) {
+  server_stats server = {};
+  server.uptime = LatencyStats::now() - startTime_;
+  if (finalizeWorker_) {
+    server.finalize_queue_depth = finalizeWorker_->get_stats().depth;
+  }
+  BufferPoolStats buffer = networkServer_->get_buffer_stats();
+  server.buffer_mapped = buffer.mapped_bytes;
+  server.buffer_used = buffer.used_bytes;
+  server.buffer_waits = buffer.waits;
+  for (int op = 0; op < STATS_OP_NUM; op++) {
+    server.ops[op].ops = opCounts_[op].load(std::memory_order_relaxed);
+    server.ops[op].bytes = opBytes_[op].load(std::memory_order_relaxed);
+  }
+  int pool_num = config_->get_pool_size();
+  words->resize((sizeof(server_stats) + pool_num * sizeof(pool_stats)) /
+                sizeof(uint64_t));
+  char *data = reinterpret_cast<char *>(words->data());
+  memcpy(data, &server, sizeof(server_stats));
+  data += sizeof(server_stats);
+  for (int i = 0; i < pool_num; i++) {
+    pool_stats pool = {};
+    allocatorProxy_->get_stats(i, &pool);
+    if (runToCompletion_) {
+      pool.queue_depth = shardWorkers_[i]->get_stats().depth;
+    } else {
+      pool.queue_depth = recvWorkers_[i]->get_stats().depth +
+                         readWorkers_[i]->get_stats().depth;
+    }
+    memcpy(data, &pool, sizeof(pool_stats));
+    data += sizeof(pool_stats);
+  }
+}
+
+void Protocol::finalize(RequestReply *requestReply) {
+  requestReply->get_rrc().stamp = stamp();
+  if (runToCompletion_) {
+    handle_finalize_msg(requestReply);
+  } else {
+    finalizeWorker_->addTask(requestReply);
+  }
 }
 
 void Protocol::handle_finalize_msg(RequestReply *requestReply) {
-  RequestReplyContext rrc = requestReply->get_rrc();
-  if (rrc.type == PUT_REPLY) {
-    allocatorProxy_->cache_chunk(rrc.key, rrc.address, rrc.size);
+  RequestReplyContext &rrc = requestReply->get_rrc();
+  record_latency(rrc.type, STAGE_FINALIZE_QUEUE, rrc.stamp);
+  if (rrc.type == PUT_REPLY && rrc.success == 0) {
+    if (allocatorProxy_->cache_chunk(rrc.key, rrc.address, rrc.size)) {
+      rrc.success = -1;
+    }
   } else if (rrc.type == GET_META_REPLY) {
-    auto bml = allocatorProxy_->get_cached_chunk(rrc.key);
-    requestReply->requestReplyContext_.bml = bml;
+    rrc.meta = allocatorProxy_->get_cached_chunk(rrc.key);
   } else if (rrc.type == DELETE_REPLY) {
-    auto bml = allocatorProxy_->get_cached_chunk(rrc.key);
-    for (auto bm : bml) {
-      rrc.success = allocatorProxy_->release(bm.address);
-      if (rrc.success) {
-        break;
+    /// the key is dropped from the persistent metadata before its blocks are
+    /// released.
+    auto bml = allocatorProxy_->del_chunk(rrc.key);
+    if (bml != nullptr) {
+      for (auto &bm : *bml) {
+        if (allocatorProxy_->release(bm.address)) {
+          rrc.success = -1;
+        }
       }
     }
-    allocatorProxy_->del_chunk(rrc.key);
   } else {
   }
-  requestReply->encode();
-  networkServer_->send(reinterpret_cast<char *>(requestReply->data_),
-                       requestReply->size_, rrc.con);
+  OpType type = rrc.type;
+  uint64_t start = stamp();
+  networkServer_->send(requestReply);
+  put_request_reply(requestReply);
+  record_latency(type, STAGE_SEND, start);
 }
 
 void Protocol::enqueue_rma_msg(uint64_t buffer_id) {
-  std::unique_lock<std::mutex> lk(rrcMtx_);
-  RequestReply *requestReply = rrcMap_[buffer_id];
-  lk.unlock();
-  RequestReplyContext rrc = requestReply->get_rrc();
-  if (rrc.address != 0) {
-    auto wid = GET_WID(rrc.address);
-    readWorkers_[wid]->addTask(requestReply);
+  Chunk *ck = networkServer_->get_rma_chunk(buffer_id);
+  RequestReply *requestReply = static_cast<RequestReply *>(ck->ptr);
+  RequestReplyContext &rrc = requestReply->get_rrc();
+  uint64_t wid = rrc.address != 0 ? GET_WID(rrc.address)
+                                  : rrc.rid % config_->get_pool_size();
+  if (runToCompletion_) {
+    shardWorkers_[wid]->addTask(requestReply);
   } else {
-    readWorkers_[rrc.rid % config_->get_pool_size()]->addTask(requestReply);
+    readWorkers_[wid]->addTask(requestReply);
   }
 }
 
-void Protocol::handle_rma_msg(RequestReply *requestReply) {
+void Protocol::handle_rma_msg(RequestReply *requestReply,
+                              std::vector<RequestReply *> *uncommitted) {
   RequestReplyContext &rrc = requestReply->get_rrc();
+  /// a GET reply is handled once the RDMA writes of all its blocks completed.
+  if (rrc.type == GET_REPLY && --requestReply->pending_ != 0) {
+    return;
+  }
+  uint64_t now = record_latency(rrc.type, STAGE_RDMA, rrc.stamp);
   switch (rrc.type) {
     case WRITE_REPLY: {
+      if (zeroCopyWrite_) {
+        /// the data landed in PMem, only make it durable.
+        allocatorProxy_->flush(rrc.address, rrc.size);
+        networkServer_->reclaim_pmem_buffer(&rrc);
+        break;
+      }
       char *buffer = static_cast<char *>(rrc.ck->buffer);
-      if (rrc.address == 0) {
+      if (rrc.address == 0 && rrc.key != NO_ARENA) {
+        rrc.address = allocatorProxy_->allocate_in_arena(
+            rrc.key, rrc.size, buffer, rrc.rid % config_->get_pool_size());
+      } else if (rrc.address == 0) {
         rrc.address = allocatorProxy_->allocate_and_write(
             rrc.size, buffer, rrc.rid % config_->get_pool_size());
-      } else {
-        allocatorProxy_->write(rrc.address, buffer, rrc.size);
+      } else if (allocatorProxy_->write(rrc.address, buffer, rrc.size)) {
+        rrc.success = -1;
+      }
+      if (rrc.address == (uint64_t)-1) {
+        rrc.success = -1;
       }
       networkServer_->reclaim_dram_buffer(&rrc);
       break;
     }
-    case READ_REPLY: {
-      networkServer_->reclaim_pmem_buffer(&rrc);
-      break;
-    }
     case PUT_REPLY: {
+      if (zeroCopyWrite_) {
+        allocatorProxy_->flush(rrc.address, rrc.size);
+        networkServer_->reclaim_pmem_buffer(&rrc);
+        break;
+      }
       char *buffer = static_cast<char *>(rrc.ck->buffer);
       assert(rrc.address == 0);
       rrc.address = allocatorProxy_->allocate_and_write(
           rrc.size, buffer, rrc.rid % config_->get_pool_size());
+      if (rrc.address == (uint64_t)-1) {
+        rrc.success = -1;
+      }
       networkServer_->reclaim_dram_buffer(&rrc);
       break;
     }
+    case READ_REPLY: {
+      networkServer_->reclaim_pmem_buffer(&rrc);
+      break;
+    }
+    case GET_REPLY: {
+      for (auto ck : rrc.cks) {
+        rrc.ck = ck;
+        networkServer_->reclaim_pmem_buffer(&rrc);
+      }
+      rrc.cks.clear();
+      rrc.ck = nullptr;
+      break;
+    }
     default: { break; }
   }
+  if (rrc.type == WRITE_REPLY || rrc.type == PUT_REPLY) {
+    record_latency(rrc.type, STAGE_COPY, now);
+  }
+  opBytes_[rrc.type & (REPLY - 1)].fetch_add(rrc.size,
+                                             std::memory_order_relaxed);
+  if ((rrc.type == WRITE_REPLY || rrc.type == PUT_REPLY) &&
+      allocatorProxy_->get_durability(rrc.address) ==
+          DURABILITY_GROUP_COMMIT) {
+    uncommitted->push_back(requestReply);
+    return;
+  }
   enqueue_finalize_msg(requestReply);
 }
+
+void Protocol::commit(std::vector<RequestReply *> *uncommitted) {
+  if (uncommitted->empty()) {
+    return;
+  }
+  std::set<uint32_t> wids;
+  for (auto requestReply : *uncommitted) {
+    wids.insert(GET_WID(requestReply->get_rrc().address));
+  }
+  for (auto wid : wids) {
+    allocatorProxy_->drain(wid);
+  }
+  for (auto requestReply : *uncommitted) {
+    enqueue_finalize_msg(requestReply);
+  }
+  uncommitted->clear();
+}
+
+int Protocol::get_pmem_target(RequestReplyContext *rrc) {
+  bool allocated = rrc->address == 0;
+  if (allocated) {
+    int index = rrc->rid % config_->get_pool_size();
+    if (rrc->type == WRITE_REPLY && rrc->key != NO_ARENA) {
+      rrc->address = allocatorProxy_->allocate_in_arena(rrc->key, rrc->size,
+                                                        nullptr, index);
+    } else {
+      rrc->address =
+          allocatorProxy_->allocate_and_write(rrc->size, nullptr, index);
+    }
+    if (rrc->address == (uint64_t)-1) {
+      rrc->address = 0;
+      return -1;
+    }
+  }
+  /// the RDMA must not run past the block, whatever size the client sent.
+  rrc->dest_address =
+      allocatorProxy_->get_virtual_address(rrc->address, rrc->size);
+  if (rrc->dest_address == (uint64_t)-1) {
+    return -1;
+  }
+  Chunk *base_ck = allocatorProxy_->get_rma_chunk(rrc->address);
+  if (networkServer_->get_pmem_buffer(rrc, base_ck)) {
+    /// a block allocated here is not known to the client, arena blocks are
+    /// released with their arena.
+    if (allocated && (rrc->type != WRITE_REPLY || rrc->key == NO_ARENA)) {
+      allocatorProxy_->release(rrc->address);
+      rrc->address = 0;
+    }
+    return -1;
+  }
+  return 0;
+}
@@ -14,6 +14,7 @@
 #include <HPNL/ChunkMgr.h>
 #include <HPNL/Connection.h>
 
+#include <atomic>
 #include <cassert>
 #include <chrono>  // NOLINT
 #include <cstring>
@@ -23,7 +24,10 @@
 #include <vector>
 
 #include "Event.h"
+#include "Histogram.h"
+#include "ObjectPool.h"
 #include "ThreadWrapper.h"
+#include "WorkerQueue.h"
 #include "queue/blockingconcurrentqueue.h"
 #include "queue/concurrentqueue.h"
 
@@ -37,6 +41,9 @@ class Log;
 using moodycamel::BlockingConcurrentQueue;
 using std::make_shared;
 
+/// number of requests and replies allocated up front by each pool.
+#define REQUEST_POOL_SIZE 1024
+
 struct MessageHeader {
   MessageHeader(uint8_t msg_type, uint64_t sequence_id) {
     msg_type_ = msg_type;
@@ -100,12 +107,13 @@ class RecvWorker : public ThreadWrapper {
   int entry() override;
   void abort() override;
   void addTask(Request *request);
+  WorkerStats get_stats();
 
  private:
   Protocol *protocol_;
   int index_;
   bool init;
-  BlockingConcurrentQueue<Request *> pendingRecvRequestQueue_;
+  WorkerQueue<Request *> pendingRecvRequestQueue_;
 };
 
 class ReadWorker : public ThreadWrapper {
@@ -116,12 +124,14 @@ class ReadWorker : public ThreadWrapper {
   int entry() override;
   void abort() override;
   void addTask(RequestReply *requestReply);
+  WorkerStats get_stats();
 
  private:
   Protocol *protocol_;
   int index_;
   bool init;
-  BlockingConcurrentQueue<RequestReply *> pendingReadRequestQueue_;
+  WorkerQueue<RequestReply *> pendingReadRequestQueue_;
+  std::vector<RequestReply *> uncommitted_;
 };
 
 class FinalizeWorker : public ThreadWrapper {
@@ -132,10 +142,62 @@ class FinalizeWorker : public ThreadWrapper {
   int entry() override;
   void abort() override;
   void addTask(RequestReply *requestReply);
+  WorkerStats get_stats();
+
+ private:
+  Protocol *protocol_;
+  bool init;
+  WorkerQueue<RequestReply *> pendingRequestReplyQueue_;
+};
+
+/// one stage of a request, either a received request or a completed RDMA
+/// operation of a reply.
+struct ShardTask {
+  Request *request;
+  RequestReply *requestReply;
+};
+
+/**
+ * @brief ShardWorker handles every stage of the requests of one allocator in
+ * run-to-completion mode, from decoded request to sent reply, so a request
+ * is not handed between threads on the server side.
+ */
+class ShardWorker : public ThreadWrapper {
+ public:
+  ShardWorker() = delete;
+  ShardWorker(Protocol *protocol, int index);
+  ~ShardWorker() override = default;
+  int entry() override;
+  void abort() override;
+  void addTask(Request *request);
+  void addTask(RequestReply *requestReply);
+  WorkerStats get_stats();
 
  private:
   Protocol *protocol_;
-  BlockingConcurrentQueue<RequestReply *> pendingRequestReplyQueue_;
+  int index_;
+  bool init;
+  WorkerQueue<ShardTask> pendingTaskQueue_;
+  std::vector<RequestReply *> uncommitted_;
+};
+
+/**
+ * @brief StatsWorker periodically logs the statistics of the Protocol
+ * workers and the latency histograms, an interval of 0 disables either.
+ */
+class StatsWorker : public ThreadWrapper {
+ public:
+  StatsWorker() = delete;
+  StatsWorker(Protocol *protocol, int interval, int latency_interval);
+  ~StatsWorker() override = default;
+  int entry() override;
+  void abort() override;
+
+ private:
+  Protocol *protocol_;
+  int interval_;
+  int latency_interval_;
+  uint64_t elapsed_;
 };
 
 /**
@@ -145,6 +207,12 @@ class FinalizeWorker : public ThreadWrapper {
  * recv queue-> to handle receive event.
  * finalize queue-> to handle finalization event.
  * rma queue-> to handle remote memory access event.
+ * A BATCH request is fanned out as sub-requests to the recv queues of the
+ * allocators they target, and answered with a single reply.
+ * Requests and replies are taken from object pools and returned once the
+ * reply was sent, so the request path does not touch the heap.
+ * In run-to-completion mode the three queues are replaced by one ShardWorker
+ * per allocator, which also finalizes and sends the reply itself.
  */
 class Protocol {
  public:
@@ -162,9 +230,50 @@ class Protocol {
 
   void enqueue_finalize_msg(RequestReply *requestReply);
   void handle_finalize_msg(RequestReply *requestReply);
+  /// finalize on the finalize worker, or inline in run-to-completion mode.
+  void finalize(RequestReply *requestReply);
+
+  /// log the wakeups, empty polls and batch sizes of every worker.
+  void report_worker_stats();
+
+  /// now in ns if latency stats are recorded, 0 otherwise.
+  uint64_t stamp();
+  /// record the stage of the request type as ended now, return now.
+  uint64_t record_latency(uint32_t type, LatencyStage stage, uint64_t since);
+  /// log the latency histograms of every request type, then reset them, so
+  /// that each log covers one interval.
+  void report_latency_stats();
+  LatencyStats *get_latency_stats();
+
+  /// encode the server_stats and the pool_stats of every pool into words,
+  /// for a STATS reply.
+  void get_stats(vector<uint64_t> *words);
 
   void enqueue_rma_msg(uint64_t buffer_id);
-  void handle_rma_msg(RequestReply *requestReply);
+  /// writes to a pool in group commit mode are not finalized here but left
+  /// in uncommitted for commit.
+  void handle_rma_msg(RequestReply *requestReply,
+                      std::vector<RequestReply *> *uncommitted);
+  /// drain the pools written by the uncommitted replies once, then finalize
+  /// them. Called by a worker after each batch of completions.
+  void commit(std::vector<RequestReply *> *uncommitted);
+
+  /// target the RDMA read of a WRITE or PUT at its PMem block, allocating
+  /// the block first if the request has no address.
+  /// return -1 if the block can't be allocated or found.
+  int get_pmem_target(RequestReplyContext *rrc);
+
+  /// record the reply of one sub-request of a BATCH request,
+  /// the BATCH reply is finalized once all sub-requests completed.
+  void complete_batch_msg(RequestReply *requestReply);
+  /// finalize a BATCH reply whose sub-requests all completed, its success is
+  /// the number of failed sub-requests.
+  void finalize_batch_msg(RequestReply *requestReply);
+
+  Request *get_request();
+  void put_request(Request *request);
+  RequestReply *get_request_reply();
+  void put_request_reply(RequestReply *requestReply);
 
  public:
   Config *config_;
@@ -179,15 +288,26 @@ class Protocol {
   std::shared_ptr<ReadCallback> readCallback_;
   std::shared_ptr<WriteCallback> writeCallback_;
 
+  ObjectPool<Request> requestPool_;
+  ObjectPool<RequestReply> requestReplyPool_;
+
   BlockingConcurrentQueue<Chunk *> recvMsgQueue_;
   BlockingConcurrentQueue<Chunk *> readMsgQueue_;
 
   std::vector<std::shared_ptr<RecvWorker>> recvWorkers_;
   std::shared_ptr<FinalizeWorker> finalizeWorker_;
   std::vector<std::shared_ptr<ReadWorker>> readWorkers_;
+  std::vector<std::shared_ptr<ShardWorker>> shardWorkers_;
+  std::shared_ptr<StatsWorker> statsWorker_;
+  bool runToCompletion_;
+  bool zeroCopyWrite_;
+  bool latencyStatsEnabled_;
+  LatencyStats latencyStats_;
+  /// requests received and bytes transferred per request type.
+  std::atomic<uint64_t> opCounts_[STATS_OP_NUM] = {};
+  std::atomic<uint64_t> opBytes_[STATS_OP_NUM] = {};
+  uint64_t startTime_;
 
-  std::mutex rrcMtx_;
-  std::unordered_map<uint64_t, RequestReply *> rrcMap_;
   uint64_t time;
 };
 
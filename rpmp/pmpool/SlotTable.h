@@ -0,0 +1,81 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/SlotTable.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Monday, March 16th 2020, 10:12:31 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_SLOTTABLE_H_
+#define PMPOOL_SLOTTABLE_H_
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+#include "queue/blockingconcurrentqueue.h"
+
+using moodycamel::BlockingConcurrentQueue;
+
+/**
+ * @brief SlotTable maps small integer ids to objects in flight. Free ids are
+ * kept in a lock-free queue, so insert, get and erase never take a lock.
+ * An id is handed out again only after it was erased. Insert blocks while
+ * all ids are in use, try_insert fails instead.
+ */
+template <class T>
+class SlotTable {
+ public:
+  SlotTable() = delete;
+  SlotTable(const SlotTable &) = delete;
+  explicit SlotTable(uint32_t capacity)
+      : capacity_(capacity), slots_(new std::atomic<T *>[capacity]) {
+    for (uint32_t i = 0; i < capacity_; i++) {
+      slots_[i].store(nullptr, std::memory_order_relaxed);
+      free_ids_.enqueue(i);
+    }
+  }
+
+  /// store t and return the id of its slot.
+  uint32_t insert(T *t) {
+    uint32_t id;
+    free_ids_.wait_dequeue(id);
+    slots_[id].store(t, std::memory_order_release);
+    return id;
+  }
+
+  /// store t and return the id of its slot in id, return false at once if
+  /// all ids are in use.
+  bool try_insert(T *t, uint32_t *id) {
+    if (!free_ids_.try_dequeue(*id)) {
+      return false;
+    }
+    slots_[*id].store(t, std::memory_order_release);
+    return true;
+  }
+
+  T *get(uint32_t id) {
+    assert(id < capacity_);
+    return slots_[id].load(std::memory_order_acquire);
+  }
+
+  /// clear the slot of id and return the object it stored.
+  T *erase(uint32_t id) {
+    assert(id < capacity_);
+    T *t = slots_[id].exchange(nullptr, std::memory_order_acq_rel);
+    free_ids_.enqueue(id);
+    return t;
+  }
+
+  uint32_t capacity() { return capacity_; }
+
+ private:
+  uint32_t capacity_;
+  std::unique_ptr<std::atomic<T *>[]> slots_;
+  BlockingConcurrentQueue<uint32_t> free_ids_;
+};
+
+#endif  // PMPOOL_SLOTTABLE_H_
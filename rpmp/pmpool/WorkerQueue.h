@@ -0,0 +1,135 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/WorkerQueue.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool
+ * Created Date: Wednesday, March 25th 2020, 3:27:09 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_WORKERQUEUE_H_
+#define PMPOOL_WORKERQUEUE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <string>
+
+#include "queue/blockingconcurrentqueue.h"
+
+using moodycamel::BlockingConcurrentQueue;
+
+/// maximum number of tasks a worker takes per dequeue.
+#define WORKER_DEQUEUE_BULK 32
+/// a parked worker wakes up at least this often to check for stop.
+#define WORKER_PARK_TIMEOUT_MS 1000
+
+/// how an idle worker waits for tasks.
+enum PollPolicy {
+  /// never sleep, lowest latency at the cost of a full core per worker.
+  POLL_BUSY,
+  /// poll for a while, then sleep until a task arrives.
+  POLL_SPIN_PARK,
+  /// always sleep until a task arrives.
+  POLL_BLOCK
+};
+
+inline PollPolicy to_poll_policy(const std::string &name) {
+  if (name == "busy") {
+    return POLL_BUSY;
+  }
+  if (name == "block") {
+    return POLL_BLOCK;
+  }
+  return POLL_SPIN_PARK;
+}
+
+struct WorkerStats {
+  /// number of times the worker slept and was woken up again.
+  uint64_t wakeups;
+  /// number of empty polls.
+  uint64_t spins;
+  /// number of non-empty dequeues and tasks they returned.
+  uint64_t batches;
+  uint64_t tasks;
+  /// approximate number of tasks waiting when the stats were taken.
+  uint64_t depth;
+};
+
+/**
+ * @brief WorkerQueue feeds a worker thread. Tasks are taken in bulk, and an
+ * idle worker waits according to its PollPolicy. Counters are only updated
+ * by the worker and may be read from any thread.
+ */
+template <class T>
+class WorkerQueue {
+ public:
+  WorkerQueue() = delete;
+  WorkerQueue(const WorkerQueue &) = delete;
+  WorkerQueue(PollPolicy policy, uint32_t spin_num)
+      : policy_(policy), spin_num_(spin_num) {}
+
+  void enqueue(const T &t) { queue_.enqueue(t); }
+
+  /// take up to max tasks, return 0 if none arrived while waiting, so that
+  /// the caller can check whether to stop.
+  size_t dequeue_bulk(T *tasks, size_t max) {
+    size_t num = 0;
+    if (policy_ != POLL_BLOCK) {
+      for (uint32_t i = 0; i < spin_num_; i++) {
+        num = queue_.try_dequeue_bulk(tasks, max);
+        if (num != 0) {
+          return count(num);
+        }
+        spins_.store(spins_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+        cpu_relax();
+      }
+      if (policy_ == POLL_BUSY) {
+        return 0;
+      }
+    }
+    num = queue_.wait_dequeue_bulk_timed(
+        tasks, max, std::chrono::milliseconds(WORKER_PARK_TIMEOUT_MS));
+    if (num != 0) {
+      wakeups_.store(wakeups_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+    }
+    return count(num);
+  }
+
+  WorkerStats get_stats() {
+    return {wakeups_.load(std::memory_order_relaxed),
+            spins_.load(std::memory_order_relaxed),
+            batches_.load(std::memory_order_relaxed),
+            tasks_.load(std::memory_order_relaxed), queue_.size_approx()};
+  }
+
+ private:
+  size_t count(size_t num) {
+    if (num != 0) {
+      batches_.store(batches_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+      tasks_.store(tasks_.load(std::memory_order_relaxed) + num,
+                   std::memory_order_relaxed);
+    }
+    return num;
+  }
+
+  static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  PollPolicy policy_;
+  uint32_t spin_num_;
+  BlockingConcurrentQueue<T> queue_;
+  std::atomic<uint64_t> wakeups_{0};
+  std::atomic<uint64_t> spins_{0};
+  std::atomic<uint64_t> batches_{0};
+  std::atomic<uint64_t> tasks_{0};
+};
+
+#endif  // PMPOOL_WORKERQUEUE_H_
@@ -0,0 +1,626 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/buffer/BufferPool.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool/buffer
+ * Created Date: Friday, March 27th 2020, 9:52:36 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_BUFFER_BUFFERPOOL_H_
+#define PMPOOL_BUFFER_BUFFERPOOL_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "../Numa.h"
+#include "../RmaBufferRegister.h"
+#include "../queue/concurrentqueue.h"
+
+using moodycamel::ConcurrentQueue;
+
+/// smallest buffer handed out, smaller requests are rounded up.
+#define BUFFER_POOL_MIN_CLASS 4096
+#define BUFFER_POOL_DRAIN_BULK 256
+/// slabs mapped and registered together, a divisor of 64.
+#define BUFFER_POOL_SEGMENT_SLABS 16
+#define BUFFER_POOL_HUGEPAGE_SIZE (2 * 1024 * 1024)
+/// every thread checks for idle segments once per this many puts.
+#define BUFFER_POOL_SHRINK_CHECK 65536
+/// segments are only released if the pool didn't grow for this long.
+#define BUFFER_POOL_SHRINK_DELAY_MS 10000
+/// gets wait this long by default for a buffer to be put back.
+#define BUFFER_POOL_WAIT_MS 1000
+#define BUFFER_POOL_WAIT_FOREVER UINT64_MAX
+
+struct BufferPoolOptions {
+  /// slabs mapped up front, 0 maps all of them.
+  uint32_t init_slab_num = 0;
+  /// back segments with hugepages, hugetlbfs pages if reserved, otherwise
+  /// transparent hugepages.
+  bool hugepage = false;
+  /// fault the pages of a segment in when it is mapped, not on first use.
+  bool prefault = false;
+  int numa_node = -1;
+};
+
+struct BufferPoolStats {
+  /// slabs carved into buffers of a size class.
+  uint64_t refills;
+  /// passes returning wholly free slabs of size classes to the pool.
+  uint64_t rebalances;
+  /// gets that had to wait for a buffer to be put back.
+  uint64_t waits;
+  /// gets that gave up as no buffer was put back in time.
+  uint64_t timeouts;
+  /// gets larger than a slab, served by a run of slabs.
+  uint64_t large_gets;
+  /// lost races for a slab.
+  uint64_t cas_retries;
+  /// segments mapped after construction and released again.
+  uint64_t grows;
+  uint64_t shrinks;
+  /// bytes of the mapped segments, and of the buffers taken from them.
+  uint64_t mapped_bytes;
+  uint64_t used_bytes;
+};
+
+/**
+ * @brief BufferPool hands out staging buffers from one registered region.
+ * The region is split into slabs, which are claimed with a CAS on a bitmap
+ * and carved into buffers of power of two size classes. Free buffers of each
+ * class are kept in a lock-free queue, so gets and puts from any number of
+ * threads neither lock nor wait for each other, and buffers are put back in
+ * any order. Requests larger than a slab take a run of whole slabs under a
+ * mutex. Once the region is exhausted, slabs whose buffers are all free are
+ * returned from their size class to the pool, and gets park on a condition
+ * variable that puts only signal while someone waits. Only these slow paths
+ * are counted in the statistics.
+ * The address range of the pool is reserved up front, but only mapped and
+ * registered in segments of BUFFER_POOL_SEGMENT_SLABS slabs as needed. Every
+ * segment is registered on its own, so a buffer never spans segments and its
+ * rkey is looked up by address. Segments beyond the initial ones are released
+ * again once they are entirely free and the pool stopped growing.
+ */
+class BufferPool {
+ public:
+  BufferPool() = delete;
+  BufferPool(const BufferPool &) = delete;
+  BufferPool(uint64_t slab_size, uint32_t slab_num,
+             RmaBufferRegister *rbr = nullptr, BufferPoolOptions options = {})
+      : slab_size_(slab_size),
+        slab_num_(slab_num),
+        rbr_(rbr),
+        options_(options) {
+    min_class_ = std::min<uint64_t>(BUFFER_POOL_MIN_CLASS, slab_size_);
+    for (uint64_t size = min_class_; size < slab_size_; size *= 2) {
+      class_sizes_.push_back(size);
+    }
+    class_sizes_.push_back(slab_size_);
+    classes_.reset(new ConcurrentQueue<uint32_t>[class_sizes_.size()]);
+    slab_words_ = (slab_num_ + 63) / 64;
+    slabs_.reset(new std::atomic<uint64_t>[slab_words_]);
+    for (uint64_t i = 0; i < slab_words_; i++) {
+      slabs_[i] = 0;
+    }
+    /// bits past the last slab are never free.
+    if (slab_num_ % 64 != 0) {
+      tail_ = ~0ULL << (slab_num_ % 64);
+      slabs_[slab_words_ - 1] = tail_;
+    }
+    segment_size_ = slab_size_ * BUFFER_POOL_SEGMENT_SLABS;
+    segment_num_ =
+        (slab_num_ + BUFFER_POOL_SEGMENT_SLABS - 1) / BUFFER_POOL_SEGMENT_SLABS;
+    segments_.reset(new std::atomic<Chunk *>[segment_num_]);
+    mapped_.resize(segment_num_, false);
+
+    /// reserve the whole range, aligned for hugepages.
+    reserved_size_ = slab_size_ * slab_num_ + BUFFER_POOL_HUGEPAGE_SIZE;
+    reserved_ = static_cast<char *>(
+        mmap(0, reserved_size_, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    assert(reserved_ != MAP_FAILED);
+    buffer_ = reinterpret_cast<char *>(
+        ((uint64_t)reserved_ + BUFFER_POOL_HUGEPAGE_SIZE - 1) &
+        ~(uint64_t)(BUFFER_POOL_HUGEPAGE_SIZE - 1));
+
+    uint64_t init_segment_num =
+        options_.init_slab_num == 0
+            ? segment_num_
+            : (options_.init_slab_num + BUFFER_POOL_SEGMENT_SLABS - 1) /
+                  BUFFER_POOL_SEGMENT_SLABS;
+    init_segment_num_ = std::min(init_segment_num, segment_num_);
+    for (uint64_t seg = 0; seg < segment_num_; seg++) {
+      segments_[seg] = nullptr;
+      if (seg < init_segment_num_) {
+        int res = map_segment(seg);
+        assert(res == 0);
+        (void)res;
+      } else {
+        slabs_[word_of(seg)] |= segment_mask(seg);
+      }
+    }
+  }
+  ~BufferPool() {
+    if (rbr_) {
+      for (uint64_t seg = 0; seg < segment_num_; seg++) {
+        if (mapped_[seg] && segments_[seg]) {
+          rbr_->unregister_rma_buffer(segments_[seg].load()->buffer_id);
+        }
+      }
+    }
+    munmap(reserved_, reserved_size_);
+    buffer_ = nullptr;
+  }
+
+  /// take a buffer of at least bytes, waiting up to wait_ms for one to be put
+  /// back if the pool is exhausted. Return nullptr if the request exceeds a
+  /// segment or the wait timed out, a wait_ms of 0 doesn't wait at all.
+  char *get(uint64_t bytes, uint64_t wait_ms = BUFFER_POOL_WAIT_MS) {
+    if (bytes > slab_size_ * std::min<uint64_t>(BUFFER_POOL_SEGMENT_SLABS,
+                                                slab_num_)) {
+      return nullptr;
+    }
+    uint64_t offset;
+    if (try_get(bytes, &offset)) {
+      return buffer_ + offset;
+    }
+    count(&waits_);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(
+                        std::min<uint64_t>(wait_ms, 1ULL << 40));
+    std::unique_lock<std::mutex> l(wait_mtx_);
+    waiters_.fetch_add(1);
+    /// pairs with the fence in notify_waiters, either the put sees a waiter
+    /// or the retry sees the buffer put back.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool got;
+    while (!(got = try_get(bytes, &offset))) {
+      if (wait_ms == BUFFER_POOL_WAIT_FOREVER) {
+        wait_cv_.wait(l);
+      } else if (wait_ms == 0 || wait_cv_.wait_until(l, deadline) ==
+                                     std::cv_status::timeout) {
+        got = try_get(bytes, &offset);
+        break;
+      }
+    }
+    waiters_.fetch_sub(1);
+    if (!got) {
+      count(&timeouts_);
+      return nullptr;
+    }
+    return buffer_ + offset;
+  }
+
+  /// bytes must be the size the buffer was taken with.
+  void put(const char *data, uint64_t bytes) {
+    assert(contains(data));
+    uint64_t offset = data - buffer_;
+    int cls = size_to_class(bytes);
+    if (cls < 0) {
+      assert(offset % slab_size_ == 0);
+      uint64_t slab = offset / slab_size_;
+      for (uint64_t i = 0; i < (bytes + slab_size_ - 1) / slab_size_; i++) {
+        release_slab(slab + i);
+      }
+      notify_waiters();
+      return;
+    }
+    classes_[cls].enqueue(offset / min_class_);
+    notify_waiters();
+    thread_local uint32_t puts = 0;
+    if (++puts % BUFFER_POOL_SHRINK_CHECK == 0) {
+      maybe_shrink();
+    }
+  }
+
+  /// registration of the segment holding data.
+  Chunk *get_rma_chunk(const char *data) {
+    assert(contains(data));
+    return segments_[(data - buffer_) / segment_size_].load(
+        std::memory_order_acquire);
+  }
+  bool contains(const char *data) {
+    return data >= buffer_ && data < buffer_ + slab_size_ * slab_num_;
+  }
+  uint64_t get_offset(uint64_t data) { return (data - (uint64_t)buffer_); }
+
+  /// occupancy is derived from the free slabs and buffers, so gets and puts
+  /// don't count anything for it.
+  BufferPoolStats get_stats() {
+    uint64_t mapped = 0;
+    {
+      std::lock_guard<std::mutex> l(segment_mtx_);
+      for (uint64_t seg = 0; seg < segment_num_; seg++) {
+        if (mapped_[seg]) {
+          mapped += std::min(segment_size_,
+                             slab_size_ * slab_num_ - seg * segment_size_);
+        }
+      }
+    }
+    /// slabs of unmapped segments are marked as taken.
+    uint64_t free = 0;
+    for (uint64_t i = 0; i < slab_words_; i++) {
+      free += __builtin_popcountll(~slabs_[i].load(std::memory_order_relaxed)) *
+              slab_size_;
+    }
+    for (uint32_t cls = 0; cls < class_sizes_.size(); cls++) {
+      free += classes_[cls].size_approx() * class_sizes_[cls];
+    }
+    return {refills_.load(std::memory_order_relaxed),
+            rebalances_.load(std::memory_order_relaxed),
+            waits_.load(std::memory_order_relaxed),
+            timeouts_.load(std::memory_order_relaxed),
+            large_gets_.load(std::memory_order_relaxed),
+            cas_retries_.load(std::memory_order_relaxed),
+            grows_.load(std::memory_order_relaxed),
+            shrinks_.load(std::memory_order_relaxed),
+            mapped,
+            mapped > free ? mapped - free : 0};
+  }
+
+  /// release every entirely free segment beyond the initial ones.
+  void shrink() {
+    std::lock_guard<std::mutex> l(segment_mtx_);
+    rebalance();
+    for (uint64_t seg = segment_num_; seg-- > init_segment_num_;) {
+      if (!mapped_[seg]) {
+        continue;
+      }
+      uint64_t mask = segment_mask(seg);
+      auto &word = slabs_[word_of(seg)];
+      uint64_t value = word.load(std::memory_order_relaxed);
+      /// take all slabs at once, so nobody claims one while it's unmapped.
+      while ((value & mask) == 0) {
+        if (word.compare_exchange_weak(value, value | mask,
+                                       std::memory_order_acq_rel)) {
+          unmap_segment(seg);
+          count(&shrinks_);
+          break;
+        }
+      }
+    }
+  }
+
+ private:
+  /// wake the gets waiting for a buffer, if any, without taking the mutex on
+  /// the common path.
+  void notify_waiters() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> l(wait_mtx_);
+    wait_cv_.notify_all();
+  }
+
+  /// return -1 if the size needs more than a slab.
+  int size_to_class(uint64_t bytes) {
+    for (uint32_t i = 0; i < class_sizes_.size(); i++) {
+      if (bytes <= class_sizes_[i]) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  bool try_get(uint64_t bytes, uint64_t *offset) {
+    int cls = size_to_class(bytes);
+    if (cls < 0) {
+      return get_large(bytes, offset);
+    }
+    uint32_t unit;
+    if (classes_[cls].try_dequeue(unit)) {
+      *offset = unit * min_class_;
+      return true;
+    }
+    if (refill(cls, offset)) {
+      return true;
+    }
+    rebalance();
+    if (refill(cls, offset)) {
+      return true;
+    }
+    return grow() && refill(cls, offset);
+  }
+
+  /// carve a free slab into buffers of the class, keep the first one.
+  bool refill(int cls, uint64_t *offset) {
+    int64_t slab = claim_slab();
+    if (slab < 0) {
+      return false;
+    }
+    count(&refills_);
+    uint64_t units_per_buffer = class_sizes_[cls] / min_class_;
+    uint64_t buffer_num = slab_size_ / class_sizes_[cls];
+    uint64_t first = slab * slab_size_ / min_class_;
+    vector<uint32_t> units;
+    for (uint64_t i = 1; i < buffer_num; i++) {
+      units.push_back(first + i * units_per_buffer);
+    }
+    if (!units.empty()) {
+      classes_[cls].enqueue_bulk(units.begin(), units.size());
+    }
+    *offset = first * min_class_;
+    return true;
+  }
+
+  bool get_large(uint64_t bytes, uint64_t *offset) {
+    uint64_t num = (bytes + slab_size_ - 1) / slab_size_;
+    std::lock_guard<std::mutex> l(large_mtx_);
+    int64_t slab = claim_run(num);
+    if (slab < 0) {
+      rebalance();
+      slab = claim_run(num);
+    }
+    if (slab < 0 && grow()) {
+      slab = claim_run(num);
+    }
+    if (slab < 0) {
+      return false;
+    }
+    count(&large_gets_);
+    *offset = slab * slab_size_;
+    return true;
+  }
+
+  /// drain the free buffers of every class. A slab all of whose buffers were
+  /// drained is not used by anyone and goes back to the pool, the other
+  /// buffers go back to their class.
+  void rebalance() {
+    std::lock_guard<std::mutex> l(rebalance_mtx_);
+    count(&rebalances_);
+    uint32_t drained[BUFFER_POOL_DRAIN_BULK];
+    for (uint32_t cls = 0; cls < class_sizes_.size(); cls++) {
+      vector<uint32_t> units;
+      size_t num;
+      while ((num = classes_[cls].try_dequeue_bulk(drained,
+                                                   BUFFER_POOL_DRAIN_BULK))) {
+        units.insert(units.end(), drained, drained + num);
+      }
+      uint64_t buffer_num = slab_size_ / class_sizes_[cls];
+      std::unordered_map<uint64_t, uint64_t> free_buffers;
+      for (auto unit : units) {
+        free_buffers[slab_of(unit)]++;
+      }
+      vector<uint32_t> kept;
+      for (auto unit : units) {
+        if (free_buffers[slab_of(unit)] != buffer_num) {
+          kept.push_back(unit);
+        }
+      }
+      for (auto &slab : free_buffers) {
+        if (slab.second == buffer_num) {
+          release_slab(slab.first);
+        }
+      }
+      if (!kept.empty()) {
+        classes_[cls].enqueue_bulk(kept.begin(), kept.size());
+      }
+    }
+  }
+
+  uint64_t slab_of(uint32_t unit) { return unit * min_class_ / slab_size_; }
+
+  uint64_t word_of(uint64_t seg) {
+    return seg * BUFFER_POOL_SEGMENT_SLABS / 64;
+  }
+
+  /// bits of the slabs of the segment in its bitmap word.
+  uint64_t segment_mask(uint64_t seg) {
+    uint64_t mask = ((1ULL << BUFFER_POOL_SEGMENT_SLABS) - 1)
+                    << (seg * BUFFER_POOL_SEGMENT_SLABS % 64);
+    if (word_of(seg) == slab_words_ - 1) {
+      mask &= ~tail_;
+    }
+    return mask;
+  }
+
+  /// map the next segment, unless another thread just did.
+  bool grow() {
+    std::lock_guard<std::mutex> l(segment_mtx_);
+    for (uint64_t seg = 0; seg < segment_num_; seg++) {
+      if (mapped_[seg] &&
+          (slabs_[word_of(seg)].load(std::memory_order_relaxed) &
+           segment_mask(seg)) != segment_mask(seg)) {
+        return true;
+      }
+    }
+    for (uint64_t seg = 0; seg < segment_num_; seg++) {
+      if (!mapped_[seg]) {
+        if (map_segment(seg) != 0) {
+          return false;
+        }
+        slabs_[word_of(seg)].fetch_and(~segment_mask(seg),
+                                       std::memory_order_acq_rel);
+        count(&grows_);
+        last_grow_.store(now_ms(), std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void maybe_shrink() {
+    if (grows_.load(std::memory_order_relaxed) ==
+            shrinks_.load(std::memory_order_relaxed) ||
+        now_ms() - last_grow_.load(std::memory_order_relaxed) <
+        BUFFER_POOL_SHRINK_DELAY_MS) {
+      return;
+    }
+    shrink();
+  }
+
+  int map_segment(uint64_t seg) {
+    char *addr = buffer_ + seg * segment_size_;
+    uint64_t size =
+        std::min(segment_size_, slab_size_ * slab_num_ - seg * segment_size_);
+    void *res = MAP_FAILED;
+    if (options_.hugepage) {
+      res = mmap(addr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+    }
+    if (res == MAP_FAILED) {
+      res = mmap(addr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+      if (res == MAP_FAILED) {
+        return -1;
+      }
+      if (options_.hugepage) {
+        madvise(addr, size, MADV_HUGEPAGE);
+      }
+    }
+    /// registration pins the pages, so place them before.
+    Numa::bind_memory(addr, size, options_.numa_node);
+    if (options_.prefault) {
+      for (uint64_t off = 0; off < size; off += 4096) {
+        addr[off] = 0;
+      }
+    }
+    if (rbr_) {
+      segments_[seg].store(rbr_->register_rma_buffer(addr, size),
+                           std::memory_order_release);
+    }
+    mapped_[seg] = true;
+    return 0;
+  }
+
+  void unmap_segment(uint64_t seg) {
+    char *addr = buffer_ + seg * segment_size_;
+    uint64_t size =
+        std::min(segment_size_, slab_size_ * slab_num_ - seg * segment_size_);
+    if (rbr_) {
+      rbr_->unregister_rma_buffer(segments_[seg].load()->buffer_id);
+      segments_[seg] = nullptr;
+    }
+    /// give the pages back but keep the range reserved.
+    mmap(addr, size, PROT_NONE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+    mapped_[seg] = false;
+  }
+
+  static uint64_t now_ms() {
+    return std::chrono::steady_clock::now().time_since_epoch() /
+           std::chrono::milliseconds(1);
+  }
+
+  /// claim any free slab, starting after the last one claimed.
+  int64_t claim_slab() {
+    uint64_t start = slab_hint_.load(std::memory_order_relaxed);
+    for (uint64_t i = 0; i < slab_words_; i++) {
+      uint64_t w = (start + i) % slab_words_;
+      uint64_t word = slabs_[w].load(std::memory_order_relaxed);
+      while (~word != 0) {
+        uint64_t bit = __builtin_ctzll(~word);
+        if (slabs_[w].compare_exchange_weak(word, word | (1ULL << bit),
+                                            std::memory_order_acq_rel)) {
+          slab_hint_.store(w, std::memory_order_relaxed);
+          return w * 64 + bit;
+        }
+        count(&cas_retries_);
+      }
+    }
+    return -1;
+  }
+
+  /// claim num contiguous slabs, only called under large_mtx_, single slabs
+  /// may still be claimed concurrently.
+  int64_t claim_run(uint64_t num) {
+    if (num == 1) {
+      return claim_slab();
+    }
+    uint64_t run = 0;
+    for (uint64_t slab = 0; slab < slab_num_; slab++) {
+      /// a run never spans segments, they are registered separately.
+      if (slab % BUFFER_POOL_SEGMENT_SLABS == 0) {
+        run = 0;
+      }
+      uint64_t bit = 1ULL << (slab % 64);
+      if (slabs_[slab / 64].load(std::memory_order_relaxed) & bit) {
+        run = 0;
+        continue;
+      }
+      if (++run < num) {
+        continue;
+      }
+      uint64_t first = slab + 1 - num;
+      uint64_t claimed = 0;
+      for (; claimed < num; claimed++) {
+        uint64_t s = first + claimed;
+        uint64_t b = 1ULL << (s % 64);
+        if (slabs_[s / 64].fetch_or(b, std::memory_order_acq_rel) & b) {
+          break;
+        }
+      }
+      if (claimed == num) {
+        return first;
+      }
+      for (uint64_t i = 0; i < claimed; i++) {
+        release_slab(first + i);
+      }
+      count(&cas_retries_);
+      run = 0;
+      slab = first + claimed;
+    }
+    return -1;
+  }
+
+  void release_slab(uint64_t slab) {
+    slabs_[slab / 64].fetch_and(~(1ULL << (slab % 64)),
+                                std::memory_order_acq_rel);
+  }
+
+  static void count(std::atomic<uint64_t> *counter) {
+    counter->fetch_add(1, std::memory_order_relaxed);
+  }
+
+  char *reserved_;
+  uint64_t reserved_size_;
+  char *buffer_;
+  uint64_t slab_size_;
+  uint64_t slab_num_;
+  uint64_t min_class_;
+  RmaBufferRegister *rbr_;
+  BufferPoolOptions options_;
+  uint64_t segment_size_;
+  uint64_t segment_num_;
+  uint64_t init_segment_num_;
+  std::unique_ptr<std::atomic<Chunk *>[]> segments_;
+  /// only accessed under segment_mtx_, or before the pool is shared.
+  vector<bool> mapped_;
+  std::mutex segment_mtx_;
+  std::atomic<uint64_t> last_grow_{0};
+  uint64_t tail_ = 0;
+  vector<uint64_t> class_sizes_;
+  std::unique_ptr<ConcurrentQueue<uint32_t>[]> classes_;
+  uint64_t slab_words_;
+  std::unique_ptr<std::atomic<uint64_t>[]> slabs_;
+  std::atomic<uint64_t> slab_hint_{0};
+  std::mutex large_mtx_;
+  std::mutex rebalance_mtx_;
+  /// gets waiting for a buffer park on wait_cv_.
+  std::mutex wait_mtx_;
+  std::condition_variable wait_cv_;
+  std::atomic<uint64_t> waiters_{0};
+  std::atomic<uint64_t> refills_{0};
+  std::atomic<uint64_t> rebalances_{0};
+  std::atomic<uint64_t> waits_{0};
+  std::atomic<uint64_t> timeouts_{0};
+  std::atomic<uint64_t> large_gets_{0};
+  std::atomic<uint64_t> cas_retries_{0};
+  std::atomic<uint64_t> grows_{0};
+  std::atomic<uint64_t> shrinks_{0};
+};
+
+#endif  // PMPOOL_BUFFER_BUFFERPOOL_H_
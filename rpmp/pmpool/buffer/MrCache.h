@@ -0,0 +1,193 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/pmpool/buffer/MrCache.h
+ * Path: /mnt/spark-pmof/tool/rpmp/pmpool/buffer
+ * Created Date: Monday, March 30th 2020, 10:06:51 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef PMPOOL_BUFFER_MRCACHE_H_
+#define PMPOOL_BUFFER_MRCACHE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <mutex>  // NOLINT
+
+#include "../RmaBufferRegister.h"
+
+struct MrCacheStats {
+  /// acquires served by a live registration.
+  uint64_t hits;
+  /// acquires that registered an evicted buffer again.
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t registered_bytes;
+};
+
+/**
+ * @brief MrCache keeps memory regions for buffers that the application
+ * registered, so that RDMA goes to and from them without staging.
+ * Registrations are pinned while a transfer uses them. Once the registered
+ * bytes exceed the capacity, the least recently used idle ones are
+ * deregistered. Their buffers stay known and are registered again on their
+ * next use.
+ */
+class MrCache {
+ public:
+  MrCache() = delete;
+  MrCache(const MrCache &) = delete;
+  MrCache(RmaBufferRegister *rbr, uint64_t capacity)
+      : rbr_(rbr), capacity_(capacity) {}
+  ~MrCache() {
+    for (auto &entry : entries_) {
+      if (entry.second.ck) {
+        rbr_->unregister_rma_buffer(entry.second.ck->buffer_id);
+      }
+    }
+  }
+
+  /// return -1 if the buffer overlaps a known one or can't be registered.
+  int add(const char *data, uint64_t size) {
+    std::lock_guard<std::mutex> l(mtx_);
+    uint64_t start = (uint64_t)data;
+    auto next = entries_.lower_bound(start);
+    if ((next != entries_.end() && next->first < start + size) ||
+        find(start, 1) != entries_.end()) {
+      return -1;
+    }
+    Entry &entry = entries_[start];
+    entry.size = size;
+    if (map(start, &entry) != 0) {
+      entries_.erase(start);
+      return -1;
+    }
+    evict();
+    return 0;
+  }
+
+  /// return -1 if the buffer is unknown or a transfer still uses it.
+  int remove(const char *data) {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto it = entries_.find((uint64_t)data);
+    if (it == entries_.end() || it->second.refs != 0) {
+      return -1;
+    }
+    unmap(&it->second);
+    entries_.erase(it);
+    return 0;
+  }
+
+  /// pin the registration of the known buffer that holds the range and
+  /// return it, nullptr if no known buffer holds it.
+  Chunk *acquire(const char *data, uint64_t size) {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto it = find((uint64_t)data, size);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    Entry &entry = it->second;
+    if (entry.ck) {
+      hits_++;
+      if (entry.refs == 0) {
+        lru_.erase(entry.lru);
+      }
+    } else {
+      misses_++;
+      if (map(it->first, &entry) != 0) {
+        return nullptr;
+      }
+      lru_.pop_front();
+    }
+    entry.refs++;
+    evict();
+    return entry.ck;
+  }
+
+  void release(const char *data) {
+    std::lock_guard<std::mutex> l(mtx_);
+    auto it = find((uint64_t)data, 1);
+    if (it == entries_.end() || it->second.refs == 0) {
+      return;
+    }
+    Entry &entry = it->second;
+    if (--entry.refs == 0) {
+      entry.lru = lru_.insert(lru_.begin(), it->first);
+      evict();
+    }
+  }
+
+  MrCacheStats get_stats() {
+    std::lock_guard<std::mutex> l(mtx_);
+    return {hits_, misses_, evictions_, registered_bytes_};
+  }
+
+ private:
+  struct Entry {
+    uint64_t size = 0;
+    Chunk *ck = nullptr;
+    uint32_t refs = 0;
+    /// position in lru_ while registered and idle.
+    std::list<uint64_t>::iterator lru;
+  };
+
+  std::map<uint64_t, Entry>::iterator find(uint64_t start, uint64_t size) {
+    auto it = entries_.upper_bound(start);
+    if (it == entries_.begin()) {
+      return entries_.end();
+    }
+    --it;
+    if (start + size > it->first + it->second.size) {
+      return entries_.end();
+    }
+    return it;
+  }
+
+  /// register the buffer and put it idle at the front of lru_.
+  int map(uint64_t start, Entry *entry) {
+    entry->ck =
+        rbr_->register_rma_buffer(reinterpret_cast<char *>(start), entry->size);
+    if (entry->ck == nullptr) {
+      return -1;
+    }
+    registered_bytes_ += entry->size;
+    entry->lru = lru_.insert(lru_.begin(), start);
+    return 0;
+  }
+
+  void unmap(Entry *entry) {
+    if (entry->ck == nullptr) {
+      return;
+    }
+    if (entry->refs == 0) {
+      lru_.erase(entry->lru);
+    }
+    rbr_->unregister_rma_buffer(entry->ck->buffer_id);
+    entry->ck = nullptr;
+    registered_bytes_ -= entry->size;
+  }
+
+  /// deregister idle buffers from the back of lru_ until under capacity.
+  void evict() {
+    while (registered_bytes_ > capacity_ && !lru_.empty()) {
+      Entry &entry = entries_[lru_.back()];
+      unmap(&entry);
+      evictions_++;
+    }
+  }
+
+  RmaBufferRegister *rbr_;
+  uint64_t capacity_;
+  std::mutex mtx_;
+  std::map<uint64_t, Entry> entries_;
+  /// registered buffers no transfer uses, most recently used first.
+  std::list<uint64_t> lru_;
+  uint64_t registered_bytes_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+#endif  // PMPOOL_BUFFER_MRCACHE_H_
@@ -12,89 +12,126 @@
 #include <HPNL/Callback.h>
 #include <HPNL/ChunkMgr.h>
 #include <HPNL/Connection.h>
+#include <immintrin.h>
+
+#include <algorithm>
 
 #include "../Event.h"
-#include "../buffer/CircularBuffer.h"
+#include "../buffer/BufferPool.h"
+#include "../buffer/MrCache.h"
 
 uint64_t timestamp_now() {
   return std::chrono::high_resolution_clock::now().time_since_epoch() /
          std::chrono::milliseconds(1);
 }
 
-RequestHandler::RequestHandler(NetworkClient *networkClient)
-    : networkClient_(networkClient) {}
+/// set while a callback of a request runs on this thread.
+static thread_local bool in_callback_ = false;
 
-void RequestHandler::addTask(Request *request) { handleRequest(request); }
+RequestHandler::RequestHandler(NetworkClient *networkClient, int max_inflight,
+                               bool busy_poll)
+    : networkClient_(networkClient),
+      max_inflight_(max_inflight),
+      busy_poll_(busy_poll) {}
 
-void RequestHandler::addTask(Request *request, std::function<void()> func) {
-  callback_map[request->get_rc().rid] = func;
+void RequestHandler::addTask(Request *request) {
+  inflight_begin(request->get_rc().rid, nullptr);
   handleRequest(request);
 }
 
-void RequestHandler::wait() {
+void RequestHandler::addTask(Request *request,
+                             std::function<void(RequestReplyContext &)> func) {
+  inflight_begin(request->get_rc().rid, func);
+  handleRequest(request);
+}
+
+void RequestHandler::inflight_begin(
+    uint64_t rid, std::function<void(RequestReplyContext &)> func) {
+  auto ctx = make_shared<InflightRequestContext>();
+  ctx->callback = func;
   unique_lock<mutex> lk(h_mtx);
-  while (!op_finished) {
-    cv.wait(lk);
+  /// a request chained from a callback takes the slot its completion freed.
+  while (inflight_num_ >= max_inflight_ && !in_callback_) {
+    window_cv.wait(lk);
+  }
+  inflight_num_++;
+  inflight_map_[rid] = ctx;
+}
+
+RequestReplyContext RequestHandler::wait(uint64_t rid) {
+  unique_lock<mutex> lk(h_mtx);
+  assert(inflight_map_.count(rid));
+  auto ctx = inflight_map_[rid];
+  lk.unlock();
+  if (busy_poll_) {
+    while (!ctx->op_finished.load(std::memory_order_acquire)) {
+      _mm_pause();
+    }
+  } else {
+    unique_lock<mutex> reply_lk(ctx->mtx_reply);
+    while (!ctx->op_finished.load(std::memory_order_acquire)) {
+      ctx->cv_reply.wait(reply_lk);
+    }
   }
+  lk.lock();
+  inflight_map_.erase(rid);
+  lk.unlock();
+  return std::move(ctx->requestReplyContext);
 }
 
 void RequestHandler::notify(RequestReply *requestReply) {
+  RequestReplyContext &rrc = requestReply->get_rrc();
   unique_lock<mutex> lk(h_mtx);
-  requestReplyContext = requestReply->get_rrc();
-  op_finished = true;
-  if (callback_map.count(requestReplyContext.rid) != 0) {
-    callback_map[requestReplyContext.rid]();
-    callback_map.erase(requestReplyContext.rid);
+  if (inflight_map_.count(rrc.rid) == 0) {
+    return;
+  }
+  auto ctx = inflight_map_[rrc.rid];
+  if (ctx->callback) {
+    inflight_map_.erase(rrc.rid);
+  }
+  inflight_num_--;
+  window_cv.notify_one();
+  lk.unlock();
+
+  if (ctx->callback) {
+    in_callback_ = true;
+    ctx->callback(rrc);
+    in_callback_ = false;
+    return;
+  }
+  ctx->requestReplyContext = std::move(rrc);
+  if (busy_poll_) {
+    ctx->op_finished.store(true, std::memory_order_release);
   } else {
-    cv.notify_one();
-    lk.unlock();
+    unique_lock<mutex> reply_lk(ctx->mtx_reply);
+    ctx->op_finished.store(true, std::memory_order_release);
+    ctx->cv_reply.notify_one();
   }
 }
 
+bool RequestHandler::in_callback() { return in_callback_; }
+
 void RequestHandler::handleRequest(Request *request) {
-  op_finished = false;
   OpType rt = request->get_rc().type;
   switch (rt) {
-    case ALLOC: {
-      request->encode();
-      networkClient_->send(reinterpret_cast<char *>(request->data_),
-                           request->size_);
-      break;
-    }
-    case FREE: {
-      request->encode();
-      networkClient_->send(reinterpret_cast<char *>(request->data_),
-                           request->size_);
-      break;
-    }
-    case WRITE: {
-      request->encode();
-      networkClient_->send(reinterpret_cast<char *>(request->data_),
-                           request->size_);
+    case ALLOC:
+    case FREE:
+    case WRITE:
+    case READ:
+    case PUT:
+    case GET:
+    case GET_META:
+    case DELETE:
+    case BATCH:
+    case FREE_ARENA:
+    case STATS: {
+      networkClient_->send(request);
       break;
     }
-    case READ: {
-      request->encode();
-      networkClient_->send(reinterpret_cast<char *>(request->data_),
-                           request->size_);
-      break;
-    }
-    case PUT: {
-      request->encode();
-      networkClient_->send(reinterpret_cast<char *>(request->data_),
-                           request->size_);
-    }
-    case GET_META: {
-      request->encode();
-      networkClient_->send(reinterpret_cast<char *>(request->data_),
-                           request->size_);
-    }
     default: {}
   }
 }
 
-RequestReplyContext &RequestHandler::get() { return requestReplyContext; }
-
 ClientConnectedCallback::ClientConnectedCallback(NetworkClient *networkClient) {
   networkClient_ = networkClient;
 }
@@ -136,24 +173,23 @@ void ClientRecvCallback::operator()(void *param_1, void *param_2) {
   // con->send(new_ck);
   // test end
 
-  RequestReply requestReply(reinterpret_cast<char *>(ck->buffer), ck->size,
-                            reinterpret_cast<Connection *>(ck->con));
-  requestReply.decode();
-  RequestReplyContext rrc = requestReply.get_rrc();
+  /// decode in place, the reply only lives until it was handed to the waiter.
+  RequestReply requestReply{RequestReplyContext()};
+  requestReply.decode(reinterpret_cast<char *>(ck->buffer), ck->size,
+                      reinterpret_cast<Connection *>(ck->con));
+  RequestReplyContext &rrc = requestReply.get_rrc();
   switch (rrc.type) {
-    case ALLOC_REPLY: {
-      requestHandler_->notify(&requestReply);
-      break;
-    }
-    case FREE_REPLY: {
-      requestHandler_->notify(&requestReply);
-      break;
-    }
-    case WRITE_REPLY: {
-      requestHandler_->notify(&requestReply);
-      break;
-    }
-    case READ_REPLY: {
+    case ALLOC_REPLY:
+    case FREE_REPLY:
+    case WRITE_REPLY:
+    case READ_REPLY:
+    case PUT_REPLY:
+    case GET_REPLY:
+    case GET_META_REPLY:
+    case DELETE_REPLY:
+    case BATCH_REPLY:
+    case FREE_ARENA_REPLY:
+    case STATS_REPLY: {
       requestHandler_->notify(&requestReply);
       break;
     }
@@ -170,13 +206,20 @@ NetworkClient::NetworkClient(const string &remote_address,
                              const string &remote_port, int worker_num,
                              int buffer_num_per_con, int buffer_size,
                              int init_buffer_num)
+    : NetworkClient(remote_address, remote_port, worker_num,
+                    buffer_num_per_con, buffer_size, init_buffer_num, 1) {}
+
+NetworkClient::NetworkClient(const string &remote_address,
+                             const string &remote_port, int worker_num,
+                             int buffer_num_per_con, int buffer_size,
+                             int init_buffer_num, int connection_num)
     : remote_address_(remote_address),
       remote_port_(remote_port),
       worker_num_(worker_num),
       buffer_num_per_con_(buffer_num_per_con),
       buffer_size_(buffer_size),
       init_buffer_num_(init_buffer_num),
-      connected_(false) {}
+      connection_num_(connection_num) {}
 
 NetworkClient::~NetworkClient() {
   delete shutdownCallback;
@@ -190,7 +233,8 @@ int NetworkClient::init(RequestHandler *requestHandler) {
   if ((client_->init()) != 0) {
     return -1;
   }
-  chunkMgr_ = new ChunkPool(client_, buffer_size_, init_buffer_num_);
+  chunkMgr_ = new ChunkPool(client_, buffer_size_,
+                            init_buffer_num_ * connection_num_);
 
   client_->set_chunk_mgr(chunkMgr_);
 
@@ -205,13 +249,30 @@ int NetworkClient::init(RequestHandler *requestHandler) {
   client_->set_send_callback(sendCallback);
 
   client_->start();
-  int res = client_->connect(remote_address_.c_str(), remote_port_.c_str());
+  for (int i = 0; i < connection_num_; i++) {
+    int res = client_->connect(remote_address_.c_str(), remote_port_.c_str());
+    if (res) {
+      return -1;
+    }
+  }
   unique_lock<mutex> lk(con_mtx);
-  while (!connected_) {
+  while (lanes_.size() < (uint64_t)connection_num_) {
     con_v.wait(lk);
   }
+  lk.unlock();
 
-  circularBuffer_ = make_shared<CircularBuffer>(1024 * 1024, 512, false, this);
+  /// split the client buffer among lanes, each lane maps one segment up
+  /// front and grows on demand.
+  uint32_t buffer_num = std::max(512 / connection_num_, 64);
+  BufferPoolOptions options;
+  options.init_slab_num = 1;
+  options.hugepage = true;
+  for (auto &lane : lanes_) {
+    lane.bufferPool =
+        make_shared<BufferPool>(1024 * 1024, buffer_num, this, options);
+  }
+  mrCache_ = make_shared<MrCache>(this, MR_CACHE_CAPACITY);
+  return 0;
 }
 
 void NetworkClient::shutdown() { client_->shutdown(); }
@@ -226,8 +287,35 @@ void NetworkClient::unregister_rma_buffer(int buffer_id) {
   client_->unreg_rma_buffer(buffer_id);
 }
 
-uint64_t NetworkClient::get_dram_buffer(const char *data, uint64_t size) {
-  char *dest = circularBuffer_->get(size);
+ClientLane &NetworkClient::get_lane() {
+  /// threads are pinned to lanes in the order they first issue requests.
+  static atomic<uint64_t> thread_seq{0};
+  thread_local uint64_t thread_id = thread_seq++;
+  return lanes_[thread_id % lanes_.size()];
+}
+
+ClientLane &NetworkClient::get_lane(uint64_t address) {
+  for (auto &lane : lanes_) {
+    if (lane.bufferPool->contains(reinterpret_cast<char *>(address))) {
+      return lane;
+    }
+  }
+  assert(false && "address doesn't belong to any client buffer.");
+  return lanes_[0];
+}
+
+uint64_t NetworkClient::get_dram_buffer(const char *data, uint64_t size,
+                                        int lane) {
+  /// requests are bounded by the in-flight window, so a buffer is put back
+  /// as soon as one of them completes, unless the completions are delivered
+  /// by the calling thread itself.
+  char *dest = (lane < 0 ? get_lane() : lanes_[lane % lanes_.size()])
+                   .bufferPool->get(size, RequestHandler::in_callback()
+                                              ? BUFFER_POOL_WAIT_MS
+                                              : BUFFER_POOL_WAIT_FOREVER);
+  if (dest == nullptr) {
+    return 0;
+  }
   if (data) {
     memcpy(dest, data, size);
   }
@@ -235,26 +323,81 @@ uint64_t NetworkClient::get_dram_buffer(const char *data, uint64_t size) {
 }
 
 void NetworkClient::reclaim_dram_buffer(uint64_t src_address, uint64_t size) {
-  circularBuffer_->put(reinterpret_cast<char *>(src_address), size);
+  get_lane(src_address)
+      .bufferPool->put(reinterpret_cast<char *>(src_address), size);
 }
 
-uint64_t NetworkClient::get_rkey() {
-  return circularBuffer_->get_rma_chunk()->mr->key;
+uint64_t NetworkClient::get_rkey(uint64_t address) {
+  return get_lane(address)
+      .bufferPool->get_rma_chunk(reinterpret_cast<char *>(address))
+      ->mr->key;
+}
+
+int NetworkClient::register_user_buffer(const char *data, uint64_t size) {
+  return mrCache_->add(data, size);
+}
+
+int NetworkClient::unregister_user_buffer(const char *data) {
+  return mrCache_->remove(data);
+}
+
+uint64_t NetworkClient::get_user_buffer(const char *data, uint64_t size,
+                                        uint64_t *rkey) {
+  Chunk *ck = mrCache_->acquire(data, size);
+  if (ck == nullptr) {
+    return 0;
+  }
+  *rkey = ck->mr->key;
+  return (uint64_t)data;
+}
+
+uint64_t NetworkClient::get_rma_buffer(const char *data, uint64_t size,
+                                       bool copy, uint64_t *rkey, int lane) {
+  if (data && get_user_buffer(data, size, rkey)) {
+    return (uint64_t)data;
+  }
+  uint64_t address = get_dram_buffer(copy ? data : nullptr, size, lane);
+  if (address) {
+    *rkey = get_rkey(address);
+  }
+  return address;
+}
+
+void NetworkClient::reclaim_rma_buffer(uint64_t address, const char *data,
+                                       uint64_t size) {
+  if (address == (uint64_t)data) {
+    mrCache_->release(data);
+    return;
+  }
+  reclaim_dram_buffer(address, size);
+}
+
+int NetworkClient::get_lane_num() { return lanes_.size(); }
+
+Connection *NetworkClient::get_connection(int lane) {
+  return lane < 0 ? nullptr : lanes_[lane % lanes_.size()].con;
 }
 
 void NetworkClient::connected(Connection *con) {
   std::unique_lock<std::mutex> lk(con_mtx);
-  con_ = con;
-  connected_ = true;
+  ClientLane lane;
+  lane.con = con;
+  lanes_.push_back(lane);
   con_v.notify_all();
   lk.unlock();
 }
 
-void NetworkClient::send(char *data, uint64_t size) {
-  auto ck = chunkMgr_->get(con_);
-  std::memcpy(reinterpret_cast<char *>(ck->buffer), data, size);
+void NetworkClient::send(Request *request) {
+  Connection *con = request->get_rc().con;
+  if (con == nullptr) {
+    con = get_lane().con;
+  }
+  auto ck = chunkMgr_->get(con);
+  assert(request->encoded_size() <= ck->capacity);
+  uint64_t size = 0;
+  request->encode(reinterpret_cast<char *>(ck->buffer), &size);
   ck->size = size;
-  con_->send(ck);
+  con->send(ck);
 }
 
 void NetworkClient::read(Request *request) {
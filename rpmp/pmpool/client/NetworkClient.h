@@ -16,11 +16,13 @@
 #include <atomic>
 #include <condition_variable>  // NOLINT
 #include <cstring>
+#include <functional>
 #include <future>  // NOLINT
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "../Event.h"
 #include "../RmaBufferRegister.h"
@@ -39,40 +41,69 @@ using std::shared_ptr;
 using std::string;
 using std::unique_lock;
 using std::unordered_map;
+using std::vector;
+
+/// bytes of application buffers kept registered at most.
+#define MR_CACHE_CAPACITY (4ULL * 1024 * 1024 * 1024)
 
 class NetworkClient;
-class CircularBuffer;
+class BufferPool;
+class MrCache;
 class Connection;
 class ChunkMgr;
 
 typedef promise<RequestReplyContext> Promise;
 typedef future<RequestReplyContext> Future;
 
+/**
+ * @brief Completion state of one in-flight request, indexed by request id.
+ * A request either carries a callback, which is invoked from the network
+ * thread once the reply arrives, or is waited on by the issuing thread.
+ */
+struct InflightRequestContext {
+  std::mutex mtx_reply;
+  std::condition_variable cv_reply;
+  std::atomic<bool> op_finished{false};
+  RequestReplyContext requestReplyContext;
+  std::function<void(RequestReplyContext &)> callback;
+};
+
+/**
+ * @brief RequestHandler pipelines requests over the network client. Every
+ * request is tracked by its rid, so that many requests can be in flight at
+ * the same time. The number of in-flight requests is bounded by max_inflight,
+ * addTask blocks once the window is full, unless it is called from a
+ * callback: completions are delivered by the thread it would block.
+ */
 class RequestHandler {
  public:
-  explicit RequestHandler(NetworkClient *networkClient);
+  RequestHandler(NetworkClient *networkClient, int max_inflight = 64,
+                 bool busy_poll = false);
   ~RequestHandler() = default;
   void addTask(Request *request);
-  void addTask(Request *request, std::function<void()> func);
+  void addTask(Request *request,
+               std::function<void(RequestReplyContext &)> func);
   void notify(RequestReply *requestReply);
-  void wait();
-  RequestReplyContext &get();
+  /// wait for the reply of request rid and return its context.
+  /// Spin on the completion flag if busy_poll is enabled,
+  /// otherwise block on the condition variable of the request.
+  RequestReplyContext wait(uint64_t rid);
+  /// whether the calling thread is running the callback of a request.
+  static bool in_callback();
 
  private:
   void handleRequest(Request *request);
+  void inflight_begin(uint64_t rid,
+                      std::function<void(RequestReplyContext &)> func);
 
  private:
   NetworkClient *networkClient_;
-  BlockingConcurrentQueue<Request *> pendingRequestQueue_;
+  int max_inflight_;
+  bool busy_poll_;
   std::mutex h_mtx;
-  unordered_map<uint64_t, std::function<void()>> callback_map;
-  uint64_t total_num = 0;
-  uint64_t begin = 0;
-  uint64_t end = 0;
-  uint64_t time = 0;
-  bool op_finished = false;
-  std::condition_variable cv;
-  RequestReplyContext requestReplyContext;
+  std::condition_variable window_cv;
+  int inflight_num_ = 0;
+  unordered_map<uint64_t, shared_ptr<InflightRequestContext>> inflight_map_;
 };
 
 class ClientShutdownCallback : public Callback {
@@ -122,6 +153,16 @@ class ClientSendCallback : public Callback {
   ChunkMgr *chunkMgr_;
 };
 
+/**
+ * @brief A lane is one connection to the server together with the client
+ * buffer used for RDMA on that connection. Every client thread is pinned to a
+ * lane, so threads spread over connections instead of serializing on one.
+ */
+struct ClientLane {
+  Connection *con;
+  shared_ptr<BufferPool> bufferPool;
+};
+
 class NetworkClient : public RmaBufferRegister {
  public:
   friend ClientConnectedCallback;
@@ -130,19 +171,50 @@ class NetworkClient : public RmaBufferRegister {
   NetworkClient(const string &remote_address, const string &remote_port,
                 int worker_num, int buffer_num_per_con, int buffer_size,
                 int init_buffer_num);
-  ~NetworkClient();
+  NetworkClient(const string &remote_address, const string &remote_port,
+                int worker_num, int buffer_num_per_con, int buffer_size,
+                int init_buffer_num, int connection_num);
+  virtual ~NetworkClient();
   int init(RequestHandler *requesthandler);
   void shutdown();
   void wait();
   Chunk *register_rma_buffer(char *rma_buffer, uint64_t size) override;
   void unregister_rma_buffer(int buffer_id) override;
-  uint64_t get_dram_buffer(const char *data, uint64_t size);
+  /// get buffer from the client buffer of the lane of calling thread, or of
+  /// the given lane. Return 0 if size exceeds the largest buffer, or if
+  /// called from a callback and no buffer is put back in time.
+  uint64_t get_dram_buffer(const char *data, uint64_t size, int lane = -1);
   void reclaim_dram_buffer(uint64_t src_address, uint64_t size);
-  uint64_t get_rkey();
+  /// return the rkey of the client buffer that address belongs to.
+  uint64_t get_rkey(uint64_t address);
+  /// register a buffer of the application in the memory region cache.
+  int register_user_buffer(const char *data, uint64_t size);
+  int unregister_user_buffer(const char *data);
+  /// return data if it lies in a registered application buffer, 0 otherwise.
+  /// rkey is set to the rkey of the buffer.
+  uint64_t get_user_buffer(const char *data, uint64_t size, uint64_t *rkey);
+  /// return the address to RDMA to or from on behalf of data: data itself
+  /// if it lies in a registered application buffer, otherwise a client
+  /// buffer, which holds a copy of data if copy is set. rkey is set to the
+  /// rkey of the address.
+  uint64_t get_rma_buffer(const char *data, uint64_t size, bool copy,
+                          uint64_t *rkey, int lane = -1);
+  /// release the address returned by get_rma_buffer for data.
+  void reclaim_rma_buffer(uint64_t address, const char *data, uint64_t size);
+  int get_lane_num();
+  /// connection of the lane, nullptr for the lane of calling thread.
+  Connection *get_connection(int lane);
   void connected(Connection *con);
-  void send(char *data, uint64_t size);
+  /// encode the request directly into a send chunk and send it, over the
+  /// connection of the request if set, otherwise over the lane of calling
+  /// thread.
+  virtual void send(Request *request);
   void read(Request *request);
 
+ private:
+  ClientLane &get_lane();
+  ClientLane &get_lane(uint64_t address);
+
  private:
   string remote_address_;
   string remote_port_;
@@ -150,17 +222,17 @@ class NetworkClient : public RmaBufferRegister {
   int buffer_num_per_con_;
   int buffer_size_;
   int init_buffer_num_;
+  int connection_num_;
   Client *client_;
   ChunkMgr *chunkMgr_;
-  Connection *con_;
-  ClientShutdownCallback *shutdownCallback;
-  ClientConnectedCallback *connectedCallback;
-  ClientRecvCallback *recvCallback;
-  ClientSendCallback *sendCallback;
+  vector<ClientLane> lanes_;
+  shared_ptr<MrCache> mrCache_;
+  ClientShutdownCallback *shutdownCallback = nullptr;
+  ClientConnectedCallback *connectedCallback = nullptr;
+  ClientRecvCallback *recvCallback = nullptr;
+  ClientSendCallback *sendCallback = nullptr;
   mutex con_mtx;
-  bool connected_;
   condition_variable con_v;
-  shared_ptr<CircularBuffer> circularBuffer_;
   atomic<uint64_t> buffer_id_{0};
 };
 
@@ -15,16 +15,35 @@
 #include "pmpool/Protocol.h"
 
 PmPoolClient::PmPoolClient(const string &remote_address,
-                           const string &remote_port) {
+                           const string &remote_port)
+    : PmPoolClient(remote_address, remote_port, 1, DEFAULT_MAX_INFLIGHT,
+                   false) {}
+
+PmPoolClient::PmPoolClient(const string &remote_address,
+                           const string &remote_port, int connection_num,
+                           int max_inflight, bool busy_poll) {
   tx_finished = true;
   op_finished = false;
-  networkClient_ = make_shared<NetworkClient>(remote_address, remote_port);
-  requestHandler_ = make_shared<RequestHandler>(networkClient_.get());
+  networkClient_ = make_shared<NetworkClient>(
+      remote_address, remote_port, connection_num, 32, 65536, 64,
+      connection_num);
+  requestHandler_ = make_shared<RequestHandler>(networkClient_.get(),
+                                                max_inflight, busy_poll);
 }
 
 PmPoolClient::~PmPoolClient() {}
 
-int PmPoolClient::init() { networkClient_->init(requestHandler_.get()); }
+int PmPoolClient::init() { return networkClient_->init(requestHandler_.get()); }
+
+int PmPoolClient::register_buffer(const char *data, uint64_t size) {
+  return networkClient_->register_user_buffer(data, size);
+}
+
+int PmPoolClient::unregister_buffer(const char *data) {
+  return networkClient_->unregister_user_buffer(data);
+}
+
+void PmPoolClient::set_striping(bool striping) { striping_ = striping; }
 
 void PmPoolClient::begin_tx() {
   std::unique_lock<std::mutex> lk(tx_mtx);
@@ -41,8 +60,18 @@ uint64_t PmPoolClient::alloc(uint64_t size) {
   rc.size = size;
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  return requestHandler_->get().address;
+  return requestHandler_->wait(rc.rid).address;
+}
+
+int PmPoolClient::alloc(uint64_t size, std::function<void(uint64_t)> func) {
+  RequestContext rc = {};
+  rc.type = ALLOC;
+  rc.rid = rid_++;
+  rc.size = size;
+  Request request(rc);
+  requestHandler_->addTask(
+      &request, [func](RequestReplyContext &rrc) { func(rrc.address); });
+  return 0;
 }
 
 int PmPoolClient::free(uint64_t address) {
@@ -52,8 +81,18 @@ int PmPoolClient::free(uint64_t address) {
   rc.address = address;
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  return requestHandler_->get().success;
+  return requestHandler_->wait(rc.rid).success;
+}
+
+int PmPoolClient::free(uint64_t address, std::function<void(int)> func) {
+  RequestContext rc = {};
+  rc.type = FREE;
+  rc.rid = rid_++;
+  rc.address = address;
+  Request request(rc);
+  requestHandler_->addTask(
+      &request, [func](RequestReplyContext &rrc) { func(rrc.success); });
+  return 0;
 }
 
 void PmPoolClient::shutdown() { networkClient_->shutdown(); }
@@ -61,81 +100,570 @@ void PmPoolClient::shutdown() { networkClient_->shutdown(); }
 void PmPoolClient::wait() { networkClient_->wait(); }
 
 int PmPoolClient::write(uint64_t address, const char *data, uint64_t size) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    return transfer(WRITE, address, data, nullptr, size);
+  }
   RequestContext rc = {};
   rc.type = WRITE;
   rc.rid = rid_++;
   rc.size = size;
   rc.address = address;
   // allocate memory for RMA read from client.
-  rc.src_address = networkClient_->get_dram_buffer(data, rc.size);
-  rc.src_rkey = networkClient_->get_rkey();
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, true,
+                                                   &rc.src_rkey);
+  // no buffer came free in time, only possible inside a callback.
+  if (rc.src_address == 0) {
+    return -1;
+  }
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  auto res = requestHandler_->get().success;
-  networkClient_->reclaim_dram_buffer(rc.src_address, rc.size);
+  auto res = requestHandler_->wait(rc.rid).success;
+  networkClient_->reclaim_rma_buffer(rc.src_address, data, rc.size);
   return res;
 }
 
+int PmPoolClient::write(uint64_t address, const char *data, uint64_t size,
+                        std::function<void(int)> func) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    transfer(WRITE, address, data, nullptr, size, func);
+    return 0;
+  }
+  RequestContext rc = {};
+  rc.type = WRITE;
+  rc.rid = rid_++;
+  rc.size = size;
+  rc.address = address;
+  // allocate memory for RMA read from client.
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, true,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    func(-1);
+    return 0;
+  }
+  Request request(rc);
+  auto networkClient = networkClient_;
+  uint64_t src_address = rc.src_address;
+  requestHandler_->addTask(&request, [=](RequestReplyContext &rrc) {
+    networkClient->reclaim_rma_buffer(src_address, data, size);
+    func(rrc.success);
+  });
+  return 0;
+}
+
 uint64_t PmPoolClient::write(const char *data, uint64_t size) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    uint64_t address = alloc(size);
+    if (address == (uint64_t)-1) {
+      return -1;
+    }
+    if (transfer(WRITE, address, data, nullptr, size)) {
+      free(address);
+      return -1;
+    }
+    return address;
+  }
   RequestContext rc = {};
   rc.type = WRITE;
   rc.rid = rid_++;
   rc.size = size;
   rc.address = 0;
   // allocate memory for RMA read from client.
-  rc.src_address = networkClient_->get_dram_buffer(data, rc.size);
-  rc.src_rkey = networkClient_->get_rkey();
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, true,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    return -1;
+  }
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  auto res = requestHandler_->get().address;
-  networkClient_->reclaim_dram_buffer(rc.src_address, rc.size);
+  auto res = requestHandler_->wait(rc.rid).address;
+  networkClient_->reclaim_rma_buffer(rc.src_address, data, rc.size);
   return res;
 }
 
+int PmPoolClient::write(const char *data, uint64_t size,
+                        std::function<void(uint64_t)> func) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    alloc(size, [this, data, size, func](uint64_t address) {
+      if (address == (uint64_t)-1) {
+        func(address);
+        return;
+      }
+      transfer(WRITE, address, data, nullptr, size,
+               [this, address, func](int res) {
+                 if (res) {
+                   this->free(address, [](int) {});
+                   func(-1);
+                   return;
+                 }
+                 func(address);
+               });
+    });
+    return 0;
+  }
+  RequestContext rc = {};
+  rc.type = WRITE;
+  rc.rid = rid_++;
+  rc.size = size;
+  rc.address = 0;
+  // allocate memory for RMA read from client.
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, true,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    func(-1);
+    return 0;
+  }
+  Request request(rc);
+  auto networkClient = networkClient_;
+  uint64_t src_address = rc.src_address;
+  requestHandler_->addTask(&request, [=](RequestReplyContext &rrc) {
+    networkClient->reclaim_rma_buffer(src_address, data, size);
+    func(rrc.address);
+  });
+  return 0;
+}
+
 int PmPoolClient::read(uint64_t address, char *data, uint64_t size) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    return transfer(READ, address, nullptr, data, size);
+  }
   RequestContext rc = {};
   rc.type = READ;
   rc.rid = rid_++;
   rc.size = size;
   rc.address = address;
   // allocate memory for RMA read from client.
-  rc.src_address = networkClient_->get_dram_buffer(nullptr, rc.size);
-  rc.src_rkey = networkClient_->get_rkey();
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, false,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    return -1;
+  }
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  auto res = requestHandler_->get().success;
-  if (!res) {
+  auto res = requestHandler_->wait(rc.rid).success;
+  if (!res && rc.src_address != (uint64_t)data) {
     memcpy(data, reinterpret_cast<char *>(rc.src_address), size);
   }
-  networkClient_->reclaim_dram_buffer(rc.src_address, rc.size);
+  networkClient_->reclaim_rma_buffer(rc.src_address, data, rc.size);
   return res;
 }
 
 int PmPoolClient::read(uint64_t address, char *data, uint64_t size,
                        std::function<void(int)> func) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    transfer(READ, address, nullptr, data, size, func);
+    return 0;
+  }
   RequestContext rc = {};
   rc.type = READ;
   rc.rid = rid_++;
   rc.size = size;
   rc.address = address;
   // allocate memory for RMA read from client.
-  rc.src_address = networkClient_->get_dram_buffer(nullptr, rc.size);
-  rc.src_rkey = networkClient_->get_rkey();
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, false,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    func(-1);
+    return 0;
+  }
   Request request(rc);
-  requestHandler_->addTask(&request, [&] {
-    auto res = requestHandler_->get().success;
-    if (res) {
-      memcpy(data, reinterpret_cast<char *>(rc.src_address), size);
+  auto networkClient = networkClient_;
+  uint64_t src_address = rc.src_address;
+  requestHandler_->addTask(&request, [=](RequestReplyContext &rrc) {
+    auto res = rrc.success;
+    if (!res && src_address != (uint64_t)data) {
+      memcpy(data, reinterpret_cast<char *>(src_address), size);
     }
-    networkClient_->reclaim_dram_buffer(rc.src_address, rc.size);
+    networkClient->reclaim_rma_buffer(src_address, data, size);
     func(res);
   });
   return 0;
 }
 
+uint64_t PmPoolClient::alloc_in_arena(uint64_t arena, uint64_t size) {
+  assert(arena != NO_ARENA);
+  RequestContext rc = {};
+  rc.type = ALLOC;
+  rc.rid = rid_++;
+  rc.size = size;
+  rc.key = arena;
+  Request request(rc);
+  requestHandler_->addTask(&request);
+  return requestHandler_->wait(rc.rid).address;
+}
+
+uint64_t PmPoolClient::write_in_arena(uint64_t arena, const char *data,
+                                      uint64_t size) {
+  assert(arena != NO_ARENA);
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    uint64_t address = alloc_in_arena(arena, size);
+    if (address == (uint64_t)-1 ||
+        transfer(WRITE, address, data, nullptr, size)) {
+      return -1;
+    }
+    return address;
+  }
+  RequestContext rc = {};
+  rc.type = WRITE;
+  rc.rid = rid_++;
+  rc.size = size;
+  rc.address = 0;
+  rc.key = arena;
+  // allocate memory for RMA read from client.
+  rc.src_address = networkClient_->get_rma_buffer(data, rc.size, true,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    return -1;
+  }
+  Request request(rc);
+  requestHandler_->addTask(&request);
+  auto res = requestHandler_->wait(rc.rid).address;
+  networkClient_->reclaim_rma_buffer(rc.src_address, data, rc.size);
+  return res;
+}
+
+int PmPoolClient::free_arena(uint64_t arena) {
+  RequestContext rc = {};
+  rc.type = FREE_ARENA;
+  rc.rid = rid_++;
+  rc.key = arena;
+  Request request(rc);
+  requestHandler_->addTask(&request);
+  return requestHandler_->wait(rc.rid).success;
+}
+
+/// state of a transfer shared by its segments.
+struct TransferContext {
+  OpType type;
+  const char *src;
+  char *dest;
+  std::function<void(int)> func;
+  /// address and size of every segment, and its offset in src or dest.
+  vector<block_meta> segments;
+  vector<uint64_t> offsets;
+  /// client buffers are taken with the size of the largest segment, so that
+  /// a buffer fits any segment it is handed on to.
+  uint64_t staging_size = 0;
+  std::mutex mtx;
+  uint64_t next = 0;
+  uint64_t pending = 0;
+  int failed = 0;
+};
+
+void PmPoolClient::transfer(OpType type, const vector<block_meta> &blocks,
+                            const char *src, char *dest,
+                            std::function<void(int)> func) {
+  auto ctx = make_shared<TransferContext>();
+  ctx->type = type;
+  ctx->src = src;
+  ctx->dest = dest;
+  ctx->func = func;
+  uint64_t offset = 0;
+  for (auto &bm : blocks) {
+    for (uint64_t done = 0; done < bm.size; done += TRANSFER_SEGMENT_SIZE) {
+      uint64_t segment_size =
+          std::min<uint64_t>(TRANSFER_SEGMENT_SIZE, bm.size - done);
+      ctx->segments.emplace_back(bm.address + done, segment_size);
+      ctx->offsets.push_back(offset + done);
+      ctx->staging_size = std::max(ctx->staging_size, segment_size);
+    }
+    offset += bm.size;
+  }
+  ctx->pending = ctx->segments.size();
+  if (ctx->pending == 0) {
+    func(0);
+    return;
+  }
+  uint64_t window = std::min<uint64_t>(TRANSFER_WINDOW, ctx->pending);
+  for (uint64_t i = 0; i < window; i++) {
+    transfer_next(ctx, 0);
+  }
+}
+
+void PmPoolClient::transfer(OpType type, uint64_t address, const char *src,
+                            char *dest, uint64_t size,
+                            std::function<void(int)> func) {
+  transfer(type, {block_meta(address, size)}, src, dest, func);
+}
+
+void PmPoolClient::transfer_next(shared_ptr<TransferContext> ctx,
+                                 uint64_t buffer) {
+  uint64_t i;
+  bool failed;
+  {
+    std::lock_guard<std::mutex> lk(ctx->mtx);
+    if (ctx->next == ctx->segments.size()) {
+      if (buffer) {
+        networkClient_->reclaim_dram_buffer(buffer, ctx->staging_size);
+      }
+      return;
+    }
+    i = ctx->next++;
+    failed = ctx->failed != 0;
+  }
+  /// the rest of a failed transfer isn't sent.
+  if (failed) {
+    transfer_done(ctx, -1, buffer);
+    return;
+  }
+  const block_meta &segment = ctx->segments[i];
+  bool write = ctx->type == WRITE;
+  const char *user = (write ? ctx->src : ctx->dest) + ctx->offsets[i];
+  int lane = striping_ ? i % networkClient_->get_lane_num() : -1;
+  RequestContext rc = {};
+  rc.type = ctx->type;
+  rc.rid = rid_++;
+  rc.size = segment.size;
+  rc.address = segment.address;
+  rc.con = networkClient_->get_connection(lane);
+  rc.src_address = networkClient_->get_user_buffer(user, segment.size,
+                                                   &rc.src_rkey);
+  if (rc.src_address != 0 && buffer != 0) {
+    networkClient_->reclaim_dram_buffer(buffer, ctx->staging_size);
+    buffer = 0;
+  } else if (rc.src_address == 0) {
+    if (buffer == 0) {
+      buffer = networkClient_->get_dram_buffer(nullptr, ctx->staging_size,
+                                               lane);
+    }
+    if (buffer == 0) {
+      transfer_done(ctx, -1, 0);
+      return;
+    }
+    if (write) {
+      memcpy(reinterpret_cast<char *>(buffer), user, segment.size);
+    }
+    rc.src_address = buffer;
+    rc.src_rkey = networkClient_->get_rkey(buffer);
+  }
+  Request request(rc);
+  requestHandler_->addTask(&request, [this, ctx, i,
+                                      buffer](RequestReplyContext &rrc) {
+    uint64_t size = ctx->segments[i].size;
+    if (buffer == 0) {
+      const char *user =
+          (ctx->type == WRITE ? ctx->src : ctx->dest) + ctx->offsets[i];
+      networkClient_->reclaim_rma_buffer((uint64_t)user, user, size);
+    } else if (ctx->type == READ && !rrc.success) {
+      memcpy(ctx->dest + ctx->offsets[i], reinterpret_cast<char *>(buffer),
+             size);
+    }
+    transfer_done(ctx, rrc.success ? -1 : 0, buffer);
+  });
+}
+
+void PmPoolClient::transfer_done(shared_ptr<TransferContext> ctx, int res,
+                                 uint64_t buffer) {
+  bool last;
+  int failed;
+  {
+    std::lock_guard<std::mutex> lk(ctx->mtx);
+    if (res) {
+      ctx->failed++;
+    }
+    last = --ctx->pending == 0;
+    failed = ctx->failed;
+  }
+  if (!last) {
+    transfer_next(ctx, buffer);
+    return;
+  }
+  if (buffer) {
+    networkClient_->reclaim_dram_buffer(buffer, ctx->staging_size);
+  }
+  ctx->func(failed ? -1 : 0);
+}
+
+int PmPoolClient::transfer(OpType type, uint64_t address, const char *src,
+                           char *dest, uint64_t size) {
+  std::promise<int> res;
+  auto future = res.get_future();
+  transfer(type, address, src, dest, size,
+           [&res](int failed) { res.set_value(failed); });
+  return future.get();
+}
+
+int PmPoolClient::batch(vector<RequestMsg> *msgs,
+                        const vector<const char *> &src,
+                        const vector<char *> &dest,
+                        vector<RequestReplyMsg> *replies) {
+  replies->resize(msgs->size());
+  int failed = 0;
+  /// large writes and reads don't fit the batch buffer, they are
+  /// transferred in segments on their own.
+  vector<uint64_t> batched;
+  for (uint64_t i = 0; i < msgs->size(); i++) {
+    RequestMsg &msg = (*msgs)[i];
+    if ((msg.type != WRITE && msg.type != READ) ||
+        msg.size <= TRANSFER_SEGMENT_SIZE) {
+      batched.push_back(i);
+      continue;
+    }
+    RequestReplyMsg &reply = (*replies)[i];
+    reply.type = msg.type | REPLY;
+    reply.size = msg.size;
+    reply.address = msg.address;
+    if (msg.type == READ) {
+      reply.success = read(msg.address, dest[i], msg.size);
+    } else if (msg.address != 0) {
+      reply.success = write(msg.address, src[i], msg.size);
+    } else {
+      reply.address = write(src[i], msg.size);
+      reply.success = reply.address == (uint64_t)-1 ? -1 : 0;
+    }
+    if (reply.success) {
+      failed++;
+    }
+  }
+  uint64_t begin = 0;
+  while (begin < batched.size()) {
+    RequestContext rc = {};
+    rc.type = BATCH;
+    rc.rid = rid_++;
+    // sub-requests of WRITE and READ share one contiguous client buffer,
+    // which is bounded by BATCH_BUFFER_SIZE.
+    uint64_t total = 0;
+    uint64_t end = begin;
+    while (end < batched.size() && end - begin < MAX_BATCH_SIZE) {
+      RequestMsg &msg = (*msgs)[batched[end]];
+      if (msg.type == WRITE || msg.type == READ) {
+        if (total + msg.size > BATCH_BUFFER_SIZE) {
+          break;
+        }
+        total += msg.size;
+      }
+      end++;
+    }
+    uint64_t buffer = 0;
+    if (total != 0) {
+      buffer = networkClient_->get_dram_buffer(nullptr, total);
+    }
+    uint64_t offset = 0;
+    vector<uint64_t> sent;
+    for (uint64_t j = begin; j < end; j++) {
+      uint64_t i = batched[j];
+      RequestMsg &msg = (*msgs)[i];
+      if ((msg.type == WRITE || msg.type == READ) && buffer == 0) {
+        // no buffer came free in time, only possible inside a callback.
+        RequestReplyMsg &reply = (*replies)[i];
+        reply.type = msg.type | REPLY;
+        reply.success = -1;
+        reply.size = msg.size;
+        reply.address = msg.type == WRITE && msg.address == 0 ? (uint64_t)-1
+                                                              : msg.address;
+        failed++;
+        continue;
+      }
+      msg.rid = sent.size();
+      sent.push_back(i);
+      if (msg.type == WRITE || msg.type == READ) {
+        msg.src_address = buffer + offset;
+        msg.src_rkey = networkClient_->get_rkey(msg.src_address);
+        if (msg.type == WRITE) {
+          memcpy(reinterpret_cast<char *>(msg.src_address), src[i], msg.size);
+        }
+        offset += msg.size;
+      }
+      rc.batch.push_back(msg);
+    }
+    begin = end;
+    if (sent.empty()) {
+      continue;
+    }
+    Request request(rc);
+    requestHandler_->addTask(&request);
+    auto rrc = requestHandler_->wait(rc.rid);
+    for (uint64_t j = 0; j < sent.size(); j++) {
+      uint64_t i = sent[j];
+      RequestReplyMsg &reply = rrc.batch[j];
+      RequestMsg &msg = (*msgs)[i];
+      if (msg.type == READ && !reply.success) {
+        memcpy(dest[i], reinterpret_cast<char *>(msg.src_address), msg.size);
+      }
+      if (reply.success) {
+        failed++;
+      }
+      (*replies)[i] = reply;
+    }
+    if (buffer != 0) {
+      networkClient_->reclaim_dram_buffer(buffer, total);
+    }
+  }
+  return failed;
+}
+
+int PmPoolClient::alloc(const vector<uint64_t> &sizes,
+                        vector<uint64_t> *addresses) {
+  vector<RequestMsg> msgs(sizes.size());
+  for (uint64_t i = 0; i < sizes.size(); i++) {
+    msgs[i].type = ALLOC;
+    msgs[i].size = sizes[i];
+  }
+  vector<RequestReplyMsg> replies;
+  int res = batch(&msgs, {}, {}, &replies);
+  addresses->resize(replies.size());
+  for (uint64_t i = 0; i < replies.size(); i++) {
+    (*addresses)[i] = replies[i].address;
+  }
+  return res;
+}
+
+int PmPoolClient::free(const vector<uint64_t> &addresses) {
+  vector<RequestMsg> msgs(addresses.size());
+  for (uint64_t i = 0; i < addresses.size(); i++) {
+    msgs[i].type = FREE;
+    msgs[i].address = addresses[i];
+  }
+  vector<RequestReplyMsg> replies;
+  return batch(&msgs, {}, {}, &replies);
+}
+
+int PmPoolClient::write(const vector<uint64_t> &addresses,
+                        const vector<const char *> &data,
+                        const vector<uint64_t> &sizes) {
+  assert(addresses.size() == data.size() && data.size() == sizes.size());
+  vector<RequestMsg> msgs(addresses.size());
+  for (uint64_t i = 0; i < addresses.size(); i++) {
+    msgs[i].type = WRITE;
+    msgs[i].address = addresses[i];
+    msgs[i].size = sizes[i];
+  }
+  vector<RequestReplyMsg> replies;
+  return batch(&msgs, data, {}, &replies);
+}
+
+int PmPoolClient::write(const vector<const char *> &data,
+                        const vector<uint64_t> &sizes,
+                        vector<uint64_t> *addresses) {
+  assert(data.size() == sizes.size());
+  vector<RequestMsg> msgs(data.size());
+  for (uint64_t i = 0; i < data.size(); i++) {
+    msgs[i].type = WRITE;
+    msgs[i].address = 0;
+    msgs[i].size = sizes[i];
+  }
+  vector<RequestReplyMsg> replies;
+  int res = batch(&msgs, data, {}, &replies);
+  addresses->resize(replies.size());
+  for (uint64_t i = 0; i < replies.size(); i++) {
+    (*addresses)[i] = replies[i].address;
+  }
+  return res;
+}
+
+int PmPoolClient::read(const vector<uint64_t> &addresses,
+                       const vector<char *> &data,
+                       const vector<uint64_t> &sizes) {
+  assert(addresses.size() == data.size() && data.size() == sizes.size());
+  vector<RequestMsg> msgs(addresses.size());
+  for (uint64_t i = 0; i < addresses.size(); i++) {
+    msgs[i].type = READ;
+    msgs[i].address = addresses[i];
+    msgs[i].size = sizes[i];
+  }
+  vector<RequestReplyMsg> replies;
+  return batch(&msgs, {}, data, &replies);
+}
+
 void PmPoolClient::end_tx() {
   std::lock_guard<std::mutex> lk(tx_mtx);
   tx_finished = true;
@@ -144,6 +672,13 @@ void PmPoolClient::end_tx() {
 
 uint64_t PmPoolClient::put(const string &key, const char *value,
                            uint64_t size) {
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    std::promise<uint64_t> res;
+    auto future = res.get_future();
+    put(key, value, size,
+        [&res](uint64_t address) { res.set_value(address); });
+    return future.get();
+  }
   uint64_t key_uint;
   Digest::computeKeyHash(key, &key_uint);
   RequestContext rc = {};
@@ -152,17 +687,85 @@ uint64_t PmPoolClient::put(const string &key, const char *value,
   rc.size = size;
   rc.address = 0;
   // allocate memory for RMA read from client.
-  rc.src_address = networkClient_->get_dram_buffer(value, rc.size);
-  rc.src_rkey = networkClient_->get_rkey();
+  rc.src_address = networkClient_->get_rma_buffer(value, rc.size, true,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    return -1;
+  }
   rc.key = key_uint;
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  auto address = requestHandler_->get().address;
-  networkClient_->reclaim_dram_buffer(rc.src_address, rc.size);
+  auto address = requestHandler_->wait(rc.rid).address;
+  networkClient_->reclaim_rma_buffer(rc.src_address, value, rc.size);
   return address;
 }
 
+int PmPoolClient::put(const string &key, const char *value, uint64_t size,
+                      std::function<void(uint64_t)> func) {
+  uint64_t key_uint;
+  Digest::computeKeyHash(key, &key_uint);
+  /// a large value is written to one block first, so the key never holds a
+  /// partly written value.
+  if (size > TRANSFER_SEGMENT_SIZE) {
+    alloc(size, [this, key_uint, value, size, func](uint64_t address) {
+      if (address == (uint64_t)-1) {
+        func(address);
+        return;
+      }
+      transfer(WRITE, address, value, nullptr, size, [=](int res) {
+        if (res) {
+          this->free(address, [](int) {});
+          func(-1);
+          return;
+        }
+        put_block(key_uint, address, size, [=](uint64_t block) {
+          if (block == (uint64_t)-1) {
+            this->free(address, [](int) {});
+          }
+          func(block);
+        });
+      });
+    });
+    return 0;
+  }
+  RequestContext rc = {};
+  rc.type = PUT;
+  rc.rid = rid_++;
+  rc.size = size;
+  rc.address = 0;
+  // allocate memory for RMA read from client.
+  rc.src_address = networkClient_->get_rma_buffer(value, rc.size, true,
+                                                   &rc.src_rkey);
+  if (rc.src_address == 0) {
+    func(-1);
+    return 0;
+  }
+  rc.key = key_uint;
+  Request request(rc);
+  auto networkClient = networkClient_;
+  uint64_t src_address = rc.src_address;
+  requestHandler_->addTask(&request, [=](RequestReplyContext &rrc) {
+    networkClient->reclaim_rma_buffer(src_address, value, size);
+    func(rrc.address);
+  });
+  return 0;
+}
+
+void PmPoolClient::put_block(uint64_t key, uint64_t address, uint64_t size,
+                             std::function<void(uint64_t)> func) {
+  /// a PUT with an address but no source carries no data.
+  RequestContext rc = {};
+  rc.type = PUT;
+  rc.rid = rid_++;
+  rc.size = size;
+  rc.address = address;
+  rc.key = key;
+  Request request(rc);
+  requestHandler_->addTask(&request, [func](RequestReplyContext &rrc) {
+    func(rrc.success ? -1 : rrc.address);
+  });
+}
+
 vector<block_meta> PmPoolClient::get(const string &key) {
   uint64_t key_uint;
   Digest::computeKeyHash(key, &key_uint);
@@ -173,9 +776,77 @@ vector<block_meta> PmPoolClient::get(const string &key) {
   rc.key = key_uint;
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  auto bml = requestHandler_->get().bml;
-  return bml;
+  return requestHandler_->wait(rc.rid).bml;
+}
+
+uint64_t PmPoolClient::get(const string &key, char *data, uint64_t size) {
+  uint64_t key_uint;
+  Digest::computeKeyHash(key, &key_uint);
+  RequestContext rc = {};
+  rc.type = GET;
+  rc.rid = rid_++;
+  rc.key = key_uint;
+  /// a registered buffer takes a value of any size in one round trip, a
+  /// client buffer takes up to a segment.
+  rc.size = size;
+  rc.src_address = networkClient_->get_user_buffer(data, size, &rc.src_rkey);
+  bool staged = rc.src_address == 0;
+  if (staged) {
+    rc.size = std::min<uint64_t>(size, TRANSFER_SEGMENT_SIZE);
+    rc.src_address = networkClient_->get_dram_buffer(nullptr, rc.size);
+    if (rc.src_address == 0) {
+      return -1;
+    }
+    rc.src_rkey = networkClient_->get_rkey(rc.src_address);
+  }
+  Request request(rc);
+  requestHandler_->addTask(&request);
+  auto rrc = requestHandler_->wait(rc.rid);
+  uint64_t res = -1;
+  if (!rrc.success) {
+    if (staged) {
+      memcpy(data, reinterpret_cast<char *>(rc.src_address), rrc.size);
+    }
+    res = rrc.size;
+  }
+  if (staged) {
+    networkClient_->reclaim_dram_buffer(rc.src_address, rc.size);
+  } else {
+    networkClient_->reclaim_rma_buffer(rc.src_address, data, size);
+  }
+  /// the reply carries the size of a value that didn't fit, if it only
+  /// exceeds the client buffer its blocks are read in segments.
+  if (!rrc.success || !staged || rrc.size <= rc.size || rrc.size > size) {
+    return res;
+  }
+  vector<block_meta> bml = get(key);
+  uint64_t total = 0;
+  for (auto &bm : bml) {
+    total += bm.size;
+  }
+  if (total > size) {
+    return -1;
+  }
+  std::promise<int> failed;
+  auto future = failed.get_future();
+  transfer(READ, bml, nullptr, data,
+           [&failed](int res) { failed.set_value(res); });
+  return future.get() ? -1 : total;
+}
+
+int PmPoolClient::get(const string &key,
+                      std::function<void(vector<block_meta> &)> func) {
+  uint64_t key_uint;
+  Digest::computeKeyHash(key, &key_uint);
+  RequestContext rc = {};
+  rc.type = GET_META;
+  rc.rid = rid_++;
+  rc.address = 0;
+  rc.key = key_uint;
+  Request request(rc);
+  requestHandler_->addTask(
+      &request, [func](RequestReplyContext &rrc) { func(rrc.bml); });
+  return 0;
 }
 
 int PmPoolClient::del(const string &key) {
@@ -187,7 +858,39 @@ int PmPoolClient::del(const string &key) {
   rc.key = key_uint;
   Request request(rc);
   requestHandler_->addTask(&request);
-  requestHandler_->wait();
-  auto res = requestHandler_->get().success;
-  return res;
+  return requestHandler_->wait(rc.rid).success;
+}
+
+int PmPoolClient::del(const string &key, std::function<void(int)> func) {
+  uint64_t key_uint;
+  Digest::computeKeyHash(key, &key_uint);
+  RequestContext rc = {};
+  rc.type = DELETE;
+  rc.rid = rid_++;
+  rc.key = key_uint;
+  Request request(rc);
+  requestHandler_->addTask(
+      &request, [func](RequestReplyContext &rrc) { func(rrc.success); });
+  return 0;
+}
+
+int PmPoolClient::stats(PmPoolStats *stats) {
+  RequestContext rc = {};
+  rc.type = STATS;
+  rc.rid = rid_++;
+  Request request(rc);
+  requestHandler_->addTask(&request);
+  auto rrc = requestHandler_->wait(rc.rid);
+  uint64_t size = sizeof(server_stats) + rrc.size * sizeof(pool_stats);
+  if (rrc.success || rrc.stats.size() * sizeof(uint64_t) != size) {
+    return -1;
+  }
+  const char *data = reinterpret_cast<const char *>(rrc.stats.data());
+  memcpy(&stats->server, data, sizeof(server_stats));
+  stats->pools.resize(rrc.size);
+  if (rrc.size != 0) {
+    memcpy(&stats->pools[0], data + sizeof(server_stats),
+           rrc.size * sizeof(pool_stats));
+  }
+  return 0;
 }
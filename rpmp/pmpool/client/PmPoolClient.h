@@ -11,6 +11,13 @@
 #define PMPOOL_CLIENT_PMPOOLCLIENT_H_
 
 #define INITIAL_BUFFER_NUMBER 64
+#define DEFAULT_MAX_INFLIGHT 64
+/// bounded by the largest client buffer, a segment of its BufferPool.
+#define BATCH_BUFFER_SIZE (16 * 1024 * 1024)
+/// larger transfers are split into segments of this size.
+#define TRANSFER_SEGMENT_SIZE (4 * 1024 * 1024)
+/// segments of one transfer in flight, bounds its staging memory.
+#define TRANSFER_WINDOW 8
 
 #include <HPNL/Callback.h>
 #include <HPNL/ChunkMgr.h>
@@ -31,11 +38,13 @@
 
 #include "../Base.h"
 #include "../Common.h"
+#include "../Event.h"
 #include "../ThreadWrapper.h"
 
 class NetworkClient;
 class RequestHandler;
 class Function;
+struct TransferContext;
 
 using std::atomic;
 using std::make_shared;
@@ -43,12 +52,71 @@ using std::shared_ptr;
 using std::string;
 using std::vector;
 
+/// snapshot of the server taken by PmPoolClient::stats.
+struct PmPoolStats {
+  server_stats server;
+  vector<pool_stats> pools;
+
+  /// requests of the type per second between an earlier snapshot and this.
+  double ops_per_sec(const PmPoolStats &prev, OpType type) const {
+    return rate(prev, server.ops[type].ops - prev.server.ops[type].ops);
+  }
+  /// bytes transferred by requests of the type per second.
+  double bytes_per_sec(const PmPoolStats &prev, OpType type) const {
+    return rate(prev, server.ops[type].bytes - prev.server.ops[type].bytes);
+  }
+  /// share of the free space of the pool that lies outside its largest free
+  /// block, 0 if the free space is contiguous.
+  double fragmentation(int pool) const {
+    uint64_t free = pools[pool].capacity - pools[pool].used;
+    return free ? 1 - pools[pool].largest_free / (double)free : 0;
+  }
+
+ private:
+  double rate(const PmPoolStats &prev, uint64_t delta) const {
+    uint64_t ns = server.uptime - prev.server.uptime;
+    return ns ? delta * 1e9 / ns : 0;
+  }
+};
+
+/**
+ * @brief PmPoolClient is the client of RPMP. Every request is tracked by its
+ * request id, so the synchronous interfaces are safe to be called from
+ * multiple threads, and the asynchronous interfaces, which take a callback,
+ * keep up to max_inflight requests in flight over one connection.
+ * Callbacks are invoked from the network thread, they must not block on
+ * another request of the same client.
+ * Objects larger than TRANSFER_SEGMENT_SIZE are transferred in segments,
+ * up to TRANSFER_WINDOW of them in flight, so that the RDMA of a segment
+ * overlaps the copy of the previous ones to PMem on the server. Every
+ * segment after the first TRANSFER_WINDOW is issued from the completion of
+ * an earlier one, so the asynchronous interfaces never wait and may be
+ * called from callbacks. With striping enabled, segments are spread round
+ * robin over the connections.
+ */
 class PmPoolClient {
  public:
   PmPoolClient() = delete;
   PmPoolClient(const string &remote_address, const string &remote_port);
+  /// connection_num is the number of connections (lanes) to the server,
+  /// max_inflight bounds the number of requests in flight,
+  /// busy_poll makes synchronous interfaces spin on completion instead of
+  /// sleeping on a condition variable.
+  PmPoolClient(const string &remote_address, const string &remote_port,
+               int connection_num, int max_inflight, bool busy_poll);
   ~PmPoolClient();
   int init();
+  /// spread the segments of large transfers over all connections instead of
+  /// the connection of the calling thread.
+  void set_striping(bool striping);
+
+  /// Register a long-lived buffer of the application. Writes from and reads
+  /// into it are RDMA'ed directly instead of through the client buffer. The
+  /// buffer must stay valid until it is unregistered.
+  /// Return 0 if succeed, return -1 if it overlaps a registered buffer.
+  int register_buffer(const char *data, uint64_t size);
+  /// Return -1 if the buffer is unknown or still in use by a transfer.
+  int unregister_buffer(const char *data);
 
   /// memory pool interface
   void begin_tx();
@@ -56,36 +124,130 @@ class PmPoolClient {
   /// Return the global address of memory pool.
   uint64_t alloc(uint64_t size);
 
+  /// Asynchronous version of alloc, func is called with the global address.
+  /// Return 0 if the request is issued.
+  int alloc(uint64_t size, std::function<void(uint64_t)> func);
+
   /// Free memory with the global address.
   /// Address is the global address that returned by alloc.
   /// Return 0 if succeed, return others value if fail.
   int free(uint64_t address);
 
+  /// Asynchronous version of free, func is called with the result.
+  int free(uint64_t address, std::function<void(int)> func);
+
   /// Write data to the address of remote memory pool.
   /// The size is number of bytes
   /// Return 0 if succeed, return others value if fail.
   int write(uint64_t address, const char *data, uint64_t size);
 
+  /// Asynchronous version of write, func is called with the result. data
+  /// can be reused once the call returns, unless it is larger than
+  /// TRANSFER_SEGMENT_SIZE, then it must stay valid until func is called.
+  int write(uint64_t address, const char *data, uint64_t size,
+            std::function<void(int)> func);
+
   /// Return global address if succeed, return -1 if fail.
   uint64_t write(const char *data, uint64_t size);
 
+  /// Asynchronous version of allocate and write,
+  /// func is called with the global address, or -1 if fail. data larger
+  /// than TRANSFER_SEGMENT_SIZE must stay valid until func is called.
+  int write(const char *data, uint64_t size,
+            std::function<void(uint64_t)> func);
+
   /// Read from the global address of remote memory pool and copy to data
   /// pointer.
   /// Return 0 if succeed, return others value if fail.
   int read(uint64_t address, char *data, uint64_t size);
 
+  /// Asynchronous version of read, data must stay valid until func is called
+  /// with the result.
   int read(uint64_t address, char *data, uint64_t size,
            std::function<void(int)> func);
   void end_tx();
 
+  /// Batched interfaces, operations are sent in BATCH requests of up to
+  /// MAX_BATCH_SIZE sub-requests, each answered by a single reply. Writes
+  /// and reads larger than TRANSFER_SEGMENT_SIZE are sent on their own.
+  /// Return 0 if all operations succeed, return the number of failed
+  /// operations otherwise.
+  int alloc(const vector<uint64_t> &sizes, vector<uint64_t> *addresses);
+  int free(const vector<uint64_t> &addresses);
+  int write(const vector<uint64_t> &addresses, const vector<const char *> &data,
+            const vector<uint64_t> &sizes);
+  int write(const vector<const char *> &data, const vector<uint64_t> &sizes,
+            vector<uint64_t> *addresses);
+  int read(const vector<uint64_t> &addresses, const vector<char *> &data,
+           const vector<uint64_t> &sizes);
+
+  /// Arena interfaces, for data that is written once and dropped all
+  /// together. arena is chosen by the caller and must not be NO_ARENA.
+  /// Blocks are bump allocated from the arena, freeing a single block of an
+  /// arena has no effect until the whole arena is freed.
+  /// Return the global address if succeed, return -1 if fail.
+  uint64_t alloc_in_arena(uint64_t arena, uint64_t size);
+  uint64_t write_in_arena(uint64_t arena, const char *data, uint64_t size);
+  /// Free every block of the arena on all pools.
+  /// Return 0 if succeed, return others value if fail.
+  int free_arena(uint64_t arena);
+
   /// key-value storage interface
+  /// Append value to the key as a new block. A value larger than
+  /// TRANSFER_SEGMENT_SIZE is written to its block in pipelined segments,
+  /// the block is added to the key only once all of them succeeded.
+  /// Return the global address of the block, return -1 if fail.
   uint64_t put(const string &key, const char *value, uint64_t size);
+  /// Asynchronous version of put, func is called with the global address or
+  /// -1. A value larger than TRANSFER_SEGMENT_SIZE must stay valid until
+  /// func is called.
+  int put(const string &key, const char *value, uint64_t size,
+          std::function<void(uint64_t)> func);
   vector<block_meta> get(const string &key);
+  /// Read all blocks of key into data in one round trip, the blocks are
+  /// placed back to back in the order they were put. Only a value larger
+  /// than TRANSFER_SEGMENT_SIZE read into an unregistered buffer takes
+  /// more: its block list is fetched and the blocks are read in pipelined
+  /// segments.
+  /// Return the number of bytes read, return -1 if fail, if the key does not
+  /// exist or if size is smaller than the total size of the blocks.
+  uint64_t get(const string &key, char *data, uint64_t size);
+  int get(const string &key, std::function<void(vector<block_meta> &)> func);
   int del(const string &key);
+  int del(const string &key, std::function<void(int)> func);
+
+  /// Take a snapshot of the capacity, queues and throughput of the server.
+  /// Return 0 if succeed, return -1 if fail.
+  int stats(PmPoolStats *stats);
 
   void shutdown();
   void wait();
 
+ private:
+  /// WRITE or READ the blocks in segments, from src or to dest, which hold
+  /// the blocks back to back. func is called with 0 once all segments
+  /// succeeded, -1 otherwise.
+  void transfer(OpType type, const vector<block_meta> &blocks,
+                const char *src, char *dest, std::function<void(int)> func);
+  void transfer(OpType type, uint64_t address, const char *src, char *dest,
+                uint64_t size, std::function<void(int)> func);
+  int transfer(OpType type, uint64_t address, const char *src, char *dest,
+               uint64_t size);
+  /// issue the next segment of the transfer, staged in the client buffer
+  /// handed on by a completed segment unless buffer is 0.
+  void transfer_next(shared_ptr<TransferContext> ctx, uint64_t buffer);
+  /// complete a segment with res, then issue the next one.
+  void transfer_done(shared_ptr<TransferContext> ctx, int res,
+                     uint64_t buffer);
+  /// record a block the client already wrote under the key, func is called
+  /// with the global address of the block or -1.
+  void put_block(uint64_t key, uint64_t address, uint64_t size,
+                 std::function<void(uint64_t)> func);
+  /// send msgs as BATCH requests and collect one reply per msg.
+  /// data is copied to or from the client buffer for WRITE and READ.
+  int batch(vector<RequestMsg> *msgs, const vector<const char *> &src,
+            const vector<char *> &dest, vector<RequestReplyMsg> *replies);
+
  private:
   shared_ptr<RequestHandler> requestHandler_;
   shared_ptr<NetworkClient> networkClient_;
@@ -95,6 +257,7 @@ class PmPoolClient {
   bool tx_finished;
   std::mutex op_mtx;
   bool op_finished;
+  bool striping_ = false;
 };
 
 #endif  // PMPOOL_CLIENT_PMPOOLCLIENT_H_
@@ -29,6 +29,15 @@ public class PmPoolClient {
         return write_(address, data, size, objectId);
     }
 
+    /**
+     * Write size bytes of a direct ByteBuffer to the remote address. Unlike
+     * the String variant the data is binary-safe and is not copied on the
+     * JVM side; a registered buffer is not copied on the native side either.
+     */
+    public int write(long address, ByteBuffer data, long size) {
+        return writeBuffer_(address, data, size, objectId);
+    }
+
     public long write(String data, long size) {
         return alloc_and_write_(data, size, objectId);
     }
@@ -41,6 +50,19 @@ public class PmPoolClient {
         return read_(address, size, byteBuffer, objectId);
     }
 
+    /**
+     * Register a long-lived direct ByteBuffer so that reads into and writes
+     * from it are RDMA'ed directly. Keep a reference to the buffer until it
+     * is unregistered.
+     */
+    public int registerBuffer(ByteBuffer byteBuffer) {
+        return registerBuffer_(byteBuffer, objectId);
+    }
+
+    public int unregisterBuffer(ByteBuffer byteBuffer) {
+        return unregisterBuffer_(byteBuffer, objectId);
+    }
+
     public long put(String key, ByteBuffer data, long size) {
         return put(key, data, size, objectId);
     }
@@ -53,6 +75,15 @@ public class PmPoolClient {
         return del(key, objectId);
     }
 
+    /**
+     * Take a snapshot of the capacity, queues and throughput of the server,
+     * null if the request failed.
+     */
+    public PmPoolStats stats() {
+        long[] words = stats_(objectId);
+        return words == null ? null : new PmPoolStats(words);
+    }
+
     public void shutdown() {
         shutdown_(objectId);
     }
@@ -97,6 +128,8 @@ public class PmPoolClient {
 
     private native int write_(long address, String data, long size, long objectId);
 
+    private native int writeBuffer_(long address, ByteBuffer data, long size, long objectId);
+
     private native long alloc_and_write_(String data, long size, long objectId);
 
     private native long alloc_and_write_(ByteBuffer data, long size, long objectId);
@@ -109,6 +142,12 @@ public class PmPoolClient {
 
     private native int read_(long address, long size, ByteBuffer byteBuffer, long objectId);
 
+    private native int registerBuffer_(ByteBuffer byteBuffer, long objectId);
+
+    private native int unregisterBuffer_(ByteBuffer byteBuffer, long objectId);
+
+    private native long[] stats_(long objectId);
+
     private native void shutdown_(long objectId);
 
     private native void waitToStop_(long objectId);
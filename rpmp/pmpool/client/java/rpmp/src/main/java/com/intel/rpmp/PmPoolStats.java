@@ -0,0 +1,116 @@
+package com.intel.rpmp;
+
+/**
+ * PmPoolStats is a snapshot of the server taken by PmPoolClient.stats(). It
+ * decodes the words of a STATS reply, a server_stats followed by one
+ * pool_stats per pool. Counters are totals since the server started, rates
+ * are taken between two snapshots.
+ */
+public class PmPoolStats {
+    /** request types, as OpType of the native client. */
+    public static final int ALLOC = 1;
+    public static final int FREE = 2;
+    public static final int WRITE = 4;
+    public static final int READ = 5;
+    public static final int PUT = 6;
+    public static final int GET = 7;
+    public static final int GET_META = 8;
+    public static final int DELETE = 9;
+    public static final int BATCH = 10;
+    public static final int FREE_ARENA = 11;
+    public static final int STATS = 12;
+
+    private static final int OP_NUM = 16;
+    private static final int OPS_OFFSET = 5;
+    private static final int SERVER_WORDS = OPS_OFFSET + 2 * OP_NUM;
+    private static final int POOL_WORDS = 5;
+
+    PmPoolStats(long[] words) {
+        this.words = words;
+    }
+
+    /** nanoseconds since the server started. */
+    public long uptime() {
+        return words[0];
+    }
+
+    public long finalizeQueueDepth() {
+        return words[1];
+    }
+
+    /** bytes of the network buffer pool that are mapped, and in use. */
+    public long bufferMapped() {
+        return words[2];
+    }
+
+    public long bufferUsed() {
+        return words[3];
+    }
+
+    public long bufferWaits() {
+        return words[4];
+    }
+
+    public long ops(int type) {
+        return words[OPS_OFFSET + 2 * type];
+    }
+
+    public long bytes(int type) {
+        return words[OPS_OFFSET + 2 * type + 1];
+    }
+
+    public double opsPerSecond(PmPoolStats prev, int type) {
+        return rate(prev, ops(type) - prev.ops(type));
+    }
+
+    public double bytesPerSecond(PmPoolStats prev, int type) {
+        return rate(prev, bytes(type) - prev.bytes(type));
+    }
+
+    public int poolNum() {
+        return (words.length - SERVER_WORDS) / POOL_WORDS;
+    }
+
+    public long capacity(int pool) {
+        return poolWord(pool, 0);
+    }
+
+    public long usedBytes(int pool) {
+        return poolWord(pool, 1);
+    }
+
+    public long freeBytes(int pool) {
+        return capacity(pool) - usedBytes(pool);
+    }
+
+    /** largest block that can still be allocated from the pool. */
+    public long largestFree(int pool) {
+        return poolWord(pool, 2);
+    }
+
+    /** share of the free space outside the largest free block. */
+    public double fragmentation(int pool) {
+        long free = freeBytes(pool);
+        return free == 0 ? 0 : 1 - (double) largestFree(pool) / free;
+    }
+
+    public long blocks(int pool) {
+        return poolWord(pool, 3);
+    }
+
+    /** requests and RDMA completions waiting for the workers of the pool. */
+    public long queueDepth(int pool) {
+        return poolWord(pool, 4);
+    }
+
+    private long poolWord(int pool, int index) {
+        return words[SERVER_WORDS + pool * POOL_WORDS + index];
+    }
+
+    private double rate(PmPoolStats prev, long delta) {
+        long ns = uptime() - prev.uptime();
+        return ns == 0 ? 0 : delta * 1e9 / ns;
+    }
+
+    private final long[] words;
+}
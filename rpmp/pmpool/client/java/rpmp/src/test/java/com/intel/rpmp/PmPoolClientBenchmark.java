@@ -0,0 +1,73 @@
+package com.intel.rpmp;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Compares the write and read paths of the Java client end to end.
+ * You need to start rpmp service before running it:
+ *   java com.intel.rpmp.PmPoolClientBenchmark [host] [port] [size] [count]
+ */
+public class PmPoolClientBenchmark
+{
+    public static void main(String[] args) {
+        String host = args.length > 0 ? args[0] : "172.168.0.40";
+        String port = args.length > 1 ? args[1] : "12346";
+        int size = args.length > 2 ? Integer.parseInt(args[2]) : 1024 * 1024;
+        int count = args.length > 3 ? Integer.parseInt(args[3]) : 1000;
+
+        PmPoolClient client = new PmPoolClient(host, port);
+        long address = client.alloc(size);
+
+        char[] chars = new char[size];
+        java.util.Arrays.fill(chars, 'a');
+        String string = new String(chars);
+        ByteBuffer buffer = ByteBuffer.allocateDirect(size);
+        while (buffer.hasRemaining()) {
+            buffer.put((byte) 'a');
+        }
+
+        long start = System.nanoTime();
+        for (int i = 0; i < count; i++) {
+            client.write(address, string, size);
+        }
+        report("string write", size, count, System.nanoTime() - start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < count; i++) {
+            client.write(address, buffer, size);
+        }
+        report("direct write", size, count, System.nanoTime() - start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < count; i++) {
+            client.read(address, size, buffer);
+        }
+        report("direct read", size, count, System.nanoTime() - start);
+
+        client.registerBuffer(buffer);
+        start = System.nanoTime();
+        for (int i = 0; i < count; i++) {
+            client.write(address, buffer, size);
+        }
+        report("registered write", size, count, System.nanoTime() - start);
+
+        start = System.nanoTime();
+        for (int i = 0; i < count; i++) {
+            client.read(address, size, buffer);
+        }
+        report("registered read", size, count, System.nanoTime() - start);
+        client.unregisterBuffer(buffer);
+
+        client.free(address);
+        client.shutdown();
+        client.waitToStop();
+        client.dispose();
+    }
+
+    private static void report(String name, int size, int count, long nanos) {
+        double seconds = nanos / 1e9;
+        System.out.printf("%-16s %10.1f MB/s %10.1f us/op%n", name,
+                (double) size * count / seconds / 1024 / 1024,
+                nanos / 1e3 / count);
+    }
+}
@@ -17,9 +17,7 @@ JNIEXPORT jlong JNICALL Java_com_intel_rpmp_PmPoolClient_newPmPoolClient_1(
   const char *remote_port = env->GetStringUTFChars(port, 0);
 
   PmPoolClient *client = new PmPoolClient(remote_address, remote_port);
-  client->begin_tx();
   client->init();
-  client->end_tx();
 
   env->ReleaseStringUTFChars(address, remote_address);
   env->ReleaseStringUTFChars(port, remote_port);
@@ -30,9 +28,7 @@ JNIEXPORT jlong JNICALL Java_com_intel_rpmp_PmPoolClient_newPmPoolClient_1(
 JNIEXPORT jlong JNICALL Java_com_intel_rpmp_PmPoolClient_alloc_1(
     JNIEnv *env, jobject obj, jlong size, jlong objectId) {
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   uint64_t address = client->alloc(size);
-  client->end_tx();
   return address;
 }
 
@@ -41,9 +37,7 @@ JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_free_1(JNIEnv *env,
                                                                jlong address,
                                                                jlong objectId) {
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   int success = client->free(address);
-  client->end_tx();
   return success;
 }
 
@@ -53,23 +47,31 @@ JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_write_1(
   const char *raw_data = env->GetStringUTFChars(data, 0);
 
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   int success = client->write(address, raw_data, size);
-  client->end_tx();
 
   env->ReleaseStringUTFChars(data, raw_data);
 
   return success;
 }
+JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_writeBuffer_1(
+    JNIEnv *env, jobject obj, jlong address, jobject data, jlong size,
+    jlong objectId) {
+  char *raw_data = static_cast<char *>((*env).GetDirectBufferAddress(data));
+  if (raw_data == nullptr || size > (*env).GetDirectBufferCapacity(data)) {
+    return -1;
+  }
+  PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
+  int success = client->write(address, raw_data, size);
+  return success;
+}
+
 JNIEXPORT jlong JNICALL
 Java_com_intel_rpmp_PmPoolClient_alloc_1and_1write_1__Ljava_lang_String_2JJ(
     JNIEnv *env, jobject obj, jstring data, jlong size, jlong objectId) {
   const char *raw_data = env->GetStringUTFChars(data, 0);
 
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   uint64_t address = client->write(raw_data, size);
-  client->end_tx();
 
   env->ReleaseStringUTFChars(data, raw_data);
   return address;
@@ -80,9 +82,8 @@ Java_com_intel_rpmp_PmPoolClient_alloc_1and_1write_1__Ljava_nio_ByteBuffer_2JJ(
     JNIEnv *env, jobject obj, jobject data, jlong size, jlong objectId) {
   char *raw_data = static_cast<char *>((*env).GetDirectBufferAddress(data));
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   uint64_t address = client->write(raw_data, size);
-  client->end_tx();
+  return address;
 }
 
 JNIEXPORT jlong JNICALL
@@ -91,9 +92,7 @@ Java_com_intel_rpmp_PmPoolClient_put(JNIEnv *env, jobject obj, jstring key,
   char *raw_data = static_cast<char *>((*env).GetDirectBufferAddress(data));
   const char *raw_key = env->GetStringUTFChars(key, 0);
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   auto address = client->put(raw_key, raw_data, size);
-  client->end_tx();
   env->ReleaseStringUTFChars(key, raw_key);
   return address;
 }
@@ -102,9 +101,7 @@ JNIEXPORT jlongArray JNICALL Java_com_intel_rpmp_PmPoolClient_getMeta(
     JNIEnv *env, jobject obj, jstring key, jlong objectId) {
   const char *raw_key = env->GetStringUTFChars(key, 0);
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   auto bml = client->get(raw_key);
-  client->end_tx();
   env->ReleaseStringUTFChars(key, raw_key);
   int longCArraySize = bml.size() * 2;
   jlongArray longJavaArray = env->NewLongArray(longCArraySize);
@@ -131,9 +128,7 @@ JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_del(JNIEnv *env,
                                                             jlong objectId) {
   const char *raw_key = env->GetStringUTFChars(key, 0);
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   int res = client->del(raw_key);
-  client->end_tx();
   env->ReleaseStringUTFChars(key, raw_key);
   return res;
 }
@@ -143,12 +138,56 @@ JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_read_1(
     jlong objectId) {
   char *raw_data = static_cast<char *>((*env).GetDirectBufferAddress(data));
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
-  client->begin_tx();
   int success = client->read(address, raw_data, size);
-  client->end_tx();
   return success;
 }
 
+JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_registerBuffer_1(
+    JNIEnv *env, jobject obj, jobject data, jlong objectId) {
+  char *raw_data = static_cast<char *>((*env).GetDirectBufferAddress(data));
+  if (raw_data == nullptr) {
+    return -1;
+  }
+  PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
+  return client->register_buffer(raw_data,
+                                 (*env).GetDirectBufferCapacity(data));
+}
+
+JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_unregisterBuffer_1(
+    JNIEnv *env, jobject obj, jobject data, jlong objectId) {
+  char *raw_data = static_cast<char *>((*env).GetDirectBufferAddress(data));
+  if (raw_data == nullptr) {
+    return -1;
+  }
+  PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
+  return client->unregister_buffer(raw_data);
+}
+
+/// the words of server_stats followed by those of every pool_stats.
+JNIEXPORT jlongArray JNICALL Java_com_intel_rpmp_PmPoolClient_stats_1(
+    JNIEnv *env, jobject obj, jlong objectId) {
+  PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
+  PmPoolStats stats;
+  if (client->stats(&stats)) {
+    return nullptr;
+  }
+  int server_words = sizeof(server_stats) / sizeof(jlong);
+  int pool_words = sizeof(pool_stats) / sizeof(jlong);
+  jlongArray longJavaArray =
+      env->NewLongArray(server_words + stats.pools.size() * pool_words);
+  if (longJavaArray == nullptr) {
+    return nullptr;
+  }
+  env->SetLongArrayRegion(longJavaArray, 0, server_words,
+                          reinterpret_cast<jlong *>(&stats.server));
+  for (uint64_t i = 0; i < stats.pools.size(); i++) {
+    env->SetLongArrayRegion(longJavaArray, server_words + i * pool_words,
+                            pool_words,
+                            reinterpret_cast<jlong *>(&stats.pools[i]));
+  }
+  return longJavaArray;
+}
+
 JNIEXPORT void JNICALL Java_com_intel_rpmp_PmPoolClient_shutdown_1(
     JNIEnv *env, jobject obj, jlong objectId) {
   PmPoolClient *client = reinterpret_cast<PmPoolClient *>(objectId);
@@ -52,6 +52,14 @@ JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_write_1(JNIEnv *,
                                                                 jstring, jlong,
                                                                 jlong);
 
+/*
+ * Class:     com_intel_rpmp_PmPoolClient
+ * Method:    writeBuffer_
+ * Signature: (JLjava/nio/ByteBuffer;JJ)I
+ */
+JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_writeBuffer_1(
+    JNIEnv *, jobject, jlong, jobject, jlong, jlong);
+
 /*
  * Class:     com_intel_rpmp_PmPoolClient
  * Method:    alloc_and_write_
@@ -107,6 +115,31 @@ JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_read_1(JNIEnv *,
                                                                jlong, jobject,
                                                                jlong);
 
+/*
+ * Class:     com_intel_rpmp_PmPoolClient
+ * Method:    registerBuffer_
+ * Signature: (Ljava/nio/ByteBuffer;J)I
+ */
+JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_registerBuffer_1(
+    JNIEnv *, jobject, jobject, jlong);
+
+/*
+ * Class:     com_intel_rpmp_PmPoolClient
+ * Method:    unregisterBuffer_
+ * Signature: (Ljava/nio/ByteBuffer;J)I
+ */
+JNIEXPORT jint JNICALL Java_com_intel_rpmp_PmPoolClient_unregisterBuffer_1(
+    JNIEnv *, jobject, jobject, jlong);
+
+/*
+ * Class:     com_intel_rpmp_PmPoolClient
+ * Method:    stats_
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_com_intel_rpmp_PmPoolClient_stats_1(JNIEnv *,
+                                                                     jobject,
+                                                                     jlong);
+
 /*
  * Class:     com_intel_rpmp_PmPoolClient
  * Method:    shutdown_
@@ -0,0 +1,164 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/BufferPoolTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Friday, March 27th 2020, 1:21:05 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <string.h>
+
+#include <set>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/WorkerQueue.h"
+#include "../pmpool/buffer/BufferPool.h"
+#include "gtest/gtest.h"
+
+#define SLAB_SIZE (64 * 1024)
+
+TEST(bufferpool, out_of_order_put) {
+  BufferPool pool(SLAB_SIZE, 4);
+  char *a = pool.get(100);
+  char *b = pool.get(4096);
+  char *c = pool.get(4097);
+  ASSERT_NE(a, b);
+  ASSERT_EQ(pool.get_offset((uint64_t)c) % 8192, 0);
+  /// puts in any order, freed buffers are reused without a refill.
+  pool.put(a, 100);
+  pool.put(c, 4097);
+  pool.put(b, 4096);
+  for (int i = 0; i < SLAB_SIZE / 4096; i++) {
+    pool.get(4096);
+  }
+  ASSERT_EQ(pool.get_stats().refills, 2);
+  ASSERT_EQ(pool.get_stats().waits, 0);
+  /// one slab of 4KB buffers is in use, the 8KB slab has none taken.
+  ASSERT_EQ(pool.get_stats().mapped_bytes, 4 * SLAB_SIZE);
+  ASSERT_EQ(pool.get_stats().used_bytes, SLAB_SIZE);
+}
+
+TEST(bufferpool, large_and_rebalance) {
+  BufferPool pool(SLAB_SIZE, 4);
+  /// carve every slab into 4KB buffers.
+  std::vector<char *> small;
+  for (int i = 0; i < 4 * SLAB_SIZE / 4096; i++) {
+    small.push_back(pool.get(4096));
+  }
+  ASSERT_EQ(pool.get_stats().refills, 4);
+  for (auto buf : small) {
+    pool.put(buf, 4096);
+  }
+  /// the slabs go back from the 4KB class to serve a request of 3 slabs.
+  char *large = pool.get(3 * SLAB_SIZE);
+  ASSERT_NE(large, nullptr);
+  ASSERT_EQ(pool.get_offset((uint64_t)large) % SLAB_SIZE, 0);
+  ASSERT_GE(pool.get_stats().rebalances, 1);
+  ASSERT_EQ(pool.get_stats().large_gets, 1);
+  ASSERT_EQ(pool.get(5 * SLAB_SIZE), nullptr);
+  pool.put(large, 3 * SLAB_SIZE);
+  ASSERT_NE(pool.get(4 * SLAB_SIZE), nullptr);
+}
+
+TEST(bufferpool, exhausted) {
+  BufferPool pool(SLAB_SIZE, 2);
+  char *a = pool.get(SLAB_SIZE);
+  char *b = pool.get(SLAB_SIZE);
+  /// nothing is put back, the get gives up.
+  ASSERT_EQ(pool.get(4096, 0), nullptr);
+  ASSERT_EQ(pool.get(4096, 10), nullptr);
+  ASSERT_EQ(pool.get_stats().timeouts, 2);
+  /// a waiting get is woken up by the put.
+  std::thread putter([&pool, a] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    pool.put(a, SLAB_SIZE);
+  });
+  ASSERT_EQ(pool.get(SLAB_SIZE, BUFFER_POOL_WAIT_FOREVER), a);
+  putter.join();
+  pool.put(a, SLAB_SIZE);
+  pool.put(b, SLAB_SIZE);
+}
+
+/// a run-to-completion shard takes buffers for requests and puts them back
+/// when their completions come back through its own queue, so it must not
+/// wait for a buffer.
+TEST(bufferpool, run_to_completion) {
+  BufferPool pool(SLAB_SIZE, 2);
+  /// a request if buffer is nullptr, a completion otherwise.
+  WorkerQueue<char *> shard(POLL_BUSY, 1);
+  const int request_num = 1000;
+  for (int i = 0; i < request_num; i++) {
+    shard.enqueue(nullptr);
+  }
+  int completed = 0;
+  int failed = 0;
+  char *tasks[WORKER_DEQUEUE_BULK];
+  while (completed + failed < request_num) {
+    size_t num = shard.dequeue_bulk(tasks, WORKER_DEQUEUE_BULK);
+    for (size_t i = 0; i < num; i++) {
+      if (tasks[i] != nullptr) {
+        pool.put(tasks[i], SLAB_SIZE);
+        completed++;
+        continue;
+      }
+      char *buffer = pool.get(SLAB_SIZE, 0);
+      if (buffer == nullptr) {
+        failed++;
+      } else {
+        shard.enqueue(buffer);
+      }
+    }
+  }
+  ASSERT_GT(failed, 0);
+  ASSERT_EQ(pool.get_stats().used_bytes, 0);
+}
+
+void func(BufferPool *pool, int id) {
+  for (int i = 0; i < 20000; i++) {
+    uint64_t size = 4096 << ((i + id) % 5);
+    char *buf = pool->get(size);
+    memset(buf, id, size);
+    for (uint64_t j = 0; j < size; j += 4096) {
+      ASSERT_EQ(buf[j], id);
+    }
+    pool->put(buf, size);
+  }
+}
+
+TEST(bufferpool, multithread) {
+  BufferPool pool(SLAB_SIZE, 8);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back(func, &pool, i + 1);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  /// every buffer is free again, so the whole region can be taken at once.
+  char *all = pool.get(8 * SLAB_SIZE);
+  ASSERT_NE(all, nullptr);
+  pool.put(all, 8 * SLAB_SIZE);
+}
+
+TEST(bufferpool, grow_and_shrink) {
+  BufferPoolOptions options;
+  options.init_slab_num = 1;
+  options.prefault = true;
+  BufferPool pool(SLAB_SIZE, 3 * BUFFER_POOL_SEGMENT_SLABS, nullptr, options);
+  /// one segment is mapped up front, the next ones on demand.
+  std::vector<char *> held;
+  for (int i = 0; i < 2 * BUFFER_POOL_SEGMENT_SLABS + 1; i++) {
+    held.push_back(pool.get(SLAB_SIZE));
+    memset(held.back(), 1, SLAB_SIZE);
+  }
+  ASSERT_EQ(pool.get_stats().grows, 2);
+  ASSERT_EQ(pool.get(2 * BUFFER_POOL_SEGMENT_SLABS * SLAB_SIZE), nullptr);
+  for (auto buf : held) {
+    pool.put(buf, SLAB_SIZE);
+  }
+  pool.shrink();
+  ASSERT_EQ(pool.get_stats().shrinks, 2);
+  ASSERT_NE(pool.get(BUFFER_POOL_SEGMENT_SLABS * SLAB_SIZE), nullptr);
+}
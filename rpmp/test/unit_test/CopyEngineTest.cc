@@ -0,0 +1,52 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/CopyEngineTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Wednesday, April 1st 2020, 2:05:43 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../pmpool/CopyEngine.h"
+#include "gtest/gtest.h"
+
+void check_copy(CopyEngine *engine, uint64_t size, uint64_t dest_offset,
+                uint64_t src_offset) {
+  std::vector<char> src(size + src_offset);
+  std::vector<char> dest(size + dest_offset + 2 * COPY_UNIT, 0);
+  for (uint64_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<char>(i * 7 + size);
+  }
+  engine->copy(&dest[dest_offset], &src[src_offset], size);
+  CopyEngine::drain();
+  ASSERT_EQ(memcmp(&dest[dest_offset], &src[src_offset], size), 0);
+  /// bytes around the range are untouched.
+  for (uint64_t i = 0; i < dest_offset; i++) {
+    ASSERT_EQ(dest[i], 0);
+  }
+  for (uint64_t i = dest_offset + size; i < dest.size(); i++) {
+    ASSERT_EQ(dest[i], 0);
+  }
+}
+
+TEST(copyengine, unaligned) {
+  CopyEngine engine;
+  for (uint64_t size : {1, 63, 64, 65, 255, 256, 1000, 4096, 100003}) {
+    for (uint64_t offset : {0, 1, 32, 63, 64, 200}) {
+      check_copy(&engine, size, offset, (offset * 3) % 64);
+    }
+  }
+}
+
+TEST(copyengine, split_across_helpers) {
+  CopyEngine engine(3);
+  ASSERT_EQ(engine.get_helper_num(), 3);
+  check_copy(&engine, COPY_SPLIT_THRESHOLD, 0, 0);
+  check_copy(&engine, 9 * COPY_PART_MIN + 12345, 17, 5);
+  check_copy(&engine, 64 * 1024 * 1024 + 1, 100, 0);
+}
@@ -0,0 +1,74 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/EventTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Tuesday, March 10th 2020, 4:52:17 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <vector>
+
+#include "../pmpool/Event.h"
+#include "gtest/gtest.h"
+
+TEST(event, batch_request) {
+  RequestContext rc = {};
+  rc.type = BATCH;
+  rc.rid = 7;
+  for (uint32_t i = 0; i < 3; i++) {
+    RequestMsg msg = {};
+    msg.type = i == 1 ? FREE : WRITE;
+    msg.rid = i;
+    msg.address = 4096 * i;
+    msg.size = 100 + i;
+    rc.batch.push_back(msg);
+  }
+  Request request(rc);
+  std::vector<char> data(request.encoded_size());
+  uint64_t size;
+  request.encode(data.data(), &size);
+  ASSERT_EQ(size, data.size());
+
+  Request decoded(RequestContext{});
+  decoded.decode(data.data(), size, nullptr);
+  RequestContext &drc = decoded.get_rc();
+  ASSERT_EQ(drc.type, BATCH);
+  ASSERT_EQ(drc.rid, 7);
+  ASSERT_EQ(drc.batch.size(), 3);
+  for (uint32_t i = 0; i < 3; i++) {
+    ASSERT_EQ(drc.batch[i].type, rc.batch[i].type);
+    ASSERT_EQ(drc.batch[i].rid, i);
+    ASSERT_EQ(drc.batch[i].address, 4096 * i);
+    ASSERT_EQ(drc.batch[i].size, 100 + i);
+  }
+}
+
+TEST(event, batch_reply) {
+  RequestReplyContext rrc = {};
+  rrc.type = BATCH_REPLY;
+  rrc.rid = 7;
+  rrc.success = 1;
+  for (uint32_t i = 0; i < 2; i++) {
+    RequestReplyMsg msg = {};
+    msg.type = ALLOC_REPLY;
+    msg.success = i;
+    msg.rid = i;
+    msg.address = 4096 * i;
+    rrc.batch.push_back(msg);
+  }
+  RequestReply reply(rrc);
+  std::vector<char> data(reply.encoded_size());
+  uint64_t size;
+  reply.encode(data.data(), &size);
+  ASSERT_EQ(size, data.size());
+
+  RequestReply decoded(RequestReplyContext{});
+  decoded.decode(data.data(), size, nullptr);
+  RequestReplyContext &drrc = decoded.get_rrc();
+  ASSERT_EQ(drrc.type, BATCH_REPLY);
+  ASSERT_EQ(drrc.success, 1);
+  ASSERT_EQ(drrc.batch.size(), 2);
+  ASSERT_EQ(drrc.batch[1].success, 1);
+  ASSERT_EQ(drrc.batch[1].address, 4096);
+}
@@ -0,0 +1,83 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/FlatIndexTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Friday, March 20th 2020, 11:20:37 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/FlatIndex.h"
+#include "gtest/gtest.h"
+
+TEST(flatindex, insert_find_erase) {
+  FlatIndex index;
+  uint64_t value;
+  for (uint64_t key = 1; key <= 100000; key++) {
+    ASSERT_TRUE(index.insert(key << 8, key));
+  }
+  ASSERT_FALSE(index.insert(1 << 8, 0));
+  ASSERT_EQ(index.size(), 100000);
+  for (uint64_t key = 1; key <= 100000; key += 2) {
+    ASSERT_TRUE(index.erase(key << 8, &value));
+    ASSERT_EQ(value, key);
+  }
+  ASSERT_FALSE(index.erase(1 << 8));
+  for (uint64_t key = 1; key <= 100000; key++) {
+    ASSERT_EQ(index.find(key << 8, &value), key % 2 == 0);
+    if (key % 2 == 0) {
+      ASSERT_EQ(value, key);
+    }
+  }
+  ASSERT_EQ(index.size(), 50000);
+  index.clear();
+  ASSERT_EQ(index.size(), 0);
+  ASSERT_FALSE(index.find(2 << 8, &value));
+}
+
+TEST(flatindex, multithread) {
+  FlatIndex index;
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < 4; t++) {
+    threads.emplace_back([&index, t] {
+      uint64_t value;
+      for (uint64_t round = 0; round < 10; round++) {
+        for (uint64_t i = 1; i <= 10000; i++) {
+          ASSERT_TRUE(index.insert((t << 48) | i, i));
+        }
+        for (uint64_t i = 1; i <= 10000; i++) {
+          ASSERT_TRUE(index.find((t << 48) | i, &value));
+          ASSERT_EQ(value, i);
+          ASSERT_TRUE(index.erase((t << 48) | i));
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(index.size(), 0);
+}
+
+TEST(flatindex, reserve_for_each) {
+  FlatIndex index;
+  index.insert(7, 70);
+  index.reserve(100000);
+  for (uint64_t i = 1; i <= 100000; i++) {
+    if (i != 7) {
+      ASSERT_TRUE(index.insert(i, i * 10));
+    }
+  }
+  index.erase(8);
+  uint64_t num = 0, sum = 0;
+  index.for_each([&](uint64_t key, uint64_t value) {
+    ASSERT_EQ(value, key * 10);
+    num++;
+    sum += key;
+  });
+  ASSERT_EQ(num, 99999);
+  ASSERT_EQ(sum, 100000ULL * 100001 / 2 - 8);
+}
@@ -0,0 +1,69 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/HistogramTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Thursday, April 2nd 2020, 3:27:40 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/Histogram.h"
+#include "gtest/gtest.h"
+
+TEST(histogram, buckets) {
+  /// every value lies within its bucket, buckets are contiguous.
+  for (uint64_t value : {0ULL, 15ULL, 16ULL, 17ULL, 100ULL, 1000ULL,
+                         123456789ULL, (1ULL << HISTOGRAM_MAX_BITS) - 1}) {
+    int index = Histogram::index(value);
+    ASSERT_LE(value, Histogram::highest(index));
+    if (index > 0) {
+      ASSERT_GT(value, Histogram::highest(index - 1));
+    }
+    /// within 1/16 of the value.
+    ASSERT_LE(Histogram::highest(index) - value, value / HISTOGRAM_SUB_BUCKETS);
+  }
+  ASSERT_EQ(Histogram::index(1ULL << 50), HISTOGRAM_BUCKETS - 1);
+}
+
+TEST(histogram, percentiles_and_reset) {
+  Histogram histogram;
+  ASSERT_EQ(histogram.get_percentile(99), 0);
+  for (uint64_t i = 1; i <= 1000; i++) {
+    histogram.record(i * 1000);
+  }
+  ASSERT_EQ(histogram.get_count(), 1000);
+  ASSERT_EQ(histogram.get_max(), 1000000);
+  ASSERT_DOUBLE_EQ(histogram.get_mean(), 500500);
+  uint64_t p50 = histogram.get_percentile(50);
+  ASSERT_GE(p50, 500000);
+  ASSERT_LE(p50, 500000 + 500000 / HISTOGRAM_SUB_BUCKETS);
+  ASSERT_GE(histogram.get_percentile(99.9), 999000);
+  ASSERT_EQ(histogram.get_percentile(100), 1000000);
+  histogram.reset();
+  ASSERT_EQ(histogram.get_count(), 0);
+  ASSERT_EQ(histogram.get_max(), 0);
+}
+
+TEST(histogram, concurrent_records) {
+  LatencyStats stats;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&stats, i] {
+      for (uint64_t j = 0; j < 100000; j++) {
+        stats.record(4, STAGE_COPY, j + i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(stats.get(4, STAGE_COPY).get_count(), 400000);
+  ASSERT_EQ(stats.get(4, STAGE_COPY).get_max(), 100002);
+  ASSERT_EQ(stats.get(4, STAGE_SEND).get_count(), 0);
+  stats.record(LATENCY_OP_NUM, STAGE_SEND, 1);
+  stats.reset();
+  ASSERT_EQ(stats.get(4, STAGE_COPY).get_count(), 0);
+}
@@ -0,0 +1,116 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/MetaLogTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Tuesday, March 24th 2020, 10:12:40 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "../pmpool/MetaLog.h"
+#include "../pmpool/MetaStore.h"
+#include "../pmpool/PmemSlabAllocator.h"
+#include "TestLog.h"
+#include "gtest/gtest.h"
+
+#define TEST_POOL_PATH "/tmp/rpmp_meta_log_test"
+#define TEST_POOL_SIZE (64ULL << 20)
+
+TEST(metastore, copy_on_write) {
+  MetaStore store;
+  ASSERT_EQ(store.get(1), nullptr);
+  store.replay(1, block_meta(100, 10), 1);
+  auto snapshot = store.get(1);
+  store.replay(1, block_meta(200, 20), 2);
+  ASSERT_EQ(snapshot->size(), 1);
+  auto bml = store.get(1);
+  ASSERT_EQ(bml->size(), 2);
+  ASSERT_EQ((*bml)[1].address, 200);
+  auto km = store.erase(1);
+  ASSERT_EQ(km->seqs[1], 2);
+  ASSERT_EQ(store.get(1), nullptr);
+  ASSERT_EQ(bml->size(), 2);
+}
+
+TEST(metastore, append_in_place) {
+  MetaStore store;
+  store.advance_seq(10);
+  uint64_t persisted = 0;
+  uint64_t seq = store.append(1, block_meta(100, 10),
+                              [&](uint64_t seq) { persisted = seq; });
+  ASSERT_EQ(seq, 11);
+  ASSERT_EQ(persisted, seq);
+  const vector<block_meta> *list = store.get(1).get();
+  for (uint64_t i = 1; i < 100; i++) {
+    store.append(1, block_meta(100 + i, 10), [](uint64_t) {});
+  }
+  // no reader held the list, so it was never copied.
+  auto bml = store.get(1);
+  ASSERT_EQ(bml.get(), list);
+  ASSERT_EQ(bml->size(), 100);
+  uint64_t erase_seq = 0;
+  auto km = store.erase(1, &erase_seq);
+  ASSERT_EQ(km->seqs.back(), 110);
+  ASSERT_EQ(erase_seq, 111);
+}
+
+class metalog : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    remove(TEST_POOL_PATH);
+    string path = TEST_POOL_PATH;
+    diskInfo_ = new DiskInfo(path, TEST_POOL_SIZE);
+  }
+  void TearDown() override {
+    delete diskInfo_;
+    remove(TEST_POOL_PATH);
+  }
+  DiskInfo *diskInfo_;
+};
+
+TEST_F(metalog, append_recover_rewrite) {
+  uint64_t record_num = META_LOG_RECORDS_PER_SEGMENT + 10;
+  {
+    PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+    ASSERT_EQ(allocator.init(), 0);
+    MetaLog log(&allocator);
+    vector<meta_record> records;
+    ASSERT_EQ(log.recover(&records), 0);
+    ASSERT_TRUE(records.empty());
+    for (uint64_t i = 1; i <= record_num; i++) {
+      ASSERT_EQ(log.append({i % 7, i << 12, i, i, 0, {0, 0, 0}}), 0);
+    }
+  }
+  {
+    PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+    ASSERT_EQ(allocator.init(), 0);
+    MetaLog log(&allocator);
+    vector<meta_record> records;
+    ASSERT_EQ(log.recover(&records), 0);
+    ASSERT_EQ(records.size(), record_num);
+    for (uint64_t i = 0; i < record_num; i++) {
+      ASSERT_EQ(records[i].seq, i + 1);
+      ASSERT_EQ(records[i].address, (i + 1) << 12);
+    }
+    records.resize(3);
+    ASSERT_EQ(log.rewrite(records), 0);
+    ASSERT_EQ(log.size(), 3);
+    ASSERT_EQ(log.append({9, 9 << 12, 9, record_num + 1, 0, {0, 0, 0}}), 0);
+  }
+  {
+    PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+    ASSERT_EQ(allocator.init(), 0);
+    MetaLog log(&allocator);
+    vector<meta_record> records;
+    ASSERT_EQ(log.recover(&records), 0);
+    ASSERT_EQ(records.size(), 4);
+    ASSERT_EQ(records[2].seq, 3);
+    ASSERT_EQ(records[3].key, 9);
+    ASSERT_EQ(allocator.release_all(), 0);
+    ASSERT_EQ(allocator.get_meta_root(), 0);
+  }
+}
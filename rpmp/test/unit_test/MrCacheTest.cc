@@ -0,0 +1,84 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/MrCacheTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Monday, March 30th 2020, 2:18:40 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <set>
+#include <vector>
+
+#include "../pmpool/buffer/MrCache.h"
+#include "gtest/gtest.h"
+
+class FakeRegister : public RmaBufferRegister {
+ public:
+  ~FakeRegister() {
+    for (auto ck : chunks_) {
+      delete ck->mr;
+      delete ck;
+    }
+  }
+  Chunk *register_rma_buffer(char *rma_buffer, uint64_t size) override {
+    Chunk *ck = new Chunk();
+    ck->buffer = rma_buffer;
+    ck->size = size;
+    ck->buffer_id = chunks_.size();
+    ck->mr = new fid_mr();
+    ck->mr->key = chunks_.size();
+    chunks_.push_back(ck);
+    live_.insert(ck->buffer_id);
+    return ck;
+  }
+  void unregister_rma_buffer(int buffer_id) override {
+    live_.erase(buffer_id);
+  }
+  std::vector<Chunk *> chunks_;
+  std::set<int> live_;
+};
+
+TEST(mrcache, acquire_release) {
+  FakeRegister rbr;
+  MrCache cache(&rbr, 1 << 20);
+  std::vector<char> buffer(1 << 16);
+  ASSERT_EQ(cache.add(buffer.data(), buffer.size()), 0);
+  ASSERT_EQ(cache.add(buffer.data() + 100, 10), -1);
+  ASSERT_EQ(cache.acquire(buffer.data() + 4096, 1 << 16), nullptr);
+  Chunk *ck = cache.acquire(buffer.data() + 4096, 4096);
+  ASSERT_NE(ck, nullptr);
+  ASSERT_EQ(ck->buffer, buffer.data());
+  /// in use by a transfer.
+  ASSERT_EQ(cache.remove(buffer.data()), -1);
+  cache.release(buffer.data() + 4096);
+  ASSERT_EQ(cache.remove(buffer.data()), 0);
+  ASSERT_TRUE(rbr.live_.empty());
+  ASSERT_EQ(cache.acquire(buffer.data(), 1), nullptr);
+}
+
+TEST(mrcache, lru_eviction) {
+  FakeRegister rbr;
+  MrCache cache(&rbr, 2 << 20);
+  std::vector<std::vector<char>> buffers(3, std::vector<char>(1 << 20));
+  ASSERT_EQ(cache.add(buffers[0].data(), 1 << 20), 0);
+  ASSERT_EQ(cache.add(buffers[1].data(), 1 << 20), 0);
+  /// buffer 1 is pinned, buffer 0 is the least recently used idle one.
+  ASSERT_NE(cache.acquire(buffers[1].data(), 1 << 20), nullptr);
+  ASSERT_EQ(cache.add(buffers[2].data(), 1 << 20), 0);
+  MrCacheStats stats = cache.get_stats();
+  ASSERT_EQ(stats.evictions, 1);
+  ASSERT_EQ(stats.registered_bytes, 2 << 20);
+  ASSERT_EQ(rbr.live_.count(0), 0);
+  /// an evicted buffer is registered again on its next use.
+  cache.release(buffers[1].data());
+  Chunk *ck = cache.acquire(buffers[0].data(), 1 << 20);
+  ASSERT_NE(ck, nullptr);
+  ASSERT_EQ(ck->buffer_id, 3);
+  stats = cache.get_stats();
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.evictions, 2);
+  ASSERT_EQ(rbr.live_.count(2), 0);
+  cache.release(buffers[0].data());
+}
@@ -0,0 +1,61 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/ObjectPoolTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Wednesday, March 18th 2020, 10:02:45 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include "../pmpool/Event.h"
+#include "../pmpool/ObjectPool.h"
+#include "gtest/gtest.h"
+
+TEST(objectpool, reuse) {
+  int created = 0;
+  ObjectPool<int> pool(
+      [&created]() {
+        created++;
+        return new int(0);
+      },
+      1);
+  ASSERT_EQ(created, 1);
+  int *a = pool.get();
+  int *b = pool.get();
+  ASSERT_EQ(created, 2);
+  ASSERT_NE(a, b);
+  pool.put(a);
+  ASSERT_EQ(pool.get(), a);
+  ASSERT_EQ(created, 2);
+  pool.put(a);
+  pool.put(b);
+}
+
+TEST(objectpool, reuse_request) {
+  ObjectPool<Request> pool([]() { return new Request(RequestContext()); }, 1);
+  char data[4096];
+  uint64_t size = 0;
+
+  Request *request = pool.get();
+  request->reset();
+  RequestContext &rc = request->get_rc();
+  rc.type = BATCH;
+  rc.rid = 7;
+  rc.batch.resize(3);
+  rc.batch[2].size = 4096;
+  ASSERT_EQ(request->encoded_size(), sizeof(RequestMsg) * 4);
+  request->encode(data, &size);
+  ASSERT_EQ(size, sizeof(RequestMsg) * 4);
+  pool.put(request);
+
+  Request *decoded = pool.get();
+  ASSERT_EQ(decoded, request);
+  decoded->reset();
+  ASSERT_TRUE(decoded->get_rc().batch.empty());
+  decoded->decode(data, size, nullptr);
+  ASSERT_EQ(decoded->get_rc().type, BATCH);
+  ASSERT_EQ(decoded->get_rc().rid, 7);
+  ASSERT_EQ(decoded->get_rc().batch.size(), 3);
+  ASSERT_EQ(decoded->get_rc().batch[2].size, 4096);
+  pool.put(decoded);
+}
@@ -0,0 +1,230 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/PmemSlabAllocatorTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Thursday, March 19th 2020, 4:35:21 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <stdio.h>
+
+#include <set>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/PmemSlabAllocator.h"
+#include "TestLog.h"
+#include "gtest/gtest.h"
+
+#define TEST_POOL_PATH "/tmp/rpmp_slab_allocator_test"
+#define TEST_POOL_SIZE (64ULL << 20)
+
+class pmemslaballocator : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    remove(TEST_POOL_PATH);
+    string path = TEST_POOL_PATH;
+    diskInfo_ = new DiskInfo(path, TEST_POOL_SIZE);
+  }
+  void TearDown() override {
+    delete diskInfo_;
+    remove(TEST_POOL_PATH);
+  }
+  DiskInfo *diskInfo_;
+};
+
+TEST_F(pmemslaballocator, allocate_write_release) {
+  PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 1);
+  ASSERT_EQ(allocator.init(), 0);
+  std::set<uint64_t> addresses;
+  uint64_t large = 0;
+  for (uint64_t size : {1, 256, 300, 4096, 100000, 4 << 20, 9 << 20}) {
+    std::string content(size, 'a' + size % 26);
+    uint64_t address = allocator.allocate_and_write(size, content.c_str());
+    ASSERT_NE(address, (uint64_t)-1);
+    ASSERT_EQ(GET_WID(address), 1);
+    ASSERT_TRUE(addresses.insert(address).second);
+    char *data = reinterpret_cast<char *>(
+        allocator.get_virtual_address(address, size));
+    ASSERT_EQ(memcmp(data, content.c_str(), size), 0);
+    ASSERT_EQ(allocator.get_virtual_address(address, 16 << 20), (uint64_t)-1);
+    ASSERT_EQ(allocator.write(address, content.c_str(), size), 0);
+    ASSERT_EQ(allocator.write(address, content.c_str(), 16 << 20), -1);
+    large = address;
+  }
+  for (uint64_t address : addresses) {
+    ASSERT_EQ(allocator.release(address), 0);
+    ASSERT_EQ(allocator.release(address), -1);
+  }
+  /// the slabs of a released large object are free, not addressable.
+  ASSERT_EQ(allocator.get_virtual_address(large, 1), (uint64_t)-1);
+  ASSERT_EQ(allocator.release(0), -1);
+}
+
+TEST_F(pmemslaballocator, reuse_and_exhaust) {
+  PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+  ASSERT_EQ(allocator.init(), 0);
+  std::vector<uint64_t> addresses;
+  while (true) {
+    uint64_t address = allocator.allocate_and_write(1 << 20);
+    if (address == (uint64_t)-1) {
+      break;
+    }
+    addresses.push_back(address);
+  }
+  ASSERT_GT(addresses.size(), 0);
+  for (uint64_t address : addresses) {
+    ASSERT_EQ(allocator.release(address), 0);
+  }
+  /// every slab is free again, so a run of all of them can be allocated.
+  uint64_t large = allocator.allocate_and_write(addresses.size() << 20);
+  ASSERT_NE(large, (uint64_t)-1);
+  ASSERT_EQ(allocator.release(large), 0);
+}
+
+TEST_F(pmemslaballocator, recover) {
+  uint64_t small, large, freed;
+  {
+    PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+    ASSERT_EQ(allocator.init(), 0);
+    small = allocator.allocate_and_write(512);
+    large = allocator.allocate_and_write(5 << 20);
+    ASSERT_EQ(allocator.write(small, "small", 6), 0);
+    ASSERT_EQ(allocator.write(large, "large", 6), 0);
+    freed = allocator.allocate_and_write(512);
+    ASSERT_EQ(allocator.release(freed), 0);
+  }
+  PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+  ASSERT_EQ(allocator.init(), 0);
+  ASSERT_STREQ(
+      reinterpret_cast<char *>(allocator.get_virtual_address(small, 6)),
+      "small");
+  ASSERT_STREQ(
+      reinterpret_cast<char *>(allocator.get_virtual_address(large, 6)),
+      "large");
+  ASSERT_EQ(allocator.release(freed), -1);
+  ASSERT_EQ(allocator.release(small), 0);
+  ASSERT_EQ(allocator.release(large), 0);
+}
+
+TEST_F(pmemslaballocator, multithread) {
+  PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+  ASSERT_EQ(allocator.init(), 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&allocator, t] {
+      std::vector<uint64_t> addresses;
+      for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 1000; i++) {
+          uint64_t address = allocator.allocate_and_write(256 + t * 1000);
+          ASSERT_NE(address, (uint64_t)-1);
+          *reinterpret_cast<int *>(
+              allocator.get_virtual_address(address, sizeof(int))) = t;
+          addresses.push_back(address);
+        }
+        for (uint64_t address : addresses) {
+          ASSERT_EQ(
+              *reinterpret_cast<int *>(
+                  allocator.get_virtual_address(address, sizeof(int))),
+              t);
+          ASSERT_EQ(allocator.release(address), 0);
+        }
+        addresses.clear();
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+TEST_F(pmemslaballocator, arena) {
+  uint64_t kept, large;
+  {
+    PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+    ASSERT_EQ(allocator.init(), 0);
+    uint64_t prev = 0;
+    for (int i = 0; i < 100; i++) {
+      uint64_t address = allocator.allocate_in_arena(1, 1000);
+      ASSERT_NE(address, (uint64_t)-1);
+      if (prev != 0) {
+        ASSERT_EQ(address, prev + 1024);
+      }
+      prev = address;
+    }
+    kept = allocator.allocate_in_arena(2, 100);
+    ASSERT_EQ(allocator.write(kept, "kept", 5), 0);
+    large = allocator.allocate_in_arena(2, 6 << 20);
+    ASSERT_EQ(allocator.write(large, "large", 6), 0);
+    ASSERT_EQ(allocator.release(prev), 0);
+    ASSERT_EQ(allocator.release_arena(1), 0);
+    ASSERT_EQ(allocator.release_arena(1), 0);
+  }
+  PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+  ASSERT_EQ(allocator.init(), 0);
+  ASSERT_STREQ(
+      reinterpret_cast<char *>(allocator.get_virtual_address(kept, 5)),
+      "kept");
+  ASSERT_STREQ(
+      reinterpret_cast<char *>(allocator.get_virtual_address(large, 6)),
+      "large");
+  /// arena 2 survived the restart and keeps its slabs until it is released.
+  uint64_t address = allocator.allocate_in_arena(2, 100);
+  ASSERT_NE(address, (uint64_t)-1);
+  ASSERT_NE(address, kept);
+  ASSERT_EQ(allocator.release_arena(2), 0);
+  std::vector<uint64_t> addresses;
+  while (true) {
+    uint64_t address = allocator.allocate_and_write(4 << 20);
+    if (address == (uint64_t)-1) {
+      break;
+    }
+    addresses.push_back(address);
+  }
+  ASSERT_EQ(addresses.size(), 15);
+}
+
+TEST_F(pmemslaballocator, durability_modes) {
+  for (auto mode : {DURABILITY_VOLATILE, DURABILITY_PERSIST,
+                    DURABILITY_GROUP_COMMIT}) {
+    remove(TEST_POOL_PATH);
+    diskInfo_->durability = mode;
+    PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+    ASSERT_EQ(allocator.init(), 0);
+    std::string content(100000, 'a' + mode);
+    uint64_t address = allocator.allocate_and_write(content.size());
+    ASSERT_EQ(allocator.write(address, content.c_str(), content.size()), 0);
+    ASSERT_EQ(allocator.flush(address, content.size()), 0);
+    allocator.drain();
+    char *data = reinterpret_cast<char *>(
+        allocator.get_virtual_address(address, content.size()));
+    ASSERT_EQ(memcmp(data, content.c_str(), content.size()), 0);
+    ASSERT_EQ(allocator.flush(address, TEST_POOL_SIZE), -1);
+  }
+}
+
+TEST_F(pmemslaballocator, stats) {
+  PmemSlabAllocator allocator(get_log(), diskInfo_, nullptr, 0);
+  ASSERT_EQ(allocator.init(), 0);
+  pool_stats stats = {};
+  allocator.get_stats(&stats);
+  ASSERT_GT(stats.capacity, 0);
+  ASSERT_EQ(stats.capacity % PMEM_SLAB_SIZE, 0);
+  ASSERT_EQ(stats.used, 0);
+  ASSERT_EQ(stats.largest_free, stats.capacity);
+  uint64_t small = allocator.allocate_and_write(512);
+  uint64_t large = allocator.allocate_and_write(5 << 20);
+  allocator.get_stats(&stats);
+  ASSERT_EQ(stats.blocks, 2);
+  ASSERT_EQ(stats.used, 512 + 2 * PMEM_SLAB_SIZE);
+  ASSERT_LE(stats.largest_free, stats.capacity - 3 * PMEM_SLAB_SIZE);
+  ASSERT_EQ(allocator.release(small), 0);
+  ASSERT_EQ(allocator.release(large), 0);
+  /// the slab of the small block stays with the thread that allocated it.
+  allocator.get_stats(&stats);
+  ASSERT_EQ(stats.blocks, 0);
+  ASSERT_EQ(stats.used, 0);
+  ASSERT_GE(stats.largest_free, stats.capacity - PMEM_SLAB_SIZE);
+}
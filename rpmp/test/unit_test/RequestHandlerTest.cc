@@ -0,0 +1,117 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/RequestHandlerTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Thursday, March 26th 2020, 3:21:08 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/client/NetworkClient.h"
+#include "gtest/gtest.h"
+
+/// records the rids of sent requests instead of sending them.
+class FakeNetworkClient : public NetworkClient {
+ public:
+  FakeNetworkClient() : NetworkClient("", "") {}
+  void send(Request *request) override {
+    std::lock_guard<std::mutex> l(mtx);
+    rids.push_back(request->get_rc().rid);
+  }
+  uint64_t sent() {
+    std::lock_guard<std::mutex> l(mtx);
+    return rids.size();
+  }
+  std::mutex mtx;
+  vector<uint64_t> rids;
+};
+
+static void add(RequestHandler *handler, uint64_t rid) {
+  RequestContext rc = {};
+  rc.type = GET;
+  rc.rid = rid;
+  Request request(rc);
+  handler->addTask(&request);
+}
+
+static void reply(RequestHandler *handler, uint64_t rid) {
+  RequestReplyContext rrc = {};
+  rrc.type = GET_REPLY;
+  rrc.rid = rid;
+  rrc.size = rid * 10;
+  RequestReply requestReply(rrc);
+  handler->notify(&requestReply);
+}
+
+TEST(requesthandler, out_of_order) {
+  FakeNetworkClient client;
+  RequestHandler handler(&client, 4);
+  for (uint64_t rid = 1; rid <= 3; rid++) {
+    add(&handler, rid);
+  }
+  ASSERT_EQ(client.sent(), 3);
+  reply(&handler, 3);
+  reply(&handler, 1);
+  std::thread late([&handler] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    reply(&handler, 2);
+  });
+  for (uint64_t rid = 1; rid <= 3; rid++) {
+    auto rrc = handler.wait(rid);
+    ASSERT_EQ(rrc.rid, rid);
+    ASSERT_EQ(rrc.size, rid * 10);
+  }
+  late.join();
+}
+
+TEST(requesthandler, window) {
+  FakeNetworkClient client;
+  RequestHandler handler(&client, 2, true);
+  add(&handler, 1);
+  add(&handler, 2);
+  std::atomic<bool> added(false);
+  std::thread third([&handler, &added] {
+    add(&handler, 3);
+    added = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(added);
+  ASSERT_EQ(client.sent(), 2);
+  reply(&handler, 2);
+  third.join();
+  ASSERT_EQ(client.sent(), 3);
+  reply(&handler, 1);
+  reply(&handler, 3);
+  ASSERT_EQ(handler.wait(2).size, 20);
+  ASSERT_EQ(handler.wait(3).size, 30);
+  ASSERT_EQ(handler.wait(1).size, 10);
+}
+
+TEST(requesthandler, chain_from_callback) {
+  FakeNetworkClient client;
+  RequestHandler handler(&client, 1);
+  uint64_t done = 0;
+  RequestContext rc = {};
+  rc.type = GET;
+  rc.rid = 1;
+  Request request(rc);
+  handler.addTask(&request, [&](RequestReplyContext &rrc) {
+    done = rrc.rid;
+    // a callback never waits for the window, though it is full after the
+    // first chained request.
+    add(&handler, 2);
+    add(&handler, 3);
+  });
+  reply(&handler, 1);
+  ASSERT_EQ(done, 1);
+  ASSERT_EQ(client.sent(), 3);
+  reply(&handler, 2);
+  reply(&handler, 3);
+  ASSERT_EQ(handler.wait(2).size, 20);
+  ASSERT_EQ(handler.wait(3).size, 30);
+}
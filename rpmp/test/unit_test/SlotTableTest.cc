@@ -0,0 +1,61 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/SlotTableTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Monday, March 16th 2020, 10:40:12 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "../pmpool/SlotTable.h"
+#include "gtest/gtest.h"
+
+TEST(slottable, insert_erase) {
+  SlotTable<int> table(2);
+  int a = 1, b = 2, c = 3;
+  uint32_t id_a = table.insert(&a);
+  uint32_t id_b = table.insert(&b);
+  ASSERT_NE(id_a, id_b);
+  ASSERT_EQ(table.get(id_a), &a);
+  ASSERT_EQ(table.get(id_b), &b);
+  ASSERT_EQ(table.erase(id_a), &a);
+  ASSERT_EQ(table.get(id_a), nullptr);
+  uint32_t id_c = table.insert(&c);
+  ASSERT_EQ(id_c, id_a);
+  ASSERT_EQ(table.get(id_c), &c);
+}
+
+TEST(slottable, try_insert_full) {
+  SlotTable<int> table(1);
+  int a = 1, b = 2;
+  uint32_t id_a, id_b;
+  ASSERT_TRUE(table.try_insert(&a, &id_a));
+  ASSERT_FALSE(table.try_insert(&b, &id_b));
+  ASSERT_EQ(table.erase(id_a), &a);
+  ASSERT_TRUE(table.try_insert(&b, &id_b));
+  ASSERT_EQ(table.get(id_b), &b);
+}
+
+TEST(slottable, multithread) {
+  SlotTable<int> table(16);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&table] {
+      int value = 0;
+      for (int i = 0; i < 10000; i++) {
+        uint32_t id = table.insert(&value);
+        ASSERT_EQ(table.get(id), &value);
+        ASSERT_EQ(table.erase(id), &value);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (uint32_t i = 0; i < table.capacity(); i++) {
+    ASSERT_EQ(table.get(i), nullptr);
+  }
+}
@@ -0,0 +1,28 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/TestLog.h
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Tuesday, March 24th 2020, 11:02:17 am
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#ifndef TEST_UNIT_TEST_TESTLOG_H_
+#define TEST_UNIT_TEST_TESTLOG_H_
+
+#include "../pmpool/Config.h"
+#include "../pmpool/Log.h"
+
+/// loggers are registered globally by name, so all tests share one Log.
+inline Log *get_log() {
+  static Config config;
+  static Log *log = nullptr;
+  if (log == nullptr) {
+    config.set_log_path("/tmp/rpmp_test.log");
+    config.set_log_level("warn");
+    log = new Log(&config);
+  }
+  return log;
+}
+
+#endif  // TEST_UNIT_TEST_TESTLOG_H_
@@ -0,0 +1,51 @@
+/*
+ * Filename: /mnt/spark-pmof/tool/rpmp/test/WorkerQueueTest.cc
+ * Path: /mnt/spark-pmof/tool/rpmp/test
+ * Created Date: Wednesday, March 25th 2020, 5:10:44 pm
+ * Author: root
+ *
+ * Copyright (c) 2020 Intel
+ */
+
+#include <thread>  // NOLINT
+
+#include "../pmpool/WorkerQueue.h"
+#include "gtest/gtest.h"
+
+TEST(workerqueue, bulk_dequeue) {
+  WorkerQueue<int> queue(POLL_SPIN_PARK, 10);
+  for (int i = 0; i < 40; i++) {
+    queue.enqueue(i);
+  }
+  int tasks[WORKER_DEQUEUE_BULK];
+  ASSERT_EQ(queue.dequeue_bulk(tasks, WORKER_DEQUEUE_BULK),
+            WORKER_DEQUEUE_BULK);
+  ASSERT_EQ(tasks[0], 0);
+  ASSERT_EQ(queue.dequeue_bulk(tasks, WORKER_DEQUEUE_BULK), 8);
+  WorkerStats stats = queue.get_stats();
+  ASSERT_EQ(stats.batches, 2);
+  ASSERT_EQ(stats.tasks, 40);
+  ASSERT_EQ(stats.spins, 0);
+}
+
+TEST(workerqueue, park) {
+  WorkerQueue<int> queue(POLL_SPIN_PARK, 10);
+  std::thread producer([&queue] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.enqueue(1);
+  });
+  int task;
+  ASSERT_EQ(queue.dequeue_bulk(&task, 1), 1);
+  producer.join();
+  WorkerStats stats = queue.get_stats();
+  ASSERT_EQ(stats.spins, 10);
+  ASSERT_EQ(stats.wakeups, 1);
+}
+
+TEST(workerqueue, busy) {
+  WorkerQueue<int> queue(POLL_BUSY, 5);
+  int task;
+  ASSERT_EQ(queue.dequeue_bulk(&task, 1), 0);
+  ASSERT_EQ(queue.get_stats().spins, 5);
+  ASSERT_EQ(queue.get_stats().wakeups, 0);
+}